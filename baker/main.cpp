@@ -0,0 +1,147 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include "../mechanics/mesh_import.h"
+#include "../mechanics/mesh_optimize.h"
+#include "../mechanics/baked_mesh.h"
+#include "../mechanics/baked_texture.h"
+#include "texture_compressor.h"
+#include "../editor/scene_loader.h"
+
+// Offline asset baker. Converts source assets into the formats the game loads at runtime,
+// so the expensive importing happens once at build time instead of on every launch.
+//
+// Usage: baker mesh <model file> [--lod-error <fraction>] [--quantize] [output file]
+//        baker texture <image file> [bc1|bc3|bc5] [output file]
+//        baker scene <text scene file> [output file]
+//   Writes the baked file next to the source (plank.obj -> plank.mesh, container2.png -> container2.tex,
+//   scene1.scene -> scene1.bscene)
+//   unless an output is given. Textures pick their compression from the image unless one is given.
+//   Meshes get simplified levels of detail within the error budget, a fraction of the mesh size,
+//   and are reordered for the vertex cache. --quantize stores 16 byte vertices instead of 32.
+
+static void printUsage()
+{
+	cout << "Usage: baker mesh <model file> [--lod-error <fraction>] [--quantize] [output file]" << endl;
+	cout << "       baker texture <image file> [bc1|bc3|bc5] [output file]" << endl;
+	cout << "       baker scene <text scene file> [output file]" << endl;
+}
+
+static int bakeMesh(const string& sourcePath, const string& outputPath, const ImportSettings& settings)
+{
+	vector<MeshData> meshes;
+	if (!importModel(sourcePath, meshes, settings))
+		return 1;
+	if (!writeBakedModel(outputPath, meshes))
+		return 1;
+
+	size_t vertices = 0, indices = 0, gpuBytes = 0;
+	float misses = 0.0f;
+	// triangles at each level of detail, summed over the meshes
+	vector<size_t> levelTriangles;
+	for (const auto& mesh : meshes)
+	{
+		vertices += mesh.vertices.size();
+		indices += mesh.indices.size();
+		vector<uint16_t> shortIndices;
+		MeshBuffers buffers = meshBuffers(mesh, shortIndices);
+		gpuBytes += (size_t)buffers.vertexCount * vertexSize(buffers.format) + (size_t)buffers.indexCount * buffers.indexSize;
+		misses += averageCacheMissRatio(mesh.indices.data(), mesh.lods[0].indexCount, (unsigned int)mesh.vertices.size()) * (mesh.lods[0].indexCount / 3);
+		if (mesh.lods.size() > levelTriangles.size())
+			levelTriangles.resize(mesh.lods.size(), 0);
+		for (size_t level = 0; level < levelTriangles.size(); level++)
+			levelTriangles[level] += mesh.lods[std::min(level, mesh.lods.size() - 1)].indexCount / 3;
+	}
+	cout << "Baked " << sourcePath << " -> " << outputPath << ": " << meshes.size() << " meshes, "
+		<< vertices << " vertices, " << indices << " indices" << endl;
+	cout << "Levels of detail:";
+	for (size_t triangles : levelTriangles)
+		cout << " " << triangles;
+	cout << " triangles" << endl;
+	if (levelTriangles.size() > 0 && levelTriangles[0] > 0)
+	{
+		// every vertex is loaded once at least, flat shaded models can't get below about 2
+		cout << "Vertex cache misses per triangle: " << misses / levelTriangles[0] << " (" << (float)vertices / levelTriangles[0]
+			<< " at best), GPU buffers: " << gpuBytes / 1024 << " KB" << endl;
+	}
+	return 0;
+}
+
+static int bakeScene(const string& sourcePath, const string& outputPath)
+{
+	// the scene is built for real so the binary file holds exactly what the text one loads to
+	PhysicsCommon common;
+	SceneLoader loader;
+	SceneHeader* header = loader.loadScene(sourcePath, "", &common, nullptr);
+	if (header == nullptr)
+		return 1;
+	if (!writeSceneBinary(outputPath, header->name, header->entities, header->world))
+		return 1;
+
+	cout << "Baked " << sourcePath << " -> " << outputPath << ": " << header->entities->renderables.size() << " render entries, "
+		<< header->entities->bodies.size() << " physics entries" << endl;
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		printUsage();
+		return 1;
+	}
+
+	string mode = argv[1];
+	string input = argv[2];
+	if (mode == "mesh")
+	{
+		int next = 3;
+		ImportSettings settings;
+		while (argc > next)
+		{
+			string option = argv[next];
+			if (option == "--lod-error" && argc > next + 1)
+			{
+				settings.lods.maxError = (float)atof(argv[next + 1]);
+				next += 2;
+			}
+			else if (option == "--quantize")
+			{
+				settings.quantize = true;
+				next++;
+			}
+			else
+				break;
+		}
+		return bakeMesh(input, argc > next ? argv[next] : bakedModelPath(input), settings);
+	}
+	if (mode == "scene")
+		return bakeScene(input, argc > 3 ? argv[3] : binaryScenePath(input));
+	if (mode == "texture")
+	{
+		int next = 3;
+		uint32_t format = 0;
+		if (argc > next)
+		{
+			string name = argv[next];
+			if (name == "bc1")
+				format = BAKED_BC1;
+			else if (name == "bc3")
+				format = BAKED_BC3;
+			else if (name == "bc5")
+				format = BAKED_BC5;
+			if (format != 0)
+				next++;
+		}
+		return bakeTexture(input, argc > next ? argv[next] : bakedTexturePath(input), format) ? 0 : 1;
+	}
+
+	cout << "Unknown asset type '" << mode << "'" << endl;
+	printUsage();
+	return 1;
+}
@@ -0,0 +1,298 @@
+#include "texture_compressor.h"
+#include "../mechanics/stb_image.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+static uint16_t packRGB565(float r, float g, float b)
+{
+	auto clampRound = [](float value, int max)
+	{
+		int v = (int)std::lround(value * max / 255.0f);
+		return v < 0 ? 0 : (v > max ? max : v);
+	};
+	return (uint16_t)((clampRound(r, 31) << 11) | (clampRound(g, 63) << 5) | clampRound(b, 31));
+}
+
+static void unpackRGB565(uint16_t color, float rgb[3])
+{
+	int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+	rgb[0] = (float)((r << 3) | (r >> 2));
+	rgb[1] = (float)((g << 2) | (g >> 4));
+	rgb[2] = (float)((b << 3) | (b >> 2));
+}
+
+void compressBC1Block(const unsigned char block[64], unsigned char out[8])
+{
+	// fit the endpoints along the principal axis of the block's colors
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 3; c++)
+			mean[c] += block[i * 4 + c] / 16.0f;
+
+	float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		float r = block[i * 4] - mean[0], g = block[i * 4 + 1] - mean[1], b = block[i * 4 + 2] - mean[2];
+		cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+		cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+	}
+
+	// a few power iterations are plenty for a 3x3 matrix. Start from the column of the channel that
+	// varies most, (1,1,1) can be orthogonal to the axis, e.g. when red rises while green falls.
+	float axis[3] = { cov[0], cov[1], cov[2] };
+	if (cov[3] > cov[0] && cov[3] >= cov[5])
+	{
+		axis[0] = cov[1]; axis[1] = cov[3]; axis[2] = cov[4];
+	}
+	else if (cov[5] > cov[0] && cov[5] > cov[3])
+	{
+		axis[0] = cov[2]; axis[1] = cov[4]; axis[2] = cov[5];
+	}
+	float startLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	if (startLength < 1e-6f)
+	{
+		axis[0] = axis[1] = axis[2] = 0.57735f;
+	}
+	else
+	{
+		axis[0] /= startLength; axis[1] /= startLength; axis[2] /= startLength;
+	}
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		float length = std::sqrt(x * x + y * y + z * z);
+		if (length < 1e-6f)
+			break;
+		axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+	}
+
+	float minT = 0.0f, maxT = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = (block[i * 4] - mean[0]) * axis[0] + (block[i * 4 + 1] - mean[1]) * axis[1] + (block[i * 4 + 2] - mean[2]) * axis[2];
+		minT = t < minT ? t : minT;
+		maxT = t > maxT ? t : maxT;
+	}
+
+	uint16_t color0 = packRGB565(mean[0] + axis[0] * maxT, mean[1] + axis[1] * maxT, mean[2] + axis[2] * maxT);
+	uint16_t color1 = packRGB565(mean[0] + axis[0] * minT, mean[1] + axis[1] * minT, mean[2] + axis[2] * minT);
+	// color0 > color1 selects the four color mode
+	if (color0 < color1)
+	{
+		uint16_t swap = color0;
+		color0 = color1;
+		color1 = swap;
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1)
+	{
+		float palette[4][3];
+		unpackRGB565(color0, palette[0]);
+		unpackRGB565(color1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			uint32_t best = 0;
+			float bestError = 1e30f;
+			for (uint32_t p = 0; p < 4; p++)
+			{
+				float error = 0.0f;
+				for (int c = 0; c < 3; c++)
+				{
+					float d = block[i * 4 + c] - palette[p][c];
+					error += d * d;
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					best = p;
+				}
+			}
+			indices |= best << (i * 2);
+		}
+	}
+
+	out[0] = color0 & 0xFF;
+	out[1] = color0 >> 8;
+	out[2] = color1 & 0xFF;
+	out[3] = color1 >> 8;
+	for (int i = 0; i < 4; i++)
+		out[4 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+// single channel block, channel is the byte offset into each RGBA pixel
+static void compressBC4Block(const unsigned char block[64], int channel, unsigned char out[8])
+{
+	unsigned char minValue = 255, maxValue = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		unsigned char value = block[i * 4 + channel];
+		minValue = value < minValue ? value : minValue;
+		maxValue = value > maxValue ? value : maxValue;
+	}
+
+	uint64_t indices = 0;
+	if (maxValue != minValue)
+	{
+		// value0 > value1 selects the eight value mode
+		float palette[8];
+		palette[0] = maxValue;
+		palette[1] = minValue;
+		for (int p = 1; p < 7; p++)
+			palette[p + 1] = ((7 - p) * maxValue + p * minValue) / 7.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			uint64_t best = 0;
+			float bestError = 1e30f;
+			for (uint64_t p = 0; p < 8; p++)
+			{
+				float error = std::fabs(block[i * 4 + channel] - palette[p]);
+				if (error < bestError)
+				{
+					bestError = error;
+					best = p;
+				}
+			}
+			indices |= best << (i * 3);
+		}
+	}
+
+	out[0] = maxValue;
+	out[1] = minValue;
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+void compressBC3Block(const unsigned char block[64], unsigned char out[16])
+{
+	compressBC4Block(block, 3, out);
+	compressBC1Block(block, out + 8);
+}
+
+void compressBC5Block(const unsigned char block[64], unsigned char out[16])
+{
+	compressBC4Block(block, 0, out);
+	compressBC4Block(block, 1, out + 8);
+}
+
+// 2x2 box filter, odd edges reuse the last row or column
+static vector<unsigned char> downsample(const vector<unsigned char>& source, uint32_t width, uint32_t height)
+{
+	uint32_t newWidth = width > 1 ? width / 2 : 1;
+	uint32_t newHeight = height > 1 ? height / 2 : 1;
+	vector<unsigned char> result((size_t)newWidth * newHeight * 4);
+	for (uint32_t y = 0; y < newHeight; y++)
+	{
+		uint32_t y0 = y * 2, y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+		for (uint32_t x = 0; x < newWidth; x++)
+		{
+			uint32_t x0 = x * 2, x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+			for (int c = 0; c < 4; c++)
+			{
+				unsigned int sum = source[((size_t)y0 * width + x0) * 4 + c] + source[((size_t)y0 * width + x1) * 4 + c]
+					+ source[((size_t)y1 * width + x0) * 4 + c] + source[((size_t)y1 * width + x1) * 4 + c];
+				result[((size_t)y * newWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+	return result;
+}
+
+static vector<unsigned char> compressLevel(const vector<unsigned char>& pixels, uint32_t width, uint32_t height, uint32_t format)
+{
+	vector<unsigned char> result(bakedLevelSize(format, width, height));
+	unsigned int blockSize = bakedBlockSize(format);
+	unsigned char* out = result.data();
+	unsigned char block[64];
+	for (uint32_t by = 0; by < height; by += 4)
+	{
+		for (uint32_t bx = 0; bx < width; bx += 4)
+		{
+			// blocks hanging over the edge repeat the last pixels
+			for (uint32_t y = 0; y < 4; y++)
+			{
+				uint32_t sy = by + y < height ? by + y : height - 1;
+				for (uint32_t x = 0; x < 4; x++)
+				{
+					uint32_t sx = bx + x < width ? bx + x : width - 1;
+					memcpy(block + (y * 4 + x) * 4, &pixels[((size_t)sy * width + sx) * 4], 4);
+				}
+			}
+			if (format == BAKED_BC1)
+				compressBC1Block(block, out);
+			else if (format == BAKED_BC3)
+				compressBC3Block(block, out);
+			else
+				compressBC5Block(block, out);
+			out += blockSize;
+		}
+	}
+	return result;
+}
+
+bool bakeTexture(const string& sourcePath, const string& outputPath, uint32_t format)
+{
+	int width, height, components;
+	unsigned char* data = stbi_load(sourcePath.c_str(), &width, &height, &components, 4);
+	if (!data)
+	{
+		cout << "Baker: failed to load image " << sourcePath << endl;
+		return false;
+	}
+	vector<unsigned char> pixels(data, data + (size_t)width * height * 4);
+	stbi_image_free(data);
+
+	// match what the runtime uploads for the source: GL_RED and GL_RG leave the other channels empty
+	for (size_t i = 0; i < pixels.size(); i += 4)
+	{
+		if (components == 1)
+			pixels[i + 1] = pixels[i + 2] = 0;
+		else if (components == 2)
+		{
+			pixels[i + 1] = pixels[i + 3];
+			pixels[i + 2] = 0;
+			pixels[i + 3] = 255;
+		}
+	}
+
+	if (format == 0)
+	{
+		bool hasAlpha = false;
+		for (size_t i = 3; i < pixels.size() && components == 4; i += 4)
+			hasAlpha |= pixels[i] != 255;
+		format = hasAlpha ? BAKED_BC3 : (components == 2 ? BAKED_BC5 : BAKED_BC1);
+	}
+
+	BakedTextureData texture;
+	texture.format = (BakedTextureFormat)format;
+	texture.width = width;
+	texture.height = height;
+	uint32_t levelWidth = width, levelHeight = height;
+	while (true)
+	{
+		texture.levels.push_back(compressLevel(pixels, levelWidth, levelHeight, format));
+		if (levelWidth == 1 && levelHeight == 1)
+			break;
+		pixels = downsample(pixels, levelWidth, levelHeight);
+		levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+		levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+	}
+	texture.levelCount = (uint32_t)texture.levels.size();
+
+	if (!writeBakedTexture(outputPath, texture))
+		return false;
+
+	static const char* names[] = { "", "BC1", "BC3", "BC5" };
+	cout << "Baked " << sourcePath << " -> " << outputPath << ": " << width << "x" << height << " "
+		<< names[format] << ", " << texture.levelCount << " levels" << endl;
+	return true;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include "../mechanics/baked_texture.h"
+
+using namespace std;
+
+// Compresses 4x4 blocks of RGBA pixels. Offline only, quality over speed is fine here.
+void compressBC1Block(const unsigned char block[64], unsigned char out[8]);
+void compressBC3Block(const unsigned char block[64], unsigned char out[16]);
+// compresses the red and green channels
+void compressBC5Block(const unsigned char block[64], unsigned char out[16]);
+
+// Decodes an image, builds its mip chain and compresses every level. format 0 picks one from the
+// image: BC3 when it has alpha, BC5 for two channel images and BC1 otherwise.
+bool bakeTexture(const string& sourcePath, const string& outputPath, uint32_t format = 0);
@@ -0,0 +1,309 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+#define _USE_MATH_DEFINES
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <reactphysics3d/reactphysics3d.h>
+#include "../editor/scene_loader.h"
+#include "../editor/scene_manager.h"
+#include "../mechanics/arena.h"
+#include "../mechanics/physics_pipeline.h"
+#include "../mechanics/raycast_batch.h"
+#include <thread>
+using namespace reactphysics3d;
+
+// Headless fixed-step runner. Builds the arena (or a scene file), steps the physics world
+// with no window or GL context and reports throughput, step latency and allocations per step.
+// With --replay it runs a session recorded by the game (mechanics --record) instead, checking
+// every step against the recording. --raycasts times batched raycasts against the arena instead.
+//
+// Usage: bench [--scene <path>] [--steps <n>] [--warmup <n>] | --replay <path> | --raycasts
+
+const float _physicsTimestep = 1.0f / 60.0f;
+
+// Every heap allocation made through operator new, i.e. ours and the standard library's
+std::atomic<unsigned long long> heapAllocations(0);
+
+// Counts the allocations reactphysics3d makes through its base allocator
+class CountingAllocator : public MemoryAllocator
+{
+public:
+	unsigned long long allocations = 0;
+
+	virtual void* allocate(size_t size) override
+	{
+		allocations++;
+		return std::malloc(size);
+	}
+
+	virtual void release(void* pointer, size_t) override
+	{
+		std::free(pointer);
+	}
+};
+
+// The replacements allocate through these rather than calling malloc and free directly. Once GCC
+// inlines both into a caller it sees free on a pointer from operator new and warns
+// (-Wmismatched-new-delete), though the pair matches.
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+BENCH_NOINLINE static void* heapAllocate(size_t size)
+{
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+BENCH_NOINLINE static void heapFree(void* ptr)
+{
+	std::free(ptr);
+}
+
+void* operator new(size_t size)
+{
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	void* ptr = heapAllocate(size);
+	if (ptr == nullptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	heapFree(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	heapFree(ptr);
+}
+
+double percentile(const vector<double>& sorted, double p)
+{
+	if (sorted.empty())
+		return 0.0;
+	size_t ix = (size_t)(p * (sorted.size() - 1) + 0.5);
+	return sorted[ix];
+}
+
+// Casts batches of 1k, 10k and 100k random rays across the arena, on the calling thread only and
+// spread over the worker threads, and reports the best of a few runs
+int runRaycastBench()
+{
+	PhysicsCommon common;
+	PhysicsWorld* world = createArenaWorld(common);
+	EntityStore entities;
+	buildArena(common, world, entities, Vector3(10.0f, -4.0f, 0.0f), true);
+	for (unsigned int i = 0; i < 120; i++)
+	{
+		world->update(_physicsTimestep);
+	}
+
+	// same rays every run
+	unsigned int seed = 12345;
+	auto random = [&seed](float low, float high)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return low + (high - low) * ((seed >> 8) / 16777216.0f);
+	};
+	unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	RaycastBatcher serial;
+	RaycastBatcher parallel;
+	parallel.start(hardwareThreads - 1);
+	cout << "Bodies: " << entities.bodies.size() << ", worker threads: " << parallel.workerCount() << endl;
+
+	RayBatch batch;
+	RaycastHits hits;
+	const unsigned int runs = 5;
+	for (unsigned int rayCount : { 1000u, 10000u, 100000u })
+	{
+		batch.clear();
+		for (unsigned int i = 0; i < rayCount; i++)
+		{
+			Vector3 from(random(-160.0f, 160.0f), random(2.0f, 60.0f), random(-160.0f, 160.0f));
+			Vector3 direction(random(-1.0f, 1.0f), random(-1.0f, 0.2f), random(-1.0f, 1.0f));
+			// every other ray only looks for the ball and the floor, like a punch would
+			unsigned short mask = i % 2 == 0 ? 0xFFFF : (unsigned short)(CollisionCategories::BALL | CollisionCategories::FLOOR);
+			batch.add(from, from + 200.0f * direction, mask);
+		}
+		for (RaycastBatcher* batcher : { &serial, &parallel })
+		{
+			double best = 1e30;
+			for (unsigned int run = 0; run < runs; run++)
+			{
+				auto start = std::chrono::steady_clock::now();
+				batcher->cast(world, batch, hits);
+				auto end = std::chrono::steady_clock::now();
+				best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+			}
+			cout << rayCount << " rays, " << batcher->workerCount() + 1 << " thread(s): " << best << "ms, "
+				<< (best > 0.0 ? rayCount / best / 1000.0 : 0.0) << " Mrays/s, " << hits.hitCount() << " hits" << endl;
+		}
+	}
+
+	parallel.stop();
+	for (unsigned int i = 0; i < entities.bodies.size(); i++)
+	{
+		world->destroyRigidBody(entities.bodies.at(i).body);
+	}
+	entities.clear();
+	common.destroyPhysicsWorld(world);
+	return 0;
+}
+
+// Replays a recording through the same pipeline the game uses, without a worker or interpolation
+int runReplay(const string& path)
+{
+	PhysicsReplay replay;
+	if (!replay.open(path))
+		return -1;
+	const RecordingHeader& header = replay.getHeader();
+
+	PhysicsCommon common;
+	PhysicsWorld* world = createArenaWorld(common);
+	EntityStore entities;
+	Vector3 cameraStart(header.cameraStart[0], header.cameraStart[1], header.cameraStart[2]);
+	auto arena = buildArena(common, world, entities, cameraStart, header.ballUsesGravity != 0);
+	if (header.bodyCount != entities.bodies.size())
+		cout << "Recording was made with " << header.bodyCount << " bodies, the arena has " << entities.bodies.size() << endl;
+
+	PhysicsPipeline pipeline;
+	pipeline.applyCommand = [&arena](PhysicsWorld*, const PhysicsCommand& command)
+	{
+		applyArenaCommand(arena, command);
+	};
+	TimestepSettings settings;
+	settings.timestep = header.timestep;
+	pipeline.setReplay(&replay);
+	pipeline.start(world, &entities, nullptr, settings, false);
+
+	vector<double> frameMicros;
+	auto runStart = std::chrono::steady_clock::now();
+	while (true)
+	{
+		auto frameStart = std::chrono::steady_clock::now();
+		pipeline.submit(0.0f);
+		if (pipeline.replayFinished())
+			break;
+		auto frameEnd = std::chrono::steady_clock::now();
+		frameMicros.push_back(std::chrono::duration<double, std::micro>(frameEnd - frameStart).count());
+	}
+	auto runEnd = std::chrono::steady_clock::now();
+	double totalSeconds = std::chrono::duration<double>(runEnd - runStart).count();
+	std::sort(frameMicros.begin(), frameMicros.end());
+
+	cout << "Replayed " << frameMicros.size() << " frames in " << totalSeconds << "s" << endl;
+	cout << "Frame simulation p50: " << percentile(frameMicros, 0.50) << "us" << endl;
+	cout << "Frame simulation p99: " << percentile(frameMicros, 0.99) << "us" << endl;
+	cout << "Frame simulation max: " << (frameMicros.empty() ? 0.0 : frameMicros.back()) << "us" << endl;
+	unsigned int mismatches = pipeline.replayMismatches();
+	cout << (mismatches == 0 ? "Every step matched the recording" : "Steps that differed from the recording: " + to_string(mismatches)) << endl;
+
+	pipeline.stop();
+	for (unsigned int i = 0; i < entities.bodies.size(); i++)
+	{
+		world->destroyRigidBody(entities.bodies.at(i).body);
+	}
+	entities.clear();
+	common.destroyPhysicsWorld(world);
+	return mismatches == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	string scenePath = "";
+	unsigned int steps = 10000;
+	unsigned int warmup = 120;
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if (arg == "--scene" && i + 1 < argc)
+			scenePath = argv[++i];
+		else if (arg == "--steps" && i + 1 < argc)
+			steps = stoul(argv[++i]);
+		else if (arg == "--warmup" && i + 1 < argc)
+			warmup = stoul(argv[++i]);
+		else if (arg == "--replay" && i + 1 < argc)
+			return runReplay(argv[++i]);
+		else if (arg == "--raycasts")
+			return runRaycastBench();
+		else
+		{
+			cout << "Usage: " << argv[0] << " [--scene <path>] [--steps <n>] [--warmup <n>] | --replay <path> | --raycasts" << endl;
+			return -1;
+		}
+	}
+
+	CountingAllocator allocator;
+	PhysicsCommon common(&allocator);
+	PhysicsWorld* world = nullptr;
+	EntityStore* entities = nullptr;
+
+	if (scenePath != "")
+	{
+		SceneLoader loader;
+		auto header = loader.loadScene(scenePath, "bench", &common, nullptr);
+		if (header == nullptr)
+			return -1;
+		world = header->world;
+		entities = header->entities;
+		cout << "Loaded scene '" << header->name << "' from " << scenePath << endl;
+	}
+	else
+	{
+		world = createArenaWorld(common);
+		entities = new EntityStore;
+		// Let the ball fall so there is something for the solver to do
+		buildArena(common, world, *entities, Vector3(10.0f, -4.0f, 0.0f), true);
+		cout << "Built hardcoded arena" << endl;
+	}
+	cout << "Bodies: " << entities->bodies.size() << ", warmup steps: " << warmup << ", measured steps: " << steps << endl;
+
+	for (unsigned int i = 0; i < warmup; i++)
+	{
+		world->update(_physicsTimestep);
+	}
+
+	vector<double> stepMicros(steps);
+	auto rp3dAllocsBefore = allocator.allocations;
+	auto heapAllocsBefore = heapAllocations.load();
+	auto runStart = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < steps; i++)
+	{
+		auto stepStart = std::chrono::steady_clock::now();
+		world->update(_physicsTimestep);
+		auto stepEnd = std::chrono::steady_clock::now();
+		stepMicros[i] = std::chrono::duration<double, std::micro>(stepEnd - stepStart).count();
+	}
+	auto runEnd = std::chrono::steady_clock::now();
+	auto rp3dAllocs = allocator.allocations - rp3dAllocsBefore;
+	auto heapAllocs = heapAllocations.load() - heapAllocsBefore;
+
+	double totalSeconds = std::chrono::duration<double>(runEnd - runStart).count();
+	std::sort(stepMicros.begin(), stepMicros.end());
+	double perStep = steps > 0 ? 1.0 / steps : 0.0;
+
+	cout << "Steps/sec: " << (totalSeconds > 0.0 ? steps / totalSeconds : 0.0) << endl;
+	cout << "Step latency p50: " << percentile(stepMicros, 0.50) << "us" << endl;
+	cout << "Step latency p99: " << percentile(stepMicros, 0.99) << "us" << endl;
+	cout << "Step latency max: " << (steps > 0 ? stepMicros.back() : 0.0) << "us" << endl;
+	cout << "Physics allocations/step: " << rp3dAllocs * perStep << endl;
+	cout << "Heap allocations/step: " << heapAllocs * perStep << endl;
+
+	for (unsigned int i = 0; i < entities->bodies.size(); i++)
+	{
+		world->destroyRigidBody(entities->bodies.at(i).body);
+	}
+	delete entities;
+	common.destroyPhysicsWorld(world);
+	return 0;
+}
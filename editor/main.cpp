@@ -7,7 +7,7 @@
 #include <GLFW/glfw3.h>
 #include <nanogui/nanogui.h>
 #include "../mechanics/camera.h"
-#include "..\mechanics\model.h"
+#include "../mechanics/model.h"
 #include <reactphysics3d/reactphysics3d.h>
 #include <iostream>
 using namespace std;
@@ -47,7 +47,7 @@ const int SCR_WIDTH = 1920;
 const int SCR_HEIGHT = 1080;
 
 // camera
-Camera camera(glm::vec3(10.0f, -10.0f, 0.0f));
+Camera camera;
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
@@ -105,6 +105,10 @@ int main()
 	// tell GLFW to capture our mouse
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
+	// editor camera flies freely, so the constraint box is unused
+	camera.Init(glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(10.0f, -10.0f, 0.0f));
+	camera.constrain = false;
+
 	glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_FRAMEBUFFER_SRGB);
@@ -0,0 +1,282 @@
+#include "scene_binary.h"
+#include "../mechanics/mapped_file.h"
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <unordered_map>
+#include <string_view>
+
+// Collects the strings of a scene into one table
+struct StringTableBuilder
+{
+	vector<char> data;
+
+	uint32_t add(const string& str)
+	{
+		uint32_t offset = (uint32_t)data.size();
+		data.insert(data.end(), str.begin(), str.end());
+		data.push_back('\0');
+		return offset;
+	}
+};
+
+static void writeTransform(const Transform& transform, decimal out[7])
+{
+	const Vector3& position = transform.getPosition();
+	const Quaternion& orientation = transform.getOrientation();
+	out[0] = position.x; out[1] = position.y; out[2] = position.z;
+	out[3] = orientation.x; out[4] = orientation.y; out[5] = orientation.z; out[6] = orientation.w;
+}
+
+static Transform readTransform(const decimal in[7])
+{
+	return Transform(Vector3(in[0], in[1], in[2]), Quaternion(in[3], in[4], in[5], in[6]));
+}
+
+bool writeSceneBinary(const string& path, const string& name, EntityStore* entities, PhysicsWorld* world)
+{
+	StringTableBuilder strings;
+	BinarySceneHeader header = {};
+	memcpy(header.magic, BINARY_SCENE_MAGIC, sizeof(BINARY_SCENE_MAGIC));
+	header.version = BINARY_SCENE_VERSION;
+	header.decimalSize = sizeof(decimal);
+	header.name = strings.add(name);
+	header.renderCount = entities->renderables.size();
+	header.physicsCount = entities->bodies.size();
+	header.sleepingEnabled = world->isSleepingEnabled();
+	header.velocityIterations = world->getNbIterationsVelocitySolver();
+	header.positionIterations = world->getNbIterationsPositionSolver();
+	Vector3 gravity = world->getGravity();
+	header.gravity[0] = gravity.x;
+	header.gravity[1] = gravity.y;
+	header.gravity[2] = gravity.z;
+
+	vector<BinaryRenderRecord> renderRecords(header.renderCount);
+	for (unsigned int i = 0; i < header.renderCount; i++)
+	{
+		EntityId entity = entities->renderables.entity(i);
+		const RenderComponent& render = entities->renderables.at(i);
+		const Transform* transform = entities->transforms.find(entity);
+		BinaryRenderRecord& record = renderRecords[i];
+		record = {};
+		record.name = strings.add(entities->name(entity));
+		record.modelPath = strings.add(render.model ? render.model->model_path : "");
+		record.shaderIndex = render.shader_index;
+		writeTransform(transform ? *transform : Transform::identity(), record.transform);
+	}
+
+	vector<BinaryPhysicsRecord> physicsRecords(header.physicsCount);
+	for (unsigned int i = 0; i < header.physicsCount; i++)
+	{
+		BinaryPhysicsRecord& record = physicsRecords[i];
+		record = {};
+		RigidBody* body = entities->bodies.at(i).body;
+		Collider* collider = entities->bodies.at(i).collider;
+		record.name = strings.add(entities->name(entities->bodies.entity(i)));
+		record.bodyType = (uint32_t)body->getType();
+		record.sleepEnabled = body->isAllowedToSleep();
+		writeTransform(body->getTransform(), record.transform);
+
+		CollisionShape* shape = collider->getCollisionShape();
+		record.shapeType = (uint32_t)shape->getName();
+		switch (shape->getName())
+		{
+		case CollisionShapeName::BOX:
+		{
+			Vector3 extents = static_cast<BoxShape*>(shape)->getHalfExtents();
+			record.shapeValues[0] = extents.x;
+			record.shapeValues[1] = extents.y;
+			record.shapeValues[2] = extents.z;
+			break;
+		}
+		case CollisionShapeName::CAPSULE:
+			record.shapeValues[0] = static_cast<CapsuleShape*>(shape)->getHeight();
+			record.shapeValues[1] = static_cast<CapsuleShape*>(shape)->getRadius();
+			break;
+		case CollisionShapeName::SPHERE:
+			record.shapeValues[0] = static_cast<SphereShape*>(shape)->getRadius();
+			break;
+		default:
+			// the loader couldn't rebuild the shape, neither can the text format
+			cout << "Scene '" << path << "': unsupported collision shape on '" << entities->name(entities->bodies.entity(i)) << "'. Failed." << endl;
+			return false;
+		}
+
+		Material& material = collider->getMaterial();
+		record.bounciness = material.getBounciness();
+		record.friction = material.getFrictionCoefficient();
+		record.rollingResistance = material.getRollingResistance();
+		record.massDensity = material.getMassDensity();
+		record.categoryBits = collider->getCollisionCategoryBits();
+		record.collideMaskBits = collider->getCollideWithMaskBits();
+	}
+
+	header.stringTableOffset = sizeof(BinarySceneHeader)
+		+ renderRecords.size() * sizeof(BinaryRenderRecord)
+		+ physicsRecords.size() * sizeof(BinaryPhysicsRecord);
+	header.stringTableSize = (uint32_t)strings.data.size();
+	header.fileSize = header.stringTableOffset + header.stringTableSize;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		cout << "Could not open scene file at location: '" << path << "'." << endl;
+		return false;
+	}
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)renderRecords.data(), renderRecords.size() * sizeof(BinaryRenderRecord));
+	file.write((const char*)physicsRecords.data(), physicsRecords.size() * sizeof(BinaryPhysicsRecord));
+	file.write(strings.data.data(), strings.data.size());
+	return file.good();
+}
+
+static bool validHeader(const BinarySceneHeader* header, size_t size)
+{
+	if (memcmp(header->magic, BINARY_SCENE_MAGIC, sizeof(BINARY_SCENE_MAGIC)) != 0
+		|| header->version != BINARY_SCENE_VERSION
+		|| header->decimalSize != sizeof(decimal)
+		|| header->fileSize != size)
+		return false;
+	uint64_t records = sizeof(BinarySceneHeader)
+		+ (uint64_t)header->renderCount * sizeof(BinaryRenderRecord)
+		+ (uint64_t)header->physicsCount * sizeof(BinaryPhysicsRecord);
+	// the table has to end in a terminator so no string can run past it
+	return header->stringTableOffset == records
+		&& header->stringTableOffset + header->stringTableSize == size
+		&& header->stringTableSize > 0;
+}
+
+SceneHeader* loadSceneBinary(const string& path, PhysicsCommon* common, AssetCache* assets)
+{
+	MappedFile file;
+	if (!file.open(path))
+	{
+		cout << "Could not open file at location '" << path << "'. Failed." << endl;
+		return nullptr;
+	}
+	if (file.size() < sizeof(BinarySceneHeader))
+	{
+		cout << "Scene file '" << path << "' is truncated." << endl;
+		return nullptr;
+	}
+	const unsigned char* data = file.data();
+	const BinarySceneHeader* fileHeader = reinterpret_cast<const BinarySceneHeader*>(data);
+	if (!validHeader(fileHeader, file.size()) || data[file.size() - 1] != '\0')
+	{
+		cout << "Scene file '" << path << "' is not a valid binary scene of this version." << endl;
+		return nullptr;
+	}
+	const BinaryRenderRecord* renderRecords = reinterpret_cast<const BinaryRenderRecord*>(data + sizeof(BinarySceneHeader));
+	const BinaryPhysicsRecord* physicsRecords = reinterpret_cast<const BinaryPhysicsRecord*>(renderRecords + fileHeader->renderCount);
+	const char* strings = reinterpret_cast<const char*>(data + fileHeader->stringTableOffset);
+	auto stringAt = [&](uint32_t offset)
+	{
+		return offset < fileHeader->stringTableSize ? string_view(strings + offset) : string_view();
+	};
+
+	SceneHeader* header = new SceneHeader;
+	header->path = path;
+	header->name = stringAt(fileHeader->name);
+	header->entities = new EntityStore;
+	EntityStore* entities = header->entities;
+
+	PhysicsWorld::WorldSettings settings;
+	settings.gravity = Vector3(fileHeader->gravity[0], fileHeader->gravity[1], fileHeader->gravity[2]);
+	settings.isSleepingEnabled = fileHeader->sleepingEnabled != 0;
+	settings.defaultVelocitySolverNbIterations = fileHeader->velocityIterations;
+	settings.defaultPositionSolverNbIterations = fileHeader->positionIterations;
+	PhysicsWorld* world = common->createPhysicsWorld(settings);
+	world->setIsDebugRenderingEnabled(true); // TODO: Hardcoded, we could make this configurable.
+	header->world = world;
+
+	// physics records join the render entity of the same name
+	unordered_map<string_view, EntityId> renderEntities;
+	for (uint32_t i = 0; i < fileHeader->renderCount; i++)
+	{
+		const BinaryRenderRecord& record = renderRecords[i];
+		string_view name = stringAt(record.name);
+		RenderComponent render;
+		string modelPath(stringAt(record.modelPath));
+		if (assets != nullptr)
+		{
+			render.model = assets->model(modelPath);
+		}
+		else
+		{
+			render.model = make_shared<Model>();
+			render.model->model_path = modelPath;
+		}
+		render.shader_index = record.shaderIndex;
+		EntityId entity = entities->create(string(name));
+		entities->transforms.add(entity, readTransform(record.transform));
+		entities->renderables.add(entity, std::move(render));
+		if (!name.empty())
+			renderEntities.emplace(name, entity);
+	}
+
+	for (uint32_t i = 0; i < fileHeader->physicsCount; i++)
+	{
+		const BinaryPhysicsRecord& record = physicsRecords[i];
+		string_view name = stringAt(record.name);
+		auto match = renderEntities.find(name);
+		EntityId entity;
+		if (match != renderEntities.end() && !entities->bodies.has(match->second))
+			entity = match->second;
+		else
+			entity = entities->create(string(name));
+
+		Transform transform = readTransform(record.transform);
+		RigidBody* body = world->createRigidBody(transform);
+		body->setType(record.bodyType <= (uint32_t)BodyType::DYNAMIC ? (BodyType)record.bodyType : BodyType::STATIC);
+		body->setIsAllowedToSleep(record.sleepEnabled != 0);
+
+		CollisionShape* shape = nullptr;
+		switch ((CollisionShapeName)record.shapeType)
+		{
+		case CollisionShapeName::BOX:
+			shape = common->createBoxShape(Vector3(record.shapeValues[0], record.shapeValues[1], record.shapeValues[2]));
+			break;
+		case CollisionShapeName::CAPSULE:
+			shape = common->createCapsuleShape(record.shapeValues[1], record.shapeValues[0]);
+			break;
+		case CollisionShapeName::SPHERE:
+			shape = common->createSphereShape(record.shapeValues[0]);
+			break;
+		default:
+			break;
+		}
+		// like the text loader, a body without its collider would break saving the scene again
+		if (shape == nullptr)
+		{
+			cout << "Scene '" << path << "': unsupported collision shape on '" << name << "'. Failed." << endl;
+			common->destroyPhysicsWorld(world);
+			delete entities;
+			delete header;
+			return nullptr;
+		}
+
+		Collider* coll = body->addCollider(shape, Transform::identity()); // Hardcoding this offset transform for now
+		coll->getMaterial().setBounciness(record.bounciness);
+		coll->getMaterial().setFrictionCoefficient(record.friction);
+		coll->getMaterial().setRollingResistance(record.rollingResistance);
+		coll->getMaterial().setMassDensity(record.massDensity);
+		coll->setCollisionCategoryBits(record.categoryBits);
+		coll->setCollideWithMaskBits(record.collideMaskBits);
+		entities->bodies.add(entity, { body, coll });
+	}
+	return header;
+}
+
+bool isBinaryScene(const string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	char magic[4] = {};
+	file.read(magic, sizeof(magic));
+	return file.good() && memcmp(magic, BINARY_SCENE_MAGIC, sizeof(magic)) == 0;
+}
+
+string binaryScenePath(const string& textPath)
+{
+	return std::filesystem::path(textPath).replace_extension(BINARY_SCENE_EXTENSION).string();
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <reactphysics3d/reactphysics3d.h>
+#include "../mechanics/asset_cache.h"
+#include "scene_manager.h"
+
+using namespace std;
+using namespace reactphysics3d;
+
+// Binary scene format. The whole file is read through one memory mapping and every record has a
+// fixed size, so loading is a walk over arrays with no parsing. Numbers are stored in their
+// in-memory representation, which keeps transforms bit exact across a save and load.
+//
+// Layout (little endian):
+//   BinarySceneHeader
+//   BinaryRenderRecord[renderCount]
+//   BinaryPhysicsRecord[physicsCount]
+//   string table: zero terminated strings, records refer to them by offset into the table
+//
+// The text format written by SceneLoader::writeSceneToDisk stays the interchange format, the
+// baker converts it: baker scene scene1.scene -> scene1.bscene
+
+const char BINARY_SCENE_MAGIC[4] = { 'M', 'S', 'C', 'N' };
+const uint32_t BINARY_SCENE_VERSION = 1;
+const char* const BINARY_SCENE_EXTENSION = ".bscene";
+
+struct BinarySceneHeader
+{
+	char magic[4];
+	uint32_t version;
+	// sizeof(decimal), files from a build with the other precision are rejected
+	uint32_t decimalSize;
+	uint32_t name;
+	uint32_t renderCount;
+	uint32_t physicsCount;
+	uint32_t sleepingEnabled;
+	uint32_t velocityIterations;
+	uint32_t positionIterations;
+	uint32_t stringTableSize;
+	uint64_t stringTableOffset;
+	uint64_t fileSize;
+	decimal gravity[3];
+	// keeps the size a multiple of 8 with either precision
+	decimal reserved;
+};
+
+struct BinaryRenderRecord
+{
+	uint32_t name;
+	uint32_t modelPath;
+	uint32_t shaderIndex;
+	uint32_t reserved;
+	// position xyz then orientation xyzw
+	decimal transform[7];
+};
+
+struct BinaryPhysicsRecord
+{
+	uint32_t name;
+	uint32_t bodyType;
+	uint32_t sleepEnabled;
+	uint32_t shapeType;
+	decimal transform[7];
+	// box: half extents, capsule: height and radius, sphere: radius
+	decimal shapeValues[3];
+	decimal bounciness;
+	decimal friction;
+	decimal rollingResistance;
+	decimal massDensity;
+	uint16_t categoryBits;
+	uint16_t collideMaskBits;
+	uint32_t reserved;
+};
+
+static_assert(sizeof(BinarySceneHeader) == (sizeof(decimal) == 4 ? 72 : 88), "BinarySceneHeader layout changed, bump BINARY_SCENE_VERSION");
+static_assert(sizeof(BinaryRenderRecord) == (sizeof(decimal) == 4 ? 44 : 72), "BinaryRenderRecord layout changed, bump BINARY_SCENE_VERSION");
+static_assert(sizeof(BinaryPhysicsRecord) == (sizeof(decimal) == 4 ? 80 : 136), "BinaryPhysicsRecord layout changed, bump BINARY_SCENE_VERSION");
+
+// Writes the scene to a binary file. Returns false if it couldn't be written, or if a collider has
+// a shape the format can't store.
+// Like the text format, an entity with a model and a body is stored as one record of each with the same name.
+bool writeSceneBinary(const string& path, const string& name, EntityStore* entities, PhysicsWorld* world);
+
+// Loads a binary scene, creating the world through common. Returns nullptr if the file is missing or invalid.
+SceneHeader* loadSceneBinary(const string& path, PhysicsCommon* common, AssetCache* assets);
+
+// True when the file starts with the binary scene magic
+bool isBinaryScene(const string& path);
+
+// The binary file that belongs to a text scene, e.g. scene1.scene -> scene1.bscene
+string binaryScenePath(const string& textPath);
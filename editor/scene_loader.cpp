@@ -0,0 +1,180 @@
+#include "scene_loader.h"
+#include <charconv>
+
+// shortest text that reads back to the same value, to_string would round to 6 decimals
+string decimalSer(decimal val)
+{
+	char buffer[32];
+	auto result = std::to_chars(buffer, buffer + sizeof(buffer), val);
+	return string(buffer, result.ptr);
+}
+
+string boolSer(bool val)
+{
+	if (val)
+	{
+		return "1";
+	}
+	return "0";
+}
+bool boolDeSer(string_view val, bool& out)
+{
+	if (val != "0" && val != "1")
+		return false;
+	out = val == "1";
+	return true;
+}
+string vec3Ser(Vector3 val)
+{
+	string str = "";
+	str += decimalSer(val.x);
+	str += ",";
+	str += decimalSer(val.y);
+	str += ",";
+	str += decimalSer(val.z);
+	return str;
+}
+bool vec3DeSer(string_view val, Vector3& out)
+{
+	decimal values[3];
+	if (!parseDecimals(val, values, 3))
+		return false;
+	out = Vector3(values[0], values[1], values[2]);
+	return true;
+}
+string transformSer(Transform val)
+{
+	auto pos = val.getPosition();
+	auto quat = val.getOrientation();
+	string str = "";
+	str += vec3Ser(pos);
+	str += ",";
+	str += decimalSer(quat.x);
+	str += ",";
+	str += decimalSer(quat.y);
+	str += ",";
+	str += decimalSer(quat.z);
+	str += ",";
+	str += decimalSer(quat.w);
+	return str;
+}
+
+bool transformDeSer(string_view val, Transform& out)
+{
+	decimal values[7];
+	if (!parseDecimals(val, values, 7))
+		return false;
+	out = Transform(Vector3(values[0], values[1], values[2]), Quaternion(values[3], values[4], values[5], values[6]));
+	return true;
+}
+
+string bodyTypeSer(BodyType val)
+{
+	switch (val)
+	{
+	case BodyType::STATIC: return "0";
+	case BodyType::KINEMATIC: return "1";
+	case BodyType::DYNAMIC: return "2";
+	}
+	return "0";
+}
+
+bool bodyTypeDeSer(string_view val, BodyType& out)
+{
+	if (val == "0") out = BodyType::STATIC;
+	else if (val == "1") out = BodyType::KINEMATIC;
+	else if (val == "2") out = BodyType::DYNAMIC;
+	else return false;
+	return true;
+}
+
+string collShapeNameSer(CollisionShapeName val)
+{
+	switch (val)
+	{
+	case CollisionShapeName::TRIANGLE: return "triangle";
+	case CollisionShapeName::SPHERE: return "sphere";
+	case CollisionShapeName::CAPSULE: return "capsule";
+	case CollisionShapeName::BOX: return "box";
+	}
+	return "box";
+}
+
+bool collShapeNameDeSer(string_view val, CollisionShapeName& out)
+{
+	if (val == "triangle") out = CollisionShapeName::TRIANGLE;
+	else if (val == "capsule") out = CollisionShapeName::CAPSULE;
+	else if (val == "sphere") out = CollisionShapeName::SPHERE;
+	else if (val == "box") out = CollisionShapeName::BOX;
+	else return false;
+	return true;
+}
+
+string collShapeInitSer(CollisionShape* val)
+{
+	string str = "";
+	switch (val->getName())
+	{
+	case CollisionShapeName::TRIANGLE:
+	{
+		auto tri = dynamic_cast<TriangleShape*>(val);
+		// TODO: Implement
+		break;
+	}
+	case CollisionShapeName::BOX:
+	{
+		auto box = dynamic_cast<BoxShape*>(val);
+		str = vec3Ser(box->getHalfExtents());
+		break;
+	}
+	case CollisionShapeName::CAPSULE:
+	{
+		auto cap = dynamic_cast<CapsuleShape*>(val);
+		str += decimalSer(cap->getHeight());
+		str += ",";
+		str += decimalSer(cap->getRadius());
+		break;
+	}
+	case CollisionShapeName::SPHERE:
+	{
+		auto sp = dynamic_cast<SphereShape*>(val);
+		str += decimalSer(sp->getRadius());
+		break;
+	}
+	}
+	return str;
+}
+
+CollisionShape* collShapeInitDeSer(CollisionShapeName name, PhysicsCommon* common, string_view val)
+{
+	switch (name)
+	{
+	case CollisionShapeName::TRIANGLE:
+	{
+		// TODO: Implement
+		return nullptr;
+	}
+	case CollisionShapeName::BOX:
+	{
+		Vector3 extents;
+		if (!vec3DeSer(val, extents))
+			return nullptr;
+		return common->createBoxShape(extents);
+	}
+	case CollisionShapeName::CAPSULE:
+	{
+		decimal values[2];
+		if (!parseDecimals(val, values, 2))
+			return nullptr;
+		return common->createCapsuleShape(values[1], values[0]);
+	}
+	case CollisionShapeName::SPHERE:
+	{
+		decimal radius;
+		if (!parseNumber(val, radius))
+			return nullptr;
+		return common->createSphereShape(radius);
+	}
+	}
+	return nullptr;
+}
@@ -1,33 +1,36 @@
 #pragma once
 #include <iostream>
-#include "..\mechanics\model.h"
+#include "../mechanics/model.h"
+#include "../mechanics/asset_cache.h"
 #include <reactphysics3d/reactphysics3d.h>
 #include "scene_manager.h"
+#include "scene_binary.h"
+#include "scene_tokenizer.h"
+#include "../mechanics/mapped_file.h"
+#include <unordered_map>
 
 using namespace std;
 using namespace reactphysics3d;
 
+string decimalSer(decimal val);
 string boolSer(bool val);
-bool boolDeSer(string val);
+bool boolDeSer(string_view val, bool& out);
 string transformSer(Transform val);
-Transform transformDeSer(string val);
+bool transformDeSer(string_view val, Transform& out);
 string vec3Ser(Vector3 val);
-Vector3 vec3DeSer(string val);
+bool vec3DeSer(string_view val, Vector3& out);
 string bodyTypeSer(BodyType val);
-BodyType bodyTypeDeSer(string val);
+bool bodyTypeDeSer(string_view val, BodyType& out);
 string collShapeNameSer(CollisionShapeName val);
-CollisionShapeName collShapeNameDeSer(string val);
+bool collShapeNameDeSer(string_view val, CollisionShapeName& out);
 string collShapeInitSer(CollisionShape* val);
-CollisionShape* collShapeInitDeSer(CollisionShapeName name, PhysicsCommon* common, string val);
-vector<string> split(const string str, string delimiter);
-vector<string> line_split(const string line);
+CollisionShape* collShapeInitDeSer(CollisionShapeName name, PhysicsCommon* common, string_view val);
 
 struct SceneLoader
 {
 	bool writeSceneToDisk(string pathWithNameAndExt,
 		string name,
-		struct RenderingState* renders,
-		struct PhysicsState* phy_entities,
+		EntityStore* entities,
 		PhysicsWorld* world)
 	{
 		std::ofstream sceneFile;
@@ -49,35 +52,42 @@ struct SceneLoader
 			sceneFile << "phy_gravity:" << vec3Ser(world->getGravity()) << "\t";
 			sceneFile << "phy_velocity_iterations:" << world->getNbIterationsVelocitySolver() << "\t";
 			sceneFile << "phy_position_iterations:" << world->getNbIterationsPositionSolver() << "\t";
-			sceneFile << "render_obj_count:" << renders->length << "\t";
-			sceneFile << "phy_obj_count:" << phy_entities->length << "\t";
+			sceneFile << "render_obj_count:" << entities->renderables.size() << "\t";
+			sceneFile << "phy_obj_count:" << entities->bodies.size() << "\t";
 			sceneFile << "\n";
 
 			sceneFile << "***START RENDER DATA***\n";
-			for (unsigned int i = 0; i < renders->length; i++)
+			// an entity with a body and a model is written to both sections under the same name,
+			// that is what joins them up again on load
+			for (unsigned int i = 0; i < entities->renderables.size(); i++)
 			{
-				sceneFile << "name:" << renders->names[i] << "\t";
-				sceneFile << "transform:" << transformSer(renders->transforms[i]) << "\t";
-				sceneFile << "model_path:" << renders->models[i].model_path << "\t";
-				sceneFile << "shader_index:" << to_string(renders->shader_indices[i]);
+				EntityId entity = entities->renderables.entity(i);
+				const RenderComponent& render = entities->renderables.at(i);
+				const Transform* transform = entities->transforms.find(entity);
+				sceneFile << "name:" << entities->name(entity) << "\t";
+				sceneFile << "transform:" << transformSer(transform ? *transform : Transform::identity()) << "\t";
+				sceneFile << "model_path:" << (render.model ? render.model->model_path : "") << "\t";
+				sceneFile << "shader_index:" << to_string(render.shader_index);
 				sceneFile << "\n";
 			}
 
 			sceneFile << "***START PHYSICS DATA***\n";
-			for (unsigned int i = 0; i < phy_entities->length; i++)
+			for (unsigned int i = 0; i < entities->bodies.size(); i++)
 			{
-				sceneFile << "phy_obj_name:" << phy_entities->names[i] << "\t";
-				sceneFile << "rbody_transform:" << transformSer(phy_entities->bodies[i]->getTransform()) << "\t";
-				sceneFile << "rbody_type:" << bodyTypeSer(phy_entities->bodies[i]->getType()) << "\t";
-				sceneFile << "rbody_sleep_enabled:" << phy_entities->bodies[i]->isAllowedToSleep() << "\t";
-				sceneFile << "collider_shape_type:" << collShapeNameSer(phy_entities->colliders[i]->getCollisionShape()->getName()) << "\t";
-				sceneFile << "collider_shape_values:" << collShapeInitSer(phy_entities->colliders[i]->getCollisionShape()) << "\t";
-				sceneFile << "collider_mat_bounciness:" << to_string(phy_entities->colliders[i]->getMaterial().getBounciness()) << "\t";
-				sceneFile << "collider_mat_friction:" << to_string(phy_entities->colliders[i]->getMaterial().getFrictionCoefficient()) << "\t";
-				sceneFile << "collider_mat_rolling_resist:" << to_string(phy_entities->colliders[i]->getMaterial().getRollingResistance()) << "\t";
-				sceneFile << "collider_mat_mass_density:" << to_string(phy_entities->colliders[i]->getMaterial().getMassDensity()) << "\t";
-				sceneFile << "collider_category_bits:" << to_string(phy_entities->colliders[i]->getCollisionCategoryBits()) << "\t";
-				sceneFile << "collider_collide_mask_bits:" << to_string(phy_entities->colliders[i]->getCollideWithMaskBits());
+				RigidBody* body = entities->bodies.at(i).body;
+				Collider* collider = entities->bodies.at(i).collider;
+				sceneFile << "phy_obj_name:" << entities->name(entities->bodies.entity(i)) << "\t";
+				sceneFile << "rbody_transform:" << transformSer(body->getTransform()) << "\t";
+				sceneFile << "rbody_type:" << bodyTypeSer(body->getType()) << "\t";
+				sceneFile << "rbody_sleep_enabled:" << body->isAllowedToSleep() << "\t";
+				sceneFile << "collider_shape_type:" << collShapeNameSer(collider->getCollisionShape()->getName()) << "\t";
+				sceneFile << "collider_shape_values:" << collShapeInitSer(collider->getCollisionShape()) << "\t";
+				sceneFile << "collider_mat_bounciness:" << decimalSer(collider->getMaterial().getBounciness()) << "\t";
+				sceneFile << "collider_mat_friction:" << decimalSer(collider->getMaterial().getFrictionCoefficient()) << "\t";
+				sceneFile << "collider_mat_rolling_resist:" << decimalSer(collider->getMaterial().getRollingResistance()) << "\t";
+				sceneFile << "collider_mat_mass_density:" << decimalSer(collider->getMaterial().getMassDensity()) << "\t";
+				sceneFile << "collider_category_bits:" << to_string(collider->getCollisionCategoryBits()) << "\t";
+				sceneFile << "collider_collide_mask_bits:" << to_string(collider->getCollideWithMaskBits());
 				sceneFile << "\n";
 			}
 
@@ -93,89 +103,166 @@ struct SceneLoader
 		return true;
 	}
 
-	struct SceneHeader* loadScene(string pathWithNameAndExt, string name)
+	// Same scene as writeSceneToDisk in the binary format, which loads much faster
+	bool writeSceneBinaryToDisk(string pathWithNameAndExt,
+		string name,
+		EntityStore* entities,
+		PhysicsWorld* world)
+	{
+		return writeSceneBinary(pathWithNameAndExt, name, entities, world);
+	}
+
+	// The world is created through the caller's PhysicsCommon so that it outlives this call.
+	// Models are loaded through the asset cache. Without one only the model paths are recorded,
+	// e.g. when there is no GL context.
+	// Binary scenes are recognised by their magic, anything else is parsed as the text format.
+	struct SceneHeader* loadScene(string pathWithNameAndExt, string name, PhysicsCommon* common, AssetCache* assets)
 	{
-		std::ifstream sceneFile;
+		if (isBinaryScene(pathWithNameAndExt))
+			return loadSceneBinary(pathWithNameAndExt, common, assets);
+
+		// the whole file is tokenized in place, no line or token is copied
+		MappedFile file;
+		if (!file.open(pathWithNameAndExt))
+		{
+			cout << "Could not open file at location '" << pathWithNameAndExt << "'. Failed." << endl;
+			return nullptr;
+		}
+
 		SceneHeader* header = new SceneHeader;
 		header->path = pathWithNameAndExt;
-		sceneFile.open(pathWithNameAndExt);
-		if (!sceneFile.is_open())
+		header->entities = nullptr;
+		header->world = nullptr;
+		SceneError error;
+		string_view text(reinterpret_cast<const char*>(file.data()), file.size());
+		if (!parseTextScene(text, header, common, assets, error))
 		{
-			cout << "Could not open file at location '" << pathWithNameAndExt << "'. Failed." << endl;
+			cout << pathWithNameAndExt << ":" << error.line << ":" << error.column << ": " << error.message << endl;
+			if (header->world != nullptr)
+				common->destroyPhysicsWorld(header->world);
+			delete header->entities;
+			delete header;
 			return nullptr;
 		}
+		return header;
+	}
 
-		string line;
+private:
+	bool parseTextScene(string_view text, SceneHeader* header, PhysicsCommon* common, AssetCache* assets, SceneError& error)
+	{
+		SceneLineReader reader(text);
+		SceneLine fields;
+		string_view line;
 		unsigned int sectionIx = 0;
-		string sections[3] = { "header", "render", "physics" };
 		unsigned int obj_counter = 0;
-		PhysicsWorld::WorldSettings settings;
-		PhysicsWorld* world = nullptr;
-		PhysicsCommon common;
-		while (getline(sceneFile, line))
+		unsigned int render_obj_count = 0;
+		unsigned int phy_obj_count = 0;
+		// physics entries join the render entity of the same name, the views point into the file
+		unordered_map<string_view, EntityId> renderEntities;
+		while (reader.next(line))
 		{
 			// Comment token
-			if (line.substr(0, 3) == "***") continue;
+			if (line.substr(0, 3) == "***" || line.empty()) continue;
+			if (!fields.parse(line, reader.line(), error))
+				return false;
 
 			if (sectionIx == 0)
 			{
-				auto segs = line_split(line);
-				header->name = segs[0];
-				auto sleeping_enabled = boolDeSer(segs[1]);
-				auto gravity = vec3DeSer(segs[2]);
-				auto velocity_iterations = stoi(segs[3]);
-				auto position_iterations = stoi(segs[4]);
+				bool sleeping_enabled;
+				Vector3 gravity;
+				unsigned int velocity_iterations, position_iterations;
+				const SceneField* name;
+				if (!fields.require("name", name, error)
+					|| !readField(fields, "phy_sleeping_enabled", sleeping_enabled, boolDeSer, error)
+					|| !readField(fields, "phy_gravity", gravity, vec3DeSer, error)
+					|| !readNumber(fields, "phy_velocity_iterations", velocity_iterations, error)
+					|| !readNumber(fields, "phy_position_iterations", position_iterations, error)
+					|| !readNumber(fields, "render_obj_count", render_obj_count, error)
+					|| !readNumber(fields, "phy_obj_count", phy_obj_count, error))
+					return false;
+
+				header->name = name->value;
+				PhysicsWorld::WorldSettings settings;
 				settings.gravity = gravity;
 				settings.isSleepingEnabled = sleeping_enabled;
 				settings.defaultVelocitySolverNbIterations = velocity_iterations;
 				settings.defaultPositionSolverNbIterations = position_iterations;
-				world = common.createPhysicsWorld(settings);
-				world->setIsDebugRenderingEnabled(true); // TODO: Hardcoded, we could make this configurable.
+				header->world = common->createPhysicsWorld(settings);
+				header->world->setIsDebugRenderingEnabled(true); // TODO: Hardcoded, we could make this configurable.
 
-				header->render_obj_count = stoi(segs[5]);
-				header->phy_obj_count = stoi(segs[6]);
-				header->renders = new RenderingState(header->render_obj_count);
-				header->physics = new PhysicsState(header->phy_obj_count);
-				header->world = world;
-				sectionIx += 1;
+				header->entities = new EntityStore;
+				sectionIx = render_obj_count > 0 ? 1 : 2;
+				if (sectionIx == 2 && phy_obj_count == 0)
+					sectionIx = 3;
 				continue;
 			}
 			if (sectionIx == 1)
 			{
-				auto segs = line_split(line);
-				header->renders->names[obj_counter] = segs[0];
-				header->renders->transforms[obj_counter] = transformDeSer(segs[1]);
-				header->renders->models[obj_counter] = Model(segs[2]);
-				header->renders->shader_indices[obj_counter] = stoi(segs[3]);
+				const SceneField* name;
+				const SceneField* model_path;
+				Transform transform;
+				RenderComponent render;
+				if (!fields.require("name", name, error)
+					|| !readField(fields, "transform", transform, transformDeSer, error)
+					|| !fields.require("model_path", model_path, error)
+					|| !readNumber(fields, "shader_index", render.shader_index, error))
+					return false;
+
+				if (assets != nullptr)
+				{
+					render.model = assets->model(string(model_path->value));
+				}
+				else
+				{
+					render.model = make_shared<Model>();
+					render.model->model_path = model_path->value;
+				}
+				EntityId entity = header->entities->create(string(name->value));
+				header->entities->transforms.add(entity, transform);
+				header->entities->renderables.add(entity, std::move(render));
+				if (!name->value.empty())
+					renderEntities.emplace(name->value, entity);
 
 				obj_counter += 1;
-				if (obj_counter == header->render_obj_count)
+				if (obj_counter == render_obj_count)
 				{
-					sectionIx += 1;
+					sectionIx = phy_obj_count > 0 ? 2 : 3;
 					obj_counter = 0;
-					continue;
 				}
+				continue;
 			}
 			if (sectionIx == 2)
 			{
-				auto segs = line_split(line);
-				header->physics->names[obj_counter] = segs[0];
-				auto rb_trans = transformDeSer(segs[1]);
-				auto rb_type = bodyTypeDeSer(segs[2]);
-				auto sleep_enabled = boolDeSer(segs[3]);
-				RigidBody* body = world->createRigidBody(rb_trans);
+				const SceneField* name;
+				const SceneField* shape_values;
+				Transform rb_trans;
+				BodyType rb_type;
+				bool sleep_enabled;
+				CollisionShapeName coll_shape_name;
+				decimal bounce, friction, rolling, density;
+				unsigned short category_bits, category_mask;
+				if (!fields.require("phy_obj_name", name, error)
+					|| !readField(fields, "rbody_transform", rb_trans, transformDeSer, error)
+					|| !readField(fields, "rbody_type", rb_type, bodyTypeDeSer, error)
+					|| !readField(fields, "rbody_sleep_enabled", sleep_enabled, boolDeSer, error)
+					|| !readField(fields, "collider_shape_type", coll_shape_name, collShapeNameDeSer, error)
+					|| !fields.require("collider_shape_values", shape_values, error)
+					|| !readNumber(fields, "collider_mat_bounciness", bounce, error)
+					|| !readNumber(fields, "collider_mat_friction", friction, error)
+					|| !readNumber(fields, "collider_mat_rolling_resist", rolling, error)
+					|| !readNumber(fields, "collider_mat_mass_density", density, error)
+					|| !readNumber(fields, "collider_category_bits", category_bits, error)
+					|| !readNumber(fields, "collider_collide_mask_bits", category_mask, error))
+					return false;
+
+				auto coll_shape = collShapeInitDeSer(coll_shape_name, common, shape_values->value);
+				if (coll_shape == nullptr)
+					return error.set(fields.number, shape_values->column, "invalid or unsupported collider shape values");
+
+				RigidBody* body = header->world->createRigidBody(rb_trans);
 				body->setType(rb_type);
 				body->setIsAllowedToSleep(sleep_enabled);
-				header->physics->bodies[obj_counter] = body;
 
-				auto coll_shape_name = collShapeNameDeSer(segs[4]);
-				auto coll_shape = collShapeInitDeSer(coll_shape_name, &common, segs[5]);
-				auto bounce = stof(segs[6]);
-				auto friction = stof(segs[7]);
-				auto rolling = stof(segs[8]);
-				auto density = stof(segs[9]);
-				auto category_bits = (unsigned short)stoul(segs[10]);
-				auto category_mask = (unsigned short)stoul(segs[11]);
 				Collider* coll;
 				coll = body->addCollider(coll_shape, Transform::identity()); // Hardcoding this offset transform for now
 				coll->getMaterial().setBounciness(bounce);
@@ -184,209 +271,30 @@ struct SceneLoader
 				coll->getMaterial().setMassDensity(density);
 				coll->setCollisionCategoryBits(category_bits);
 				coll->setCollideWithMaskBits(category_mask);
-				header->physics->colliders[obj_counter] = coll;
+
+				auto match = renderEntities.find(name->value);
+				EntityId entity;
+				if (match != renderEntities.end() && !header->entities->bodies.has(match->second))
+					entity = match->second;
+				else
+					entity = header->entities->create(string(name->value));
+				header->entities->bodies.add(entity, { body, coll });
 
 				obj_counter += 1;
-				if (obj_counter == header->phy_obj_count)
+				if (obj_counter == phy_obj_count)
 				{
-					sectionIx += 1;
+					sectionIx = 3;
 					obj_counter = 0;
-					continue;
 				}
+				continue;
 			}
+			return error.set(reader.line(), 1, "more entries than the scene header declares");
 		}
-		sceneFile.close();
-		return header;
-	}
-};
-
-vector<string> split(const string str, string delimiter)
-{
-	vector<string> output;
-	string s = str;
-	size_t pos = 0;
-	std::string token;
-	while ((pos = s.find(delimiter)) != std::string::npos)
-	{
-		token = s.substr(0, pos);
-		output.push_back(token);
-		s.erase(0, pos + delimiter.length());
-	}
-	if (s != "")
-		output.push_back(s);
-	return output;
-}
-
-vector<string> line_split(const string line)
-{
-	// each item in the line is in a key:value format. 
-	// We're disposing of the keys for now as we're just hardcoding order/presence.
-	// That might change in the future.
-	vector<string> tokens;
-	auto segs = split(line, "\t");
-	for (int i = 0; i < segs.size(); i++)
-	{
-		auto t = split(segs[i], ":");
-		tokens.push_back(t[1]);
-	}
-	return tokens;
-}
 
-string boolSer(bool val)
-{
-	if (val)
-	{
-		return "1";
-	}
-	return "0";
-}
-bool boolDeSer(string val)
-{
-	return val == "1";
-}
-string vec3Ser(Vector3 val)
-{
-	string str = "";
-	str += to_string(val.x);
-	str += ",";
-	str += to_string(val.y);
-	str += ",";
-	str += to_string(val.z);
-	return str;
-}
-Vector3 vec3DeSer(string val)
-{
-	auto segs = split(val, ",");
-	return Vector3(stof(segs[0]), stof(segs[1]), stof(segs[2]));
-}
-string transformSer(Transform val)
-{
-	auto pos = val.getPosition();
-	auto quat = val.getOrientation();
-	string str = "";
-	str += vec3Ser(pos);
-	str += ",";
-	str += to_string(quat.x);
-	str += ",";
-	str += to_string(quat.y);
-	str += ",";
-	str += to_string(quat.z);
-	str += ",";
-	str += to_string(quat.w);
-	return str;
-}
-
-Transform transformDeSer(string val)
-{
-	auto segs = split(val, ",");
-	auto vec = Vector3(stof(segs[0]), stof(segs[1]), stof(segs[2]));
-	auto quat = Quaternion(stof(segs[3]), stof(segs[4]), stof(segs[5]), stof(segs[6]));
-	return Transform(vec, quat);
-}
-
-string bodyTypeSer(BodyType val)
-{
-	switch (val)
-	{
-	case BodyType::STATIC: return "0";
-	case BodyType::KINEMATIC: return "1";
-	case BodyType::DYNAMIC: return "2";
-	}
-	return "0";
-}
-
-BodyType bodyTypeDeSer(string val)
-{
-	if (val == "0") return BodyType::STATIC;
-	if (val == "1") return BodyType::KINEMATIC;
-	if (val == "2") return BodyType::DYNAMIC;
-
-	cout << "Unhandled rigid body type" << endl;
-	assert(false);
-}
-
-string collShapeNameSer(CollisionShapeName val)
-{
-	switch (val)
-	{
-	case CollisionShapeName::TRIANGLE: return "triangle";
-	case CollisionShapeName::SPHERE: return "sphere";
-	case CollisionShapeName::CAPSULE: return "capsule";
-	case CollisionShapeName::BOX: return "box";
-	}
-	return "box";
-}
-
-CollisionShapeName collShapeNameDeSer(string val)
-{
-	if (val == "triangle") return CollisionShapeName::TRIANGLE;
-	if (val == "capsule") return CollisionShapeName::CAPSULE;
-	if (val == "sphere") return CollisionShapeName::SPHERE;
-	if (val == "box") return CollisionShapeName::BOX;
-
-	cout << "Failed to deser collision shape name." << endl;
-	assert(false);
-}
-
-string collShapeInitSer(CollisionShape* val)
-{
-	string str = "";
-	switch (val->getName())
-	{
-	case CollisionShapeName::TRIANGLE:
-	{
-		auto tri = dynamic_cast<TriangleShape*>(val);
-		// TODO: Implement
-		break;
-	}
-	case CollisionShapeName::BOX:
-	{
-		auto box = dynamic_cast<BoxShape*>(val);
-		str = vec3Ser(box->getHalfExtents());
-		break;
-	}
-	case CollisionShapeName::CAPSULE:
-	{
-		auto cap = dynamic_cast<CapsuleShape*>(val);
-		str += to_string(cap->getHeight());
-		str += ",";
-		str += to_string(cap->getRadius());
-		break;
-	}
-	case CollisionShapeName::SPHERE:
-	{
-		auto sp = dynamic_cast<SphereShape*>(val);
-		str += to_string(sp->getRadius());
-		break;
-	}
-	}
-	return str;
-}
-
-CollisionShape* collShapeInitDeSer(CollisionShapeName name, PhysicsCommon* common, string val)
-{
-	switch (name)
-	{
-	case CollisionShapeName::TRIANGLE:
-	{
-		// TODO: Implement
-		return nullptr;
-	}
-	case CollisionShapeName::BOX:
-	{
-		auto extents = vec3DeSer(val);
-		return common->createBoxShape(extents);
-	}
-	case CollisionShapeName::CAPSULE:
-	{
-		auto segs = split(val, ",");
-		assert(segs.size() == 2);
-
-		return common->createCapsuleShape(stof(segs[1]), stof(segs[0]));
-	}
-	case CollisionShapeName::SPHERE:
-	{
-		return common->createSphereShape(stof(val));
-	}
+		if (sectionIx == 0)
+			return error.set(reader.line(), 1, "missing scene header");
+		if (sectionIx != 3)
+			return error.set(reader.line(), 1, "file ends before all entries declared in the scene header");
+		return true;
 	}
-}
+};
@@ -0,0 +1,170 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <reactphysics3d/reactphysics3d.h>
+
+using namespace std;
+using namespace reactphysics3d;
+
+// Tokenizer for the text scene format. Lines are tab separated key:value fields. Everything is a
+// view into the file contents, so reading a line allocates nothing; only the values that end up
+// in the scene (names, model paths) are copied out.
+
+// Where parsing stopped and why, line and column are 1 based
+struct SceneError
+{
+	unsigned int line = 0;
+	unsigned int column = 0;
+	string message;
+
+	bool set(unsigned int errorLine, unsigned int errorColumn, string errorMessage)
+	{
+		line = errorLine;
+		column = errorColumn;
+		message = std::move(errorMessage);
+		return false;
+	}
+};
+
+struct SceneField
+{
+	string_view key;
+	string_view value;
+	// column of the first character of the value
+	unsigned int column;
+};
+
+// Hands out the lines of a buffer one at a time, without their line endings
+class SceneLineReader
+{
+public:
+	SceneLineReader(string_view text) : text(text) {}
+
+	bool next(string_view& line)
+	{
+		if (position >= text.size())
+			return false;
+		size_t end = text.find('\n', position);
+		if (end == string_view::npos)
+			end = text.size();
+		line = text.substr(position, end - position);
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix(1);
+		position = end + 1;
+		lineNumber++;
+		return true;
+	}
+
+	unsigned int line() const { return lineNumber; }
+
+private:
+	string_view text;
+	size_t position = 0;
+	unsigned int lineNumber = 0;
+};
+
+// The fields of one line, looked up by key so their order in the file doesn't matter
+class SceneLine
+{
+public:
+	static const unsigned int MAX_FIELDS = 16;
+
+	unsigned int number = 0;
+
+	bool parse(string_view line, unsigned int lineNumber, SceneError& error)
+	{
+		number = lineNumber;
+		count = 0;
+		size_t start = 0;
+		while (start <= line.size())
+		{
+			size_t end = line.find('\t', start);
+			if (end == string_view::npos)
+				end = line.size();
+			string_view field = line.substr(start, end - start);
+			// a trailing tab leaves an empty field
+			if (!field.empty())
+			{
+				size_t colon = field.find(':');
+				if (colon == string_view::npos)
+					return error.set(lineNumber, (unsigned int)start + 1, "expected key:value");
+				if (count == MAX_FIELDS)
+					return error.set(lineNumber, (unsigned int)start + 1, "too many fields");
+				fields[count++] = { field.substr(0, colon), field.substr(colon + 1), (unsigned int)(start + colon + 2) };
+			}
+			start = end + 1;
+		}
+		return true;
+	}
+
+	const SceneField* find(string_view key) const
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (fields[i].key == key)
+				return &fields[i];
+		}
+		return nullptr;
+	}
+
+	// looks up a field that has to be there
+	bool require(string_view key, const SceneField*& field, SceneError& error) const
+	{
+		field = find(key);
+		if (field == nullptr)
+			return error.set(number, 1, "missing field '" + string(key) + "'");
+		return true;
+	}
+
+private:
+	SceneField fields[MAX_FIELDS];
+	unsigned int count = 0;
+};
+
+// Number parsing with from_chars: no locale, no allocation, and the whole token has to be consumed
+template<typename T>
+bool parseNumber(string_view text, T& value)
+{
+	const char* end = text.data() + text.size();
+	auto result = std::from_chars(text.data(), end, value);
+	return result.ec == std::errc() && result.ptr == end;
+}
+
+// Parses exactly count comma separated decimals
+inline bool parseDecimals(string_view text, decimal* values, unsigned int count)
+{
+	size_t start = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		size_t end = text.find(',', start);
+		bool last = i + 1 == count;
+		if (last != (end == string_view::npos))
+			return false;
+		if (last)
+			end = text.size();
+		if (!parseNumber(text.substr(start, end - start), values[i]))
+			return false;
+		start = end + 1;
+	}
+	return true;
+}
+
+// Looks up key and converts its value with parse(value, out), reporting where it went wrong otherwise
+template<typename T, typename Parser>
+bool readField(const SceneLine& line, string_view key, T& out, Parser parse, SceneError& error)
+{
+	const SceneField* field;
+	if (!line.require(key, field, error))
+		return false;
+	if (!parse(field->value, out))
+		return error.set(line.number, field->column, "invalid value '" + string(field->value) + "' for '" + string(key) + "'");
+	return true;
+}
+
+// readField for plain numbers
+template<typename T>
+bool readNumber(const SceneLine& line, string_view key, T& out, SceneError& error)
+{
+	return readField(line, key, out, [](string_view value, T& result) { return parseNumber(value, result); }, error);
+}
@@ -0,0 +1,168 @@
+#include "arena.h"
+
+PhysicsWorld* createArenaWorld(PhysicsCommon& common)
+{
+	PhysicsWorld::WorldSettings settings;
+	settings.isSleepingEnabled = true;
+	settings.gravity = Vector3(0, -9.81f, 0);
+	auto* world = common.createPhysicsWorld(settings);
+	// Defaults are 10 and 5 so if this is laggy then change it.
+	world->setNbIterationsVelocitySolver(15);
+	world->setNbIterationsPositionSolver(8);
+	return world;
+}
+
+ArenaBodies buildArena(PhysicsCommon& common, PhysicsWorld* world, EntityStore& entities, Vector3 cameraPosition, bool ballUsesGravity)
+{
+	ArenaBodies arena;
+
+	// Rigidbody setup
+	auto ballTransform = Transform(Vector3(15.0f, 30.0f, -50.0f), Quaternion::identity());
+	arena.ballBody = world->createRigidBody(ballTransform);
+	arena.ballBody->setType(BodyType::DYNAMIC);
+	arena.ballBody->enableGravity(ballUsesGravity);
+	arena.ballUsesGravity = ballUsesGravity;
+	float ballRadius = 6.0f;
+	// TODO: how to get physics shapes to match extents of meshes?
+	SphereShape* sphereShape = common.createSphereShape(ballRadius);
+	Vector3 floorExtents(160.0f, 1.0f, 160.0f);
+	Vector3 wallExtents(75.0, 1.0f, floorExtents.z);
+	BoxShape* floorShape = common.createBoxShape(floorExtents);
+	BoxShape* wallShape = common.createBoxShape(wallExtents);
+	BoxShape* netShape = common.createBoxShape(Vector3(12.0f, 1.0f, floorExtents.z));
+	CapsuleShape* capsuleShape = common.createCapsuleShape(3.0f, 4.0f);
+
+	// Relative transform of the collider relative to the body origin
+	Transform ident = Transform::identity();
+
+	// Add the collider to the rigid body
+	arena.ballCollider = arena.ballBody->addCollider(sphereShape, ident);
+	arena.ballCollider->getMaterial().setBounciness(0.6f);
+	arena.ballCollider->getMaterial().setFrictionCoefficient(0.5f);
+	arena.ballCollider->getMaterial().setRollingResistance(1.5f);
+	arena.ballCollider->getMaterial().setMassDensity(2.0f);
+	arena.ballBody->setIsAllowedToSleep(false);
+	arena.ballCollider->setCollisionCategoryBits(CollisionCategories::BALL);
+	arena.ballCollider->setCollideWithMaskBits(CollisionCategories::BALL |
+		CollisionCategories::ENVIRONMENT |
+		CollisionCategories::CAMERA |
+		CollisionCategories::FLOOR |
+		CollisionCategories::NET);
+	arena.ball = entities.create("ball");
+	entities.bodies.add(arena.ball, { arena.ballBody, arena.ballCollider });
+
+	auto cameraTransform = Transform(cameraPosition, Quaternion::identity());
+	arena.cameraBody = world->createRigidBody(cameraTransform);
+	arena.cameraBody->setType(BodyType::DYNAMIC);
+	arena.cameraBody->enableGravity(true);
+	arena.cameraBody->setMass(5.0f);
+	auto cameraCollider = arena.cameraBody->addCollider(capsuleShape, ident);
+	cameraCollider->setCollisionCategoryBits(CollisionCategories::CAMERA);
+	cameraCollider->setCollideWithMaskBits(CollisionCategories::BALL |
+		CollisionCategories::ENVIRONMENT |
+		CollisionCategories::FLOOR |
+		CollisionCategories::NET);
+	arena.camera = entities.create("camera");
+	entities.bodies.add(arena.camera, { arena.cameraBody, cameraCollider });
+
+	constexpr float rad90 = glm::radians(90.0f);
+	const unsigned int envCount = 7;
+	Vector3 angles[envCount] = {
+		Vector3(0.0f, 0.0f, 0.0f), // floor
+		Vector3(0.0f, 0.0f, rad90), // left wall
+		Vector3(rad90, 0.0f, rad90), // back wall
+		Vector3(0.0f, 0.0f, rad90), // right wall
+		Vector3(rad90, 0.0f, rad90), // front wall
+		Vector3(0.0f, 0.0f, 0.0f), // ceiling
+		Vector3(rad90, 0.0f, rad90) // net
+	};
+
+	Vector3 origin(25.0f, -25.0f, -25.0f);
+	Vector3 positions[envCount] = {
+		Vector3(origin.x + floorExtents.x / 2, origin.y, origin.z + -1.0f * (floorExtents.z / 2)), // floor
+		Vector3(origin.x - floorExtents.x / 2, floorExtents.y, origin.z - floorExtents.z / 2), // left wall
+		Vector3(origin.x + floorExtents.x / 2, floorExtents.y, 4 * origin.z - floorExtents.z), // back wall
+		Vector3(4 * origin.x + floorExtents.x, floorExtents.y, origin.z - floorExtents.z / 2), // right wall
+		Vector3(origin.x + floorExtents.x / 2, floorExtents.y, origin.z + floorExtents.z / 2), // front wall
+		Vector3(origin.x + floorExtents.x / 2, origin.y + 80.0f, origin.z + -1.0f * (floorExtents.z / 2)), // ceiling
+		Vector3(origin.x + floorExtents.x / 2, floorExtents.y - 15.0f, -100.0f), // back wall
+	};
+	BoxShape* boxShapes[envCount] = {
+		floorShape,
+		wallShape,
+		wallShape,
+		wallShape,
+		wallShape,
+		floorShape,
+		netShape,
+	};
+	for (unsigned int i = 0; i < envCount; i++)
+	{
+		auto trans = Transform(positions[i], Quaternion::fromEulerAngles(angles[i]));
+		auto rBody = world->createRigidBody(trans);
+		rBody->setType(BodyType::STATIC);
+		auto coll = rBody->addCollider(boxShapes[i], ident);
+		// All these indexes are hard coded right now, this will be fixed once we have an editor
+		if (i == 0)
+			coll->setCollisionCategoryBits(CollisionCategories::FLOOR);
+		else if (i == envCount - 1)
+			coll->setCollisionCategoryBits(CollisionCategories::NET);
+		else
+			coll->setCollisionCategoryBits(CollisionCategories::ENVIRONMENT);
+		coll->setCollideWithMaskBits(CollisionCategories::BALL | CollisionCategories::CAMERA);
+		EntityId entity = entities.create("env" + to_string(i + 1));
+		entities.bodies.add(entity, { rBody, coll });
+	}
+
+	return arena;
+}
+
+static void performPunch(const ArenaBodies& arena, Vector3 startPoint, Vector3 direction)
+{
+	// 1. Send raycast forward
+	float magnitude = 1000.0f;
+	float reach = 75.0f;
+
+	// Create the ray 
+	Vector3 endPoint = startPoint + (reach * direction);
+	Ray ray(startPoint, endPoint);
+
+	// Create the raycast info object for the 
+	// raycast result 
+	RaycastInfo raycastInfo;
+
+	// Test raycasting against a collider 
+	bool isHit = arena.ballBody->raycast(ray, raycastInfo);
+	if (isHit)
+	{
+		float force = (1 - raycastInfo.hitFraction) * magnitude;
+		arena.ballBody->applyForceToCenterOfMass(force * direction);
+		//arena.ballBody->applyForceAtWorldPosition(force * direction, raycastInfo.worldPoint);
+		if (!arena.ballUsesGravity)
+		{
+			arena.ballBody->enableGravity(true);
+		}
+	}
+}
+
+static void performJump(const ArenaBodies& arena, Vector3 direction)
+{
+	arena.cameraBody->applyForceToCenterOfMass(1000.0f * direction);
+}
+
+// Runs on the physics thread, the only place gameplay input touches the bodies
+void applyArenaCommand(const ArenaBodies& arena, const PhysicsCommand& command)
+{
+	switch (command.type)
+	{
+	case PhysicsCommandType::MoveCamera:
+		arena.cameraBody->setTransform(Transform(command.position, Quaternion::identity()));
+		break;
+	case PhysicsCommandType::Punch:
+		performPunch(arena, command.position, command.direction);
+		break;
+	case PhysicsCommandType::Jump:
+		performJump(arena, command.direction);
+		break;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <reactphysics3d/reactphysics3d.h>
+#include "collision_categories.h"
+#include "physics_command.h"
+#include "../editor/scene_manager.h"
+
+using namespace reactphysics3d;
+
+// Bodies of the hardcoded arena that gameplay code needs to reach directly
+struct ArenaBodies
+{
+	EntityId ball = NULL_ENTITY;
+	EntityId camera = NULL_ENTITY;
+	RigidBody* ballBody = nullptr;
+	Collider* ballCollider = nullptr;
+	RigidBody* cameraBody = nullptr;
+	bool ballUsesGravity = false;
+};
+
+// Creates the physics world with the settings the arena was tuned for
+PhysicsWorld* createArenaWorld(PhysicsCommon& common);
+
+// Adds the ball, the arena walls and the camera body to the store as entities with a body only,
+// whoever draws them adds the transform and model.
+// Nothing in here touches OpenGL so it can be used by the headless runner as well.
+ArenaBodies buildArena(PhysicsCommon& common, PhysicsWorld* world, EntityStore& entities, Vector3 cameraPosition, bool ballUsesGravity);
+
+// Applies a gameplay command to the arena bodies. Shared by the game and the headless replay so
+// both step exactly the same simulation.
+void applyArenaCommand(const ArenaBodies& arena, const PhysicsCommand& command);
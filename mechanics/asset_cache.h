@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include "model.h"
+#include "texture_cache.h"
+
+using namespace std;
+
+// Loads every model file once and hands out shared references to it, so scene load time and GPU
+// memory grow with the number of unique assets instead of the number of entries using them.
+// Models are keyed by canonical path and their GL buffers are freed with the last reference.
+// Textures are shared across different models too, through the texture cache.
+class AssetCache
+{
+public:
+	TextureCache textures;
+
+	shared_ptr<Model> model(const string& path)
+	{
+		string key = TextureCache::canonicalPath(path);
+		auto it = models.find(key);
+		if (it != models.end())
+		{
+			if (auto model = it->second.lock())
+				return model;
+		}
+
+		shared_ptr<Model> model(new Model(path, false, &textures), [](Model* m)
+			{
+				m->release();
+				delete m;
+			});
+		models[key] = model;
+		return model;
+	}
+
+	// number of models still referenced by at least one entry
+	unsigned int liveModelCount() const
+	{
+		unsigned int count = 0;
+		for (const auto& entry : models)
+		{
+			if (!entry.second.expired())
+				count++;
+		}
+		return count;
+	}
+
+private:
+	unordered_map<string, weak_ptr<Model>> models;
+};
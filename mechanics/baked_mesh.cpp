@@ -0,0 +1,168 @@
+#include "baked_mesh.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+static bool inBounds(uint64_t offset, uint64_t bytes, size_t size)
+{
+	return offset <= size && bytes <= size - offset;
+}
+
+bool BakedModelView::parse(const unsigned char* data, size_t size)
+{
+	if (data == nullptr || size < sizeof(BakedModelHeader))
+		return false;
+	header = reinterpret_cast<const BakedModelHeader*>(data);
+	if (memcmp(header->magic, BAKED_MODEL_MAGIC, sizeof(BAKED_MODEL_MAGIC)) != 0
+		|| header->version != BAKED_MODEL_VERSION
+		|| header->fileSize != size)
+		return false;
+
+	uint64_t offset = sizeof(BakedModelHeader);
+	uint64_t meshBytes = (uint64_t)header->meshCount * sizeof(BakedMeshRecord);
+	uint64_t textureBytes = (uint64_t)header->textureCount * sizeof(BakedTextureRecord);
+	uint64_t lodBytes = (uint64_t)header->lodCount * sizeof(BakedLodRecord);
+	if (!inBounds(offset, meshBytes + textureBytes + lodBytes, size))
+		return false;
+	base = data;
+	meshes = reinterpret_cast<const BakedMeshRecord*>(data + offset);
+	textures = reinterpret_cast<const BakedTextureRecord*>(data + offset + meshBytes);
+	lods = reinterpret_cast<const BakedLodRecord*>(data + offset + meshBytes + textureBytes);
+
+	for (uint32_t i = 0; i < header->meshCount; i++)
+	{
+		const auto& mesh = meshes[i];
+		if (mesh.vertexFormat != (uint32_t)VertexFormat::Float && mesh.vertexFormat != (uint32_t)VertexFormat::Quantized)
+			return false;
+		if (mesh.indexSize != 2 && mesh.indexSize != 4)
+			return false;
+		if (!inBounds(mesh.vertexOffset, (uint64_t)mesh.vertexCount * vertexSize((VertexFormat)mesh.vertexFormat), size)
+			|| !inBounds(mesh.indexOffset, (uint64_t)mesh.indexCount * mesh.indexSize, size)
+			|| mesh.vertexOffset % BAKED_MODEL_ALIGNMENT != 0
+			|| mesh.indexOffset % BAKED_MODEL_ALIGNMENT != 0
+			|| (uint64_t)mesh.firstTexture + mesh.textureCount > header->textureCount
+			|| (uint64_t)mesh.firstLod + mesh.lodCount > header->lodCount)
+			return false;
+		for (uint32_t l = mesh.firstLod; l < mesh.firstLod + mesh.lodCount; l++)
+		{
+			if ((uint64_t)lods[l].firstIndex + lods[l].indexCount > mesh.indexCount)
+				return false;
+		}
+	}
+	for (uint32_t i = 0; i < header->textureCount; i++)
+	{
+		// strings are stored zero terminated
+		if (memchr(textures[i].type, 0, sizeof(textures[i].type)) == nullptr
+			|| memchr(textures[i].path, 0, sizeof(textures[i].path)) == nullptr)
+			return false;
+	}
+	return true;
+}
+
+static uint64_t alignUp(uint64_t value)
+{
+	return (value + BAKED_MODEL_ALIGNMENT - 1) & ~(BAKED_MODEL_ALIGNMENT - 1);
+}
+
+static bool copyString(char* dst, size_t capacity, const string& src)
+{
+	if (src.size() >= capacity)
+		return false;
+	memset(dst, 0, capacity);
+	memcpy(dst, src.c_str(), src.size());
+	return true;
+}
+
+bool writeBakedModel(const string& path, const vector<MeshData>& meshes)
+{
+	BakedModelHeader header;
+	memcpy(header.magic, BAKED_MODEL_MAGIC, sizeof(BAKED_MODEL_MAGIC));
+	header.version = BAKED_MODEL_VERSION;
+	header.meshCount = (uint32_t)meshes.size();
+	header.textureCount = 0;
+	header.lodCount = 0;
+	header.reserved = 0;
+
+	vector<BakedMeshRecord> meshRecords(meshes.size());
+	vector<BakedTextureRecord> textureRecords;
+	vector<BakedLodRecord> lodRecords;
+	// what every mesh uploads, in the format and index size it is stored with
+	vector<MeshBuffers> buffers(meshes.size());
+	vector<vector<uint16_t>> shortIndices(meshes.size());
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		buffers[i] = meshBuffers(meshes[i], shortIndices[i]);
+		meshRecords[i].vertexFormat = (uint32_t)buffers[i].format;
+		meshRecords[i].indexSize = buffers[i].indexSize;
+		for (int c = 0; c < 3; c++)
+		{
+			meshRecords[i].boundsMin[c] = meshes[i].bounds.min[c];
+			meshRecords[i].boundsMax[c] = meshes[i].bounds.max[c];
+		}
+
+		meshRecords[i].firstLod = (uint32_t)lodRecords.size();
+		meshRecords[i].lodCount = (uint32_t)meshes[i].lods.size();
+		for (const auto& lod : meshes[i].lods)
+			lodRecords.push_back({ lod.firstIndex, lod.indexCount, lod.error, 0 });
+
+		meshRecords[i].firstTexture = (uint32_t)textureRecords.size();
+		meshRecords[i].textureCount = (uint32_t)meshes[i].textures.size();
+		for (const auto& texture : meshes[i].textures)
+		{
+			BakedTextureRecord record;
+			if (!copyString(record.type, sizeof(record.type), texture.type)
+				|| !copyString(record.path, sizeof(record.path), texture.path))
+			{
+				cout << "Baker: texture path too long for the baked format: " << texture.path << endl;
+				return false;
+			}
+			textureRecords.push_back(record);
+		}
+	}
+	header.textureCount = (uint32_t)textureRecords.size();
+	header.lodCount = (uint32_t)lodRecords.size();
+
+	// lay the data blocks out after the records
+	uint64_t offset = sizeof(BakedModelHeader)
+		+ meshRecords.size() * sizeof(BakedMeshRecord)
+		+ textureRecords.size() * sizeof(BakedTextureRecord)
+		+ lodRecords.size() * sizeof(BakedLodRecord);
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		offset = alignUp(offset);
+		meshRecords[i].vertexOffset = offset;
+		meshRecords[i].vertexCount = buffers[i].vertexCount;
+		offset += (uint64_t)buffers[i].vertexCount * vertexSize(buffers[i].format);
+		offset = alignUp(offset);
+		meshRecords[i].indexOffset = offset;
+		meshRecords[i].indexCount = buffers[i].indexCount;
+		offset += (uint64_t)buffers[i].indexCount * buffers[i].indexSize;
+	}
+	header.fileSize = offset;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		cout << "Baker: could not open '" << path << "' for writing" << endl;
+		return false;
+	}
+	const char padding[BAKED_MODEL_ALIGNMENT] = {};
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)meshRecords.data(), meshRecords.size() * sizeof(BakedMeshRecord));
+	file.write((const char*)textureRecords.data(), textureRecords.size() * sizeof(BakedTextureRecord));
+	file.write((const char*)lodRecords.data(), lodRecords.size() * sizeof(BakedLodRecord));
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		file.write(padding, meshRecords[i].vertexOffset - (uint64_t)file.tellp());
+		file.write((const char*)buffers[i].vertices, (uint64_t)buffers[i].vertexCount * vertexSize(buffers[i].format));
+		file.write(padding, meshRecords[i].indexOffset - (uint64_t)file.tellp());
+		file.write((const char*)buffers[i].indices, (uint64_t)buffers[i].indexCount * buffers[i].indexSize);
+	}
+	return file.good();
+}
+
+string bakedModelPath(const string& sourcePath)
+{
+	return std::filesystem::path(sourcePath).replace_extension(BAKED_MODEL_EXTENSION).string();
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "mesh.h"
+#include "mesh_import.h"
+#include "mapped_file.h"
+
+using namespace std;
+
+// Baked model format, written offline by the baker and memory mapped at runtime so the vertex
+// and index buffers go to glBufferData without Assimp or any per-vertex copying.
+//
+// Layout (little endian):
+//   BakedModelHeader
+//   BakedMeshRecord[meshCount]
+//   BakedTextureRecord[textureCount]
+//   BakedLodRecord[lodCount]
+//   vertex and index data, every block aligned to BAKED_MODEL_ALIGNMENT
+// Vertices are stored exactly as the interleaved Vertex or QuantizedVertex struct, indices as 16 or
+// 32 bit unsigned ints. A mesh's index block holds all of its levels of detail one after the other.
+
+const char BAKED_MODEL_MAGIC[4] = { 'M', 'M', 'D', 'L' };
+const uint32_t BAKED_MODEL_VERSION = 3;
+const uint64_t BAKED_MODEL_ALIGNMENT = 16;
+const char* const BAKED_MODEL_EXTENSION = ".mesh";
+
+struct BakedModelHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t meshCount;
+	uint32_t textureCount;
+	uint32_t lodCount;
+	uint32_t reserved;
+	// total size, so truncated files are rejected before anything is read from them
+	uint64_t fileSize;
+};
+
+struct BakedMeshRecord
+{
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	// range of this mesh's entries in the texture records
+	uint32_t firstTexture;
+	uint32_t textureCount;
+	// range of this mesh's entries in the lod records
+	uint32_t firstLod;
+	uint32_t lodCount;
+	// VertexFormat of the vertex block
+	uint32_t vertexFormat;
+	// bytes per index, 2 or 4
+	uint32_t indexSize;
+	// bounds of the vertices, quantized positions are fractions of them
+	float boundsMin[3];
+	float boundsMax[3];
+};
+
+struct BakedTextureRecord
+{
+	char type[32];
+	char path[224];
+};
+
+// One level of detail, a range of the mesh's indices
+struct BakedLodRecord
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+	uint32_t reserved;
+};
+
+static_assert(sizeof(Vertex) == 32, "Baked vertices are stored as the raw Vertex struct");
+static_assert(sizeof(BakedModelHeader) == 32, "BakedModelHeader layout changed, bump BAKED_MODEL_VERSION");
+static_assert(sizeof(BakedMeshRecord) == 72, "BakedMeshRecord layout changed, bump BAKED_MODEL_VERSION");
+static_assert(sizeof(BakedLodRecord) == 16, "BakedLodRecord layout changed, bump BAKED_MODEL_VERSION");
+
+// Validated view over the bytes of a baked model, pointing into the mapping rather than copying
+struct BakedModelView
+{
+	const BakedModelHeader* header = nullptr;
+	const BakedMeshRecord* meshes = nullptr;
+	const BakedTextureRecord* textures = nullptr;
+	const BakedLodRecord* lods = nullptr;
+	const unsigned char* base = nullptr;
+
+	// checks the magic, version and that every record stays inside the buffer
+	bool parse(const unsigned char* data, size_t size);
+
+	MeshBuffers buffers(const BakedMeshRecord& mesh) const
+	{
+		MeshBuffers result;
+		result.format = (VertexFormat)mesh.vertexFormat;
+		result.vertices = base + mesh.vertexOffset;
+		result.vertexCount = mesh.vertexCount;
+		result.indices = base + mesh.indexOffset;
+		result.indexSize = mesh.indexSize;
+		result.indexCount = mesh.indexCount;
+		result.bounds.min = glm::vec3(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]);
+		result.bounds.max = glm::vec3(mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]);
+		return result;
+	}
+	vector<MeshLod> meshLods(const BakedMeshRecord& mesh) const
+	{
+		vector<MeshLod> result;
+		for (uint32_t i = mesh.firstLod; i < mesh.firstLod + mesh.lodCount; i++)
+			result.push_back({ lods[i].firstIndex, lods[i].indexCount, lods[i].error });
+		return result;
+	}
+};
+
+// Writes the imported meshes to a baked model file. Returns false if it couldn't be written.
+bool writeBakedModel(const string& path, const vector<MeshData>& meshes);
+
+// The baked file that belongs to a source model, e.g. assets/plank/plank.obj -> assets/plank/plank.mesh
+string bakedModelPath(const string& sourcePath);
@@ -0,0 +1,228 @@
+#include "baked_texture.h"
+#include <glad/glad.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+static bool inBounds(uint64_t offset, uint64_t bytes, size_t size)
+{
+	return offset <= size && bytes <= size - offset;
+}
+
+static GLenum glFormat(uint32_t format)
+{
+	switch (format)
+	{
+	case BAKED_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1;
+	case BAKED_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5;
+	default: return GL_COMPRESSED_RG_RGTC2;
+	}
+}
+
+bool BakedTextureView::parse(const unsigned char* data, size_t size)
+{
+	if (data == nullptr || size < sizeof(BakedTextureHeader))
+		return false;
+	header = reinterpret_cast<const BakedTextureHeader*>(data);
+	if (memcmp(header->magic, BAKED_TEXTURE_MAGIC, sizeof(BAKED_TEXTURE_MAGIC)) != 0
+		|| header->version != BAKED_TEXTURE_VERSION
+		|| header->format < BAKED_BC1 || header->format > BAKED_BC5
+		|| header->width == 0 || header->height == 0
+		|| header->levelCount == 0 || header->levelCount > 32
+		|| (header->faceCount != 1 && header->faceCount != 6))
+		return false;
+
+	uint64_t recordBytes = (uint64_t)header->faceCount * header->levelCount * sizeof(BakedLevelRecord);
+	if (!inBounds(sizeof(BakedTextureHeader), recordBytes, size))
+		return false;
+	base = data;
+	levels = reinterpret_cast<const BakedLevelRecord*>(data + sizeof(BakedTextureHeader));
+
+	for (uint32_t face = 0; face < header->faceCount; face++)
+	{
+		uint32_t width = header->width, height = header->height;
+		for (uint32_t l = 0; l < header->levelCount; l++)
+		{
+			const auto& record = level(face, l);
+			if (record.width != width || record.height != height
+				|| record.size != bakedLevelSize(header->format, width, height)
+				|| !inBounds(record.offset, record.size, size))
+				return false;
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+	}
+	return true;
+}
+
+static uint64_t alignUp(uint64_t value)
+{
+	return (value + BAKED_TEXTURE_ALIGNMENT - 1) & ~(BAKED_TEXTURE_ALIGNMENT - 1);
+}
+
+bool writeBakedTexture(const string& path, const BakedTextureData& texture)
+{
+	BakedTextureHeader header;
+	memcpy(header.magic, BAKED_TEXTURE_MAGIC, sizeof(BAKED_TEXTURE_MAGIC));
+	header.version = BAKED_TEXTURE_VERSION;
+	header.format = texture.format;
+	header.width = texture.width;
+	header.height = texture.height;
+	header.levelCount = texture.levelCount;
+	header.faceCount = texture.faceCount;
+	header.reserved = 0;
+
+	size_t count = (size_t)texture.faceCount * texture.levelCount;
+	if (texture.levels.size() != count)
+		return false;
+
+	vector<BakedLevelRecord> records(count);
+	uint64_t offset = sizeof(BakedTextureHeader) + count * sizeof(BakedLevelRecord);
+	for (uint32_t face = 0; face < texture.faceCount; face++)
+	{
+		uint32_t width = texture.width, height = texture.height;
+		for (uint32_t l = 0; l < texture.levelCount; l++)
+		{
+			auto& record = records[face * texture.levelCount + l];
+			offset = alignUp(offset);
+			record.offset = offset;
+			record.size = (uint32_t)texture.levels[face * texture.levelCount + l].size();
+			record.width = width;
+			record.height = height;
+			record.reserved = 0;
+			offset += record.size;
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		cout << "Baker: could not open '" << path << "' for writing" << endl;
+		return false;
+	}
+	const char padding[BAKED_TEXTURE_ALIGNMENT] = {};
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)records.data(), records.size() * sizeof(BakedLevelRecord));
+	for (size_t i = 0; i < count; i++)
+	{
+		file.write(padding, records[i].offset - (uint64_t)file.tellp());
+		file.write((const char*)texture.levels[i].data(), texture.levels[i].size());
+	}
+	return file.good();
+}
+
+string bakedTexturePath(const string& sourcePath)
+{
+	return std::filesystem::path(sourcePath).replace_extension(BAKED_TEXTURE_EXTENSION).string();
+}
+
+bool bakedFormatSupported(uint32_t format)
+{
+	if (format == BAKED_BC5)
+		return true;
+	static int s3tc = -1;
+	if (s3tc < 0)
+	{
+		s3tc = 0;
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (name && strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+			{
+				s3tc = 1;
+				break;
+			}
+		}
+		if (!s3tc)
+			cout << "Texture: S3TC compression not supported, baked textures are ignored" << endl;
+	}
+	return s3tc == 1;
+}
+
+// uploads every level of one face into the bound texture
+static void uploadLevels(const BakedTextureView& view, GLenum target, uint32_t face)
+{
+	for (uint32_t l = 0; l < view.header->levelCount; l++)
+	{
+		const auto& record = view.level(face, l);
+		glCompressedTexImage2D(target, l, glFormat(view.header->format), record.width, record.height, 0,
+			record.size, view.levelData(record));
+	}
+}
+
+unsigned int loadBakedTexture(const string& sourcePath)
+{
+	string bakedPath = bakedTexturePath(sourcePath);
+	if (!isBakedFileCurrent(bakedPath, sourcePath))
+		return 0;
+
+	MappedFile file;
+	BakedTextureView view;
+	if (!file.open(bakedPath) || !view.parse(file.data(), file.size()) || view.header->faceCount != 1)
+	{
+		cout << "Texture: '" << bakedPath << "' is not a valid baked texture, loading the source instead" << endl;
+		return 0;
+	}
+	if (!bakedFormatSupported(view.header->format))
+		return 0;
+
+	unsigned int textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	uploadLevels(view, GL_TEXTURE_2D, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, view.header->levelCount - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	return textureID;
+}
+
+unsigned int loadBakedCubemap(const vector<string>& faces)
+{
+	if (faces.size() != 6)
+		return 0;
+
+	MappedFile files[6];
+	BakedTextureView views[6];
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		string bakedPath = bakedTexturePath(faces[i]);
+		if (!isBakedFileCurrent(bakedPath, faces[i]))
+			return 0;
+		if (!files[i].open(bakedPath) || !views[i].parse(files[i].data(), files[i].size()) || views[i].header->faceCount != 1)
+		{
+			cout << "Cubemap: '" << bakedPath << "' is not a valid baked texture, loading the sources instead" << endl;
+			return 0;
+		}
+		// cubemap faces have to match to be complete
+		if (i > 0 && (views[i].header->format != views[0].header->format
+			|| views[i].header->width != views[0].header->width
+			|| views[i].header->height != views[0].header->height
+			|| views[i].header->levelCount != views[0].header->levelCount))
+		{
+			cout << "Cubemap: baked faces differ in size or format, loading the sources instead" << endl;
+			return 0;
+		}
+	}
+	if (!bakedFormatSupported(views[0].header->format))
+		return 0;
+
+	unsigned int textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+	for (unsigned int i = 0; i < 6; i++)
+		uploadLevels(views[i], GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, views[0].header->levelCount - 1);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	return textureID;
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+
+using namespace std;
+
+// Baked texture format: block compressed images with their whole mip chain, written offline by
+// the baker and uploaded with glCompressedTexImage2D, so there is no decoding or mip generation
+// at load time and the textures take 4-8x less video memory than raw RGB(A).
+//
+// Layout (little endian):
+//   BakedTextureHeader
+//   BakedLevelRecord[faceCount * levelCount], face major
+//   level data, every level aligned to BAKED_TEXTURE_ALIGNMENT
+
+const char BAKED_TEXTURE_MAGIC[4] = { 'M', 'T', 'E', 'X' };
+const uint32_t BAKED_TEXTURE_VERSION = 1;
+const uint64_t BAKED_TEXTURE_ALIGNMENT = 16;
+const char* const BAKED_TEXTURE_EXTENSION = ".tex";
+
+// S3TC isn't core in GL 3.3 and our glad has no extensions, so the enums are declared here
+const unsigned int GL_COMPRESSED_RGB_S3TC_DXT1 = 0x83F0;
+const unsigned int GL_COMPRESSED_RGBA_S3TC_DXT5 = 0x83F3;
+
+enum BakedTextureFormat : uint32_t
+{
+	// RGB, 4 bits per pixel
+	BAKED_BC1 = 1,
+	// RGBA, 8 bits per pixel
+	BAKED_BC3 = 2,
+	// two channel, 8 bits per pixel, for normal maps
+	BAKED_BC5 = 3
+};
+
+struct BakedTextureHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	// 1 for 2D textures, 6 for cubemaps in GL_TEXTURE_CUBE_MAP_POSITIVE_X order
+	uint32_t faceCount;
+	uint32_t reserved;
+};
+
+struct BakedLevelRecord
+{
+	uint64_t offset;
+	uint32_t size;
+	uint32_t width;
+	uint32_t height;
+	uint32_t reserved;
+};
+
+static_assert(sizeof(BakedTextureHeader) == 32, "BakedTextureHeader layout changed, bump BAKED_TEXTURE_VERSION");
+static_assert(sizeof(BakedLevelRecord) == 24, "BakedLevelRecord layout changed, bump BAKED_TEXTURE_VERSION");
+
+// bytes in one 4x4 block
+inline unsigned int bakedBlockSize(uint32_t format)
+{
+	return format == BAKED_BC1 ? 8 : 16;
+}
+
+// bytes of a width x height level, partial blocks at the edges count as whole ones
+inline size_t bakedLevelSize(uint32_t format, uint32_t width, uint32_t height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * bakedBlockSize(format);
+}
+
+// Validated view over the bytes of a baked texture
+struct BakedTextureView
+{
+	const BakedTextureHeader* header = nullptr;
+	const BakedLevelRecord* levels = nullptr;
+	const unsigned char* base = nullptr;
+
+	bool parse(const unsigned char* data, size_t size);
+
+	const BakedLevelRecord& level(uint32_t face, uint32_t level) const
+	{
+		return levels[face * header->levelCount + level];
+	}
+	const unsigned char* levelData(const BakedLevelRecord& record) const
+	{
+		return base + record.offset;
+	}
+};
+
+// A compressed image to write, levels[face * levelCount + level] holds the block data
+struct BakedTextureData
+{
+	BakedTextureFormat format = BAKED_BC1;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t levelCount = 0;
+	uint32_t faceCount = 1;
+	vector<vector<unsigned char>> levels;
+};
+
+bool writeBakedTexture(const string& path, const BakedTextureData& texture);
+
+// The baked file that belongs to a source image, e.g. container2.png -> container2.tex
+string bakedTexturePath(const string& sourcePath);
+
+// Loads the up to date baked version of the image into a new 2D texture. Returns 0 when there is
+// no usable baked file or the driver lacks the compressed format, so the caller loads the source.
+unsigned int loadBakedTexture(const string& sourcePath);
+
+// Same for the six faces of a cubemap, each baked on its own. Returns 0 unless every face has one.
+unsigned int loadBakedCubemap(const vector<string>& faces);
+
+// GL_EXT_texture_compression_s3tc is needed for BC1 and BC3, BC5 is core
+bool bakedFormatSupported(uint32_t format);
@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include "entity_store.h"
+#include "transform_batch.h"
+
+using namespace std;
+
+// Smooths the drawn transform of every entity whose body moves it. The body transforms are
+// gathered into arrays once per frame and blended by the batch kernel instead of calling
+// Transform::interpolateTransforms per body.
+struct BodyInterpolator
+{
+	// the entities that have a body and a transform, in the order of the arrays below
+	vector<EntityId> entities;
+	TransformSoA previous;
+	TransformSoA current;
+	TransformSoA blended;
+
+	// Call again whenever bodies or transforms are added or removed
+	void build(EntityStore& store)
+	{
+		entities.clear();
+		store.eachSimulated([&](EntityId entity, BodyComponent&, Transform&)
+		{
+			entities.push_back(entity);
+		});
+		auto count = (unsigned int)entities.size();
+		previous.resize(count);
+		current.resize(count);
+		// nothing to apply until the next blend
+		blended.resize(0);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			previous.set(i, store.bodies.get(entities[i]).body->getTransform());
+		}
+	}
+
+	// factor is how far the frame is between the last body transforms and the current ones
+	void update(EntityStore& store, decimal factor)
+	{
+		blend(store, factor);
+		apply(store);
+	}
+
+	// Blends into the blended arrays only, reading nothing but the bodies. The physics thread
+	// does this while the render thread still draws the transforms of the last apply.
+	void blend(EntityStore& store, decimal factor)
+	{
+		auto count = (unsigned int)entities.size();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			current.set(i, store.bodies.get(entities[i]).body->getTransform());
+		}
+		interpolateTransformBatch(previous, current, (float)factor, blended);
+		std::swap(previous, current);
+	}
+
+	// copies the last blend into the transforms that get drawn
+	void apply(EntityStore& store)
+	{
+		auto count = blended.size();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			store.transforms.get(entities[i]) = blended.get(i);
+		}
+	}
+};
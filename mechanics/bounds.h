@@ -0,0 +1,105 @@
+#pragma once
+#include <cfloat>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Axis aligned box
+struct Aabb
+{
+	glm::vec3 min = glm::vec3(FLT_MAX);
+	glm::vec3 max = glm::vec3(-FLT_MAX);
+
+	bool valid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+	glm::vec3 center() const { return (min + max) * 0.5f; }
+	glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+	void add(const glm::vec3& point)
+	{
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	static Aabb merge(const Aabb& a, const Aabb& b)
+	{
+		return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+	}
+
+	bool contains(const Aabb& other) const
+	{
+		return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+	}
+
+	// half the surface area, what the tree insertion cost compares
+	float halfArea() const
+	{
+		glm::vec3 size = max - min;
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	Aabb grown(float margin) const
+	{
+		return { min - glm::vec3(margin), max + glm::vec3(margin) };
+	}
+
+	// bounds of this box after rotating and moving it, still axis aligned
+	Aabb transformed(const glm::vec3& position, const glm::quat& orientation) const
+	{
+		glm::mat3 rotation = glm::mat3_cast(orientation);
+		glm::mat3 absRotation;
+		for (int c = 0; c < 3; c++)
+			absRotation[c] = glm::abs(rotation[c]);
+		glm::vec3 newCenter = position + rotation * center();
+		glm::vec3 newExtents = absRotation * extents();
+		return { newCenter - newExtents, newCenter + newExtents };
+	}
+};
+
+enum class FrustumTest
+{
+	Outside,
+	Intersects,
+	Inside
+};
+
+// The six planes of a view frustum, normals pointing inwards
+struct Frustum
+{
+	glm::vec4 planes[6];
+
+	// from projection * view, so the planes are in world space
+	static Frustum fromMatrix(const glm::mat4& viewProjection)
+	{
+		Frustum frustum;
+		// rows of the matrix, glm stores columns
+		glm::vec4 rows[4];
+		for (int r = 0; r < 4; r++)
+			rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+		frustum.planes[0] = rows[3] + rows[0];	// left
+		frustum.planes[1] = rows[3] - rows[0];	// right
+		frustum.planes[2] = rows[3] + rows[1];	// bottom
+		frustum.planes[3] = rows[3] - rows[1];	// top
+		frustum.planes[4] = rows[3] + rows[2];	// near
+		frustum.planes[5] = rows[3] - rows[2];	// far
+		for (auto& plane : frustum.planes)
+			plane /= glm::length(glm::vec3(plane));
+		return frustum;
+	}
+
+	FrustumTest test(const Aabb& box) const
+	{
+		glm::vec3 center = box.center();
+		glm::vec3 extents = box.extents();
+		FrustumTest result = FrustumTest::Inside;
+		for (const auto& plane : planes)
+		{
+			glm::vec3 normal(plane);
+			float distance = glm::dot(normal, center) + plane.w;
+			float radius = glm::dot(glm::abs(normal), extents);
+			if (distance + radius < 0.0f)
+				return FrustumTest::Outside;
+			if (distance - radius < 0.0f)
+				result = FrustumTest::Intersects;
+		}
+		return result;
+	}
+};
@@ -12,7 +12,9 @@ enum Camera_Movement {
     FORWARD,
     BACKWARD,
     LEFT,
-    RIGHT
+    RIGHT,
+    UP,
+    DOWN
 };
 
 // Default camera values
@@ -91,6 +93,10 @@ public:
             newPos -= MoveRight * velocity;
         if (direction == RIGHT)
             newPos += MoveRight * velocity;
+        if (direction == UP)
+            newPos += WorldUp * velocity;
+        if (direction == DOWN)
+            newPos -= WorldUp * velocity;
 
         if (!constrain
             || (newPos.x >= positionConstraintMins.x && newPos.x <= positionConstraintMaxs.x
@@ -123,6 +129,15 @@ public:
         updateCameraVectors();
     }
 
+    // puts the camera somewhere and points it along front, e.g. when replaying a recording
+    void SetPose(glm::vec3 position, glm::vec3 front)
+    {
+        Position = position;
+        Yaw = glm::degrees(atan2(front.z, front.x));
+        Pitch = glm::degrees(asin(glm::clamp(front.y, -1.0f, 1.0f)));
+        updateCameraVectors();
+    }
+
     // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
     void ProcessMouseScroll(float yoffset)
     {
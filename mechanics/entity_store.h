@@ -0,0 +1,251 @@
+#pragma once
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <reactphysics3d/reactphysics3d.h>
+#include "model.h"
+
+using namespace std;
+using namespace reactphysics3d;
+
+// Entity ids stay valid until the entity is destroyed. The low bits are the slot in the store, the
+// high bits count how often that slot was reused so a stale id never finds a newer entity.
+// Named EntityId because reactphysics3d already has an Entity.
+typedef uint32_t EntityId;
+const EntityId NULL_ENTITY = 0xFFFFFFFF;
+const uint32_t ENTITY_INDEX_BITS = 24;
+const uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+
+inline uint32_t entityIndex(EntityId entity) { return entity & ENTITY_INDEX_MASK; }
+inline uint32_t entityGeneration(EntityId entity) { return entity >> ENTITY_INDEX_BITS; }
+
+// Sparse set of one component type. The components are packed in a dense array in no particular
+// order, the sparse array maps an entity's slot to its position in there. Adding, removing and
+// looking up are O(1), removing moves the last component into the hole.
+template<typename T>
+class ComponentPool
+{
+public:
+	bool has(EntityId entity) const
+	{
+		uint32_t index = entityIndex(entity);
+		return index < sparse.size() && sparse[index] != EMPTY && dense[sparse[index]] == entity;
+	}
+
+	// the entity has to have the component
+	T& get(EntityId entity) { return components[sparse[entityIndex(entity)]]; }
+	const T& get(EntityId entity) const { return components[sparse[entityIndex(entity)]]; }
+
+	T* find(EntityId entity) { return has(entity) ? &get(entity) : nullptr; }
+	const T* find(EntityId entity) const { return has(entity) ? &get(entity) : nullptr; }
+
+	// replaces the component if the entity already has one
+	T& add(EntityId entity, T component)
+	{
+		if (has(entity))
+		{
+			get(entity) = std::move(component);
+			return get(entity);
+		}
+		uint32_t index = entityIndex(entity);
+		if (index >= sparse.size())
+			sparse.resize(index + 1, EMPTY);
+		sparse[index] = (uint32_t)dense.size();
+		dense.push_back(entity);
+		components.push_back(std::move(component));
+		return components.back();
+	}
+
+	bool remove(EntityId entity)
+	{
+		if (!has(entity))
+			return false;
+		uint32_t index = entityIndex(entity);
+		uint32_t slot = sparse[index];
+		uint32_t last = (uint32_t)dense.size() - 1;
+		if (slot != last)
+		{
+			dense[slot] = dense[last];
+			components[slot] = std::move(components[last]);
+			sparse[entityIndex(dense[slot])] = slot;
+		}
+		dense.pop_back();
+		components.pop_back();
+		sparse[index] = EMPTY;
+		return true;
+	}
+
+	void clear()
+	{
+		sparse.clear();
+		dense.clear();
+		components.clear();
+	}
+
+	// dense access, for walking every component of this type
+	unsigned int size() const { return (unsigned int)dense.size(); }
+	EntityId entity(unsigned int slot) const { return dense[slot]; }
+	T& at(unsigned int slot) { return components[slot]; }
+	T* data() { return components.data(); }
+
+private:
+	static constexpr uint32_t EMPTY = 0xFFFFFFFF;
+	vector<uint32_t> sparse;
+	vector<EntityId> dense;
+	vector<T> components;
+};
+
+struct RenderComponent
+{
+	// shared between entities using the same model file when loaded through an AssetCache
+	shared_ptr<Model> model;
+	unsigned int shader_index = 0;
+};
+
+// The body and collider belong to the physics world, the store only refers to them
+struct BodyComponent
+{
+	RigidBody* body = nullptr;
+	Collider* collider = nullptr;
+};
+
+// Low poly stand-in for a model that hides what is behind it, drawn into the software occlusion
+// buffer. Model space triangles, three vertices each; it has to stay inside the drawn model.
+struct OccluderComponent
+{
+	vector<glm::vec3> triangles;
+};
+
+// Every object of a scene. An entity is only an id; what it is comes from the components it has:
+// something drawn has a transform and a render component, something simulated a body, and the
+// body drives the transform when it has both.
+class EntityStore
+{
+public:
+	ComponentPool<string> names;
+	ComponentPool<Transform> transforms;
+	ComponentPool<RenderComponent> renderables;
+	ComponentPool<BodyComponent> bodies;
+	ComponentPool<OccluderComponent> occluders;
+
+	// Returns NULL_ENTITY once all 2^24 slots are in use
+	EntityId create(const string& name = "")
+	{
+		uint32_t index;
+		if (!freeIndices.empty())
+		{
+			index = freeIndices.back();
+			freeIndices.pop_back();
+		}
+		else
+		{
+			// one more slot would run into the generation bits
+			assert(generations.size() <= ENTITY_INDEX_MASK && "EntityStore is out of entity slots");
+			if (generations.size() > ENTITY_INDEX_MASK)
+				return NULL_ENTITY;
+			index = (uint32_t)generations.size();
+			generations.push_back(0);
+		}
+		liveCount++;
+		EntityId entity = (generations[index] << ENTITY_INDEX_BITS) | index;
+		if (!name.empty())
+			names.add(entity, name);
+		return entity;
+	}
+
+	bool alive(EntityId entity) const
+	{
+		uint32_t index = entityIndex(entity);
+		return entity != NULL_ENTITY && index < generations.size() && generations[index] == entityGeneration(entity);
+	}
+
+	// Drops the entity and its components. Rigid bodies have to be destroyed through their world first.
+	void destroy(EntityId entity)
+	{
+		if (!alive(entity))
+			return;
+		names.remove(entity);
+		transforms.remove(entity);
+		renderables.remove(entity);
+		bodies.remove(entity);
+		occluders.remove(entity);
+		uint32_t index = entityIndex(entity);
+		generations[index] = (generations[index] + 1) & (0xFFFFFFFF >> ENTITY_INDEX_BITS);
+		// the last slot's last generation would spell NULL_ENTITY
+		if (((generations[index] << ENTITY_INDEX_BITS) | index) == NULL_ENTITY)
+			generations[index] = 0;
+		freeIndices.push_back(index);
+		liveCount--;
+	}
+
+	void clear()
+	{
+		names.clear();
+		transforms.clear();
+		renderables.clear();
+		bodies.clear();
+		occluders.clear();
+		generations.clear();
+		freeIndices.clear();
+		liveCount = 0;
+	}
+
+	unsigned int count() const { return liveCount; }
+
+	const string& name(EntityId entity) const
+	{
+		static const string none;
+		return names.has(entity) ? names.get(entity) : none;
+	}
+
+	// linear in the number of names, meant for loading and tools rather than per frame lookups
+	EntityId findByName(string_view name)
+	{
+		for (unsigned int i = 0; i < names.size(); i++)
+		{
+			if (names.at(i) == name)
+				return names.entity(i);
+		}
+		return NULL_ENTITY;
+	}
+
+	// Calls fn(entity, a, b) for every entity that has both components. Walks the smaller pool
+	// densely and looks the other component up.
+	template<typename A, typename B, typename Fn>
+	static void each(ComponentPool<A>& a, ComponentPool<B>& b, Fn fn)
+	{
+		if (a.size() <= b.size())
+		{
+			for (unsigned int i = 0; i < a.size(); i++)
+			{
+				if (B* other = b.find(a.entity(i)))
+					fn(a.entity(i), a.at(i), *other);
+			}
+		}
+		else
+		{
+			for (unsigned int i = 0; i < b.size(); i++)
+			{
+				if (A* other = a.find(b.entity(i)))
+					fn(b.entity(i), *other, b.at(i));
+			}
+		}
+	}
+
+	// fn(entity, Transform&, RenderComponent&) for everything that is drawn
+	template<typename Fn>
+	void eachRenderable(Fn fn) { each(transforms, renderables, fn); }
+
+	// fn(entity, BodyComponent&, Transform&) for every body that moves something drawn
+	template<typename Fn>
+	void eachSimulated(Fn fn) { each(bodies, transforms, fn); }
+
+private:
+	// current generation of every slot
+	vector<uint32_t> generations;
+	vector<uint32_t> freeIndices;
+	unsigned int liveCount = 0;
+};
@@ -0,0 +1,146 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include "shader.h"
+
+using namespace std;
+
+// GL calls the cache made and the ones it found redundant, since the last reset
+struct GlStateStats
+{
+	unsigned int programChanges = 0;
+	unsigned int vertexArrayChanges = 0;
+	unsigned int bufferChanges = 0;
+	unsigned int textureChanges = 0;
+	unsigned int uniformChanges = 0;
+	unsigned int skipped = 0;
+
+	unsigned int changes() const
+	{
+		return programChanges + vertexArrayChanges + bufferChanges + textureChanges + uniformChanges;
+	}
+};
+
+// Shadow copy of the GL state the render queue touches. Every setter compares against what it
+// last set and only calls GL when the value differs. Code binding things behind its back has to
+// run before reset(), which forgets everything so the next calls go through.
+class GlStateCache
+{
+public:
+	static const unsigned int TEXTURE_UNITS = 16;
+	static const unsigned int UNKNOWN = ~0u;
+
+	GlStateStats stats;
+
+	void reset()
+	{
+		program = UNKNOWN;
+		vertexArray = UNKNOWN;
+		arrayBuffer = UNKNOWN;
+		activeUnit = UNKNOWN;
+		for (auto& texture : textures)
+			texture = UNKNOWN;
+		uniforms.clear();
+		stats = GlStateStats();
+	}
+
+	void useProgram(unsigned int id)
+	{
+		if (program == id)
+		{
+			stats.skipped++;
+			return;
+		}
+		glUseProgram(id);
+		program = id;
+		stats.programChanges++;
+	}
+
+	void bindVertexArray(unsigned int id)
+	{
+		if (vertexArray == id)
+		{
+			stats.skipped++;
+			return;
+		}
+		glBindVertexArray(id);
+		vertexArray = id;
+		stats.vertexArrayChanges++;
+	}
+
+	void bindArrayBuffer(unsigned int id)
+	{
+		if (arrayBuffer == id)
+		{
+			stats.skipped++;
+			return;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, id);
+		arrayBuffer = id;
+		stats.bufferChanges++;
+	}
+
+	// GL_TEXTURE_2D on the given unit, only switching the active unit when something is bound
+	void bindTexture(unsigned int unit, unsigned int id)
+	{
+		if (unit < TEXTURE_UNITS && textures[unit] == id)
+		{
+			stats.skipped++;
+			return;
+		}
+		activeTexture(unit);
+		glBindTexture(GL_TEXTURE_2D, id);
+		if (unit < TEXTURE_UNITS)
+			textures[unit] = id;
+		stats.textureChanges++;
+	}
+
+	void activeTexture(unsigned int unit)
+	{
+		if (activeUnit == unit)
+			return;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+	}
+
+	// uniforms belong to the program, which has to be the one in use
+	void setInt(UniformHandle handle, int value)
+	{
+		setUniform(handle, glm::vec4((float)value, 0.0f, 0.0f, 0.0f), [&] { glUniform1i(handle.location, value); });
+	}
+
+	void setVec3(UniformHandle handle, const glm::vec3& value)
+	{
+		setUniform(handle, glm::vec4(value, 0.0f), [&] { glUniform3fv(handle.location, 1, glm::value_ptr(value)); });
+	}
+
+private:
+	unsigned int program = UNKNOWN;
+	unsigned int vertexArray = UNKNOWN;
+	unsigned int arrayBuffer = UNKNOWN;
+	unsigned int activeUnit = UNKNOWN;
+	unsigned int textures[TEXTURE_UNITS] = { UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN,
+		UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN };
+	// last value of each uniform, keyed by program and location
+	unordered_map<uint64_t, glm::vec4> uniforms;
+
+	template<typename Set>
+	void setUniform(UniformHandle handle, const glm::vec4& value, Set set)
+	{
+		if (!handle.valid())
+			return;
+		uint64_t key = ((uint64_t)program << 32) | (uint32_t)handle.location;
+		auto it = uniforms.find(key);
+		if (it != uniforms.end() && it->second == value)
+		{
+			stats.skipped++;
+			return;
+		}
+		set();
+		uniforms[key] = value;
+		stats.uniformChanges++;
+	}
+};
@@ -0,0 +1,113 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <GLFW/glfw3.h>
+
+using namespace std;
+
+// What a key does in the game, keys are bound to these instead of being checked by name
+enum class InputAction
+{
+	None,
+	Quit,
+	MoveForward,
+	MoveBackward,
+	MoveLeft,
+	MoveRight,
+	ToggleDebugRendering,
+	Punch,
+	Jump,
+	Count
+};
+
+// One press or release of a bound key, repeats are not reported
+struct InputEvent
+{
+	InputAction action;
+	bool pressed;
+	// glfwGetTime() when GLFW reported it
+	double time;
+};
+
+// Single producer, single consumer ring. The producer is the GLFW key callback, the consumer is
+// whoever drains the input each frame; neither takes a lock.
+template<typename T, unsigned int N>
+class SpscQueue
+{
+	static_assert((N & (N - 1)) == 0, "the capacity has to be a power of two");
+
+public:
+	// false when full, the event is lost
+	bool push(const T& item)
+	{
+		unsigned int tail = writeIx.load(memory_order_relaxed);
+		if (tail - readIx.load(memory_order_acquire) == N)
+			return false;
+		items[tail & (N - 1)] = item;
+		writeIx.store(tail + 1, memory_order_release);
+		return true;
+	}
+
+	bool pop(T& item)
+	{
+		unsigned int head = readIx.load(memory_order_relaxed);
+		if (head == writeIx.load(memory_order_acquire))
+			return false;
+		item = items[head & (N - 1)];
+		readIx.store(head + 1, memory_order_release);
+		return true;
+	}
+
+private:
+	T items[N];
+	atomic<unsigned int> writeIx{ 0 };
+	atomic<unsigned int> readIx{ 0 };
+};
+
+// Turns GLFW key callbacks into edge triggered events for bound actions. Actions that act on a
+// press (punch, toggles) read the events, continuous ones (movement) ask isHeld.
+class InputSystem
+{
+public:
+	static const unsigned int QUEUE_SIZE = 256;
+
+	void bind(int key, InputAction action)
+	{
+		if (key >= 0 && key <= GLFW_KEY_LAST)
+			bindings[key] = action;
+	}
+
+	// forward glfwSetKeyCallback here
+	void onKey(int key, int action, double time)
+	{
+		// key repeats would make a held key fire again
+		if (key < 0 || key > GLFW_KEY_LAST || action == GLFW_REPEAT)
+			return;
+		InputAction bound = bindings[key];
+		if (bound == InputAction::None)
+			return;
+		if (!events.push({ bound, action == GLFW_PRESS, time }))
+			dropped++;
+	}
+
+	// hands every event since the last drain to fn, oldest first, and updates the held state
+	void drain(const function<void(const InputEvent&)>& fn)
+	{
+		InputEvent event;
+		while (events.pop(event))
+		{
+			held[(int)event.action] = event.pressed;
+			if (fn)
+				fn(event);
+		}
+	}
+
+	bool isHeld(InputAction action) const { return held[(int)action]; }
+	unsigned int droppedEvents() const { return dropped; }
+
+private:
+	InputAction bindings[GLFW_KEY_LAST + 1] = {};
+	bool held[(int)InputAction::Count] = {};
+	SpscQueue<InputEvent, QUEUE_SIZE> events;
+	unsigned int dropped = 0;
+};
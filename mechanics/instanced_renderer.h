@@ -0,0 +1,216 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+#include <unordered_map>
+#include "model.h"
+#include "shader.h"
+#include "entity_store.h"
+#include "transform_batch.h"
+#include "render_bvh.h"
+#include "render_queue.h"
+
+using namespace std;
+
+// Where the camera is and how it projects, for picking each entity's level of detail
+struct LodView
+{
+	glm::vec3 position = glm::vec3(0.0f);
+	// pixels covered by one unit seen from one unit away, viewport height / (2 * tan(fovy / 2))
+	float pixelsPerUnit = 0.0f;
+	// the coarsest level whose error stays under this many pixels on screen is used
+	float maxPixelError = 1.0f;
+};
+
+// A coarser level is only taken once its error is this far under the limit, so an entity sitting
+// right at a switching distance doesn't flicker between two levels
+const float LOD_HYSTERESIS = 0.75f;
+
+// level of detail for an entity whose model errors are scaled to pixels by pixelScale, moving at
+// most as far from the current level as needed
+inline unsigned int selectLod(const vector<float>& errors, float pixelScale, unsigned int current, float maxPixelError)
+{
+	if (errors.empty())
+		return 0;
+	unsigned int level = std::min(current, (unsigned int)errors.size() - 1);
+	while (level > 0 && errors[level] * pixelScale > maxPixelError)
+		level--;
+	while (level + 1 < errors.size() && errors[level + 1] * pixelScale <= maxPixelError * LOD_HYSTERESIS)
+		level++;
+	return level;
+}
+
+// Draws the entities with a transform and a model grouped by the model they share, so every mesh
+// is drawn once per level of detail for all of its entities with glDrawElementsInstanced, through
+// a RenderQueue. The shader reads the model matrix from the per-instance attribute at locations 3-6
+// instead of a "model" uniform.
+struct InstancedRenderer
+{
+	struct Batch
+	{
+		// the geometry every entry of the batch is drawn with
+		Model* model = nullptr;
+		vector<EntityId> entities;
+		// the level of detail each entity was last drawn with
+		vector<unsigned char> lods;
+		// this frame's visible entities, as indexes into entities
+		vector<unsigned int> visible;
+		// instances per level of detail, then where each level starts in the instance buffer
+		vector<unsigned int> levelCounts;
+		vector<unsigned int> levelStarts;
+		// distance to the nearest instance of each level, for the queue's depth order
+		vector<float> levelDepths;
+		// each entity's distance this frame
+		vector<float> distances;
+		TransformSoA transforms;
+		// only used when the instance buffer can't be mapped
+		vector<glm::mat4> matrices;
+		unsigned int instanceVBO = 0;
+	};
+
+	vector<Batch> batches;
+	// packets the last submit() queued, one per mesh and level in use
+	unsigned int drawCalls = 0;
+	unsigned int trianglesDrawn = 0;
+
+	// groups the entities by model. Call again whenever entities are added, removed or change model.
+	void build(EntityStore& store)
+	{
+		release();
+		unordered_map<Model*, unsigned int> batchIndexes;
+		store.eachRenderable([&](EntityId entity, Transform&, RenderComponent& render)
+		{
+			auto* model = render.model.get();
+			if (model == nullptr)
+				return;
+			auto it = batchIndexes.find(model);
+			if (it == batchIndexes.end())
+			{
+				Batch batch;
+				batch.model = model;
+				glGenBuffers(1, &batch.instanceVBO);
+				batch.model->setInstanceBuffer(batch.instanceVBO);
+				batches.push_back(batch);
+				it = batchIndexes.emplace(model, (unsigned int)batches.size() - 1).first;
+			}
+			batches[it->second].entities.push_back(entity);
+		});
+		for (auto& batch : batches)
+		{
+			batch.transforms.resize((unsigned int)batch.entities.size());
+			batch.matrices.resize(batch.entities.size());
+			batch.lods.assign(batch.entities.size(), 0);
+			batch.levelCounts.assign(std::max<size_t>(batch.model->lodErrors.size(), 1), 0);
+			batch.levelStarts.resize(batch.levelCounts.size());
+			batch.levelDepths.resize(batch.levelCounts.size());
+			batch.distances.assign(batch.entities.size(), 0.0f);
+		}
+	}
+
+	// Fills the instance buffers and queues the draws, the queue's execute() draws them.
+	// With a culler, only the entities it marked visible in its last cull are drawn. With a view,
+	// every entity gets the level of detail that fits its distance, otherwise the full meshes are drawn.
+	void submit(EntityStore& store, Shader& shader, RenderQueue& queue, const FrustumCuller* culler = nullptr, const LodView* view = nullptr)
+	{
+		drawCalls = 0;
+		trianglesDrawn = 0;
+		for (auto& batch : batches)
+		{
+			const Model& model = *batch.model;
+			glm::vec3 localCenter = model.bounds.center();
+			float radius = glm::length(model.bounds.extents());
+			batch.visible.clear();
+			std::fill(batch.levelCounts.begin(), batch.levelCounts.end(), 0);
+			std::fill(batch.levelDepths.begin(), batch.levelDepths.end(), FLT_MAX);
+			for (unsigned int i = 0; i < batch.entities.size(); i++)
+			{
+				EntityId entity = batch.entities[i];
+				if (culler != nullptr && !culler->isVisible(entity))
+					continue;
+				if (view != nullptr && model.bounds.valid())
+				{
+					const Transform& transform = store.transforms.get(entity);
+					Vector3 center = transform.getPosition() + transform.getOrientation() * Vector3(localCenter.x, localCenter.y, localCenter.z);
+					// distance to the nearest point of the bounding sphere, the error is never larger than there
+					float distance = glm::length(glm::vec3(center.x, center.y, center.z) - view->position) - radius;
+					float pixelScale = view->pixelsPerUnit / std::max(distance, 0.01f);
+					batch.lods[i] = (unsigned char)selectLod(model.lodErrors, pixelScale, batch.lods[i], view->maxPixelError);
+					batch.distances[i] = std::max(distance, 0.0f);
+				}
+				else
+				{
+					batch.lods[i] = 0;
+					batch.distances[i] = 0.0f;
+				}
+				batch.visible.push_back(i);
+				batch.levelCounts[batch.lods[i]]++;
+				batch.levelDepths[batch.lods[i]] = std::min(batch.levelDepths[batch.lods[i]], batch.distances[i]);
+			}
+			unsigned int count = (unsigned int)batch.visible.size();
+			if (count == 0)
+				continue;
+
+			// instances sorted by level, so each level is one range of the buffer
+			unsigned int start = 0;
+			for (unsigned int level = 0; level < batch.levelCounts.size(); level++)
+			{
+				batch.levelStarts[level] = start;
+				start += batch.levelCounts[level];
+			}
+			for (unsigned int i : batch.visible)
+				batch.transforms.set(batch.levelStarts[batch.lods[i]]++, store.transforms.get(batch.entities[i]));
+
+			// the arrays stay sized for the whole batch, only the first count are written
+			unsigned int capacity = batch.transforms.size();
+			batch.transforms.resize(count);
+			// respecifying the whole store orphans last frame's buffer instead of waiting on it, so
+			// the fresh one can be mapped unsynchronized and the matrices written straight into it
+			GLsizeiptr size = count * sizeof(glm::mat4);
+			glBindBuffer(GL_ARRAY_BUFFER, batch.instanceVBO);
+			glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+			void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, size,
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+			if (mapped != nullptr)
+			{
+				writeModelMatrixBatch(batch.transforms, (float*)mapped);
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+			}
+			else
+			{
+				writeModelMatrixBatch(batch.transforms, glm::value_ptr(batch.matrices[0]));
+				glBufferSubData(GL_ARRAY_BUFFER, 0, size, batch.matrices.data());
+			}
+			batch.transforms.resize(capacity);
+
+			start = 0;
+			for (unsigned int level = 0; level < batch.levelCounts.size(); level++)
+			{
+				unsigned int levelCount = batch.levelCounts[level];
+				if (levelCount == 0)
+					continue;
+				for (auto& mesh : batch.model->meshes)
+				{
+					queue.submit(RenderPass::Opaque, shader, mesh, level, batch.instanceVBO, start, levelCount,
+						batch.levelDepths[level]);
+				}
+				drawCalls += (unsigned int)model.meshes.size();
+				trianglesDrawn += model.triangleCount(level) * levelCount;
+				start += levelCount;
+			}
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	void release()
+	{
+		for (auto& batch : batches)
+		{
+			glDeleteBuffers(1, &batch.instanceVBO);
+		}
+		batches.clear();
+	}
+};
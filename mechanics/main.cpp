@@ -8,6 +8,14 @@
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include "shader.h"
+#include "uniform_buffers.h"
+#include "instanced_renderer.h"
+#include "body_interpolator.h"
+#include "physics_pipeline.h"
+#include "profiler.h"
+#include "input.h"
+#include "asset_cache.h"
+#include "texture_loader.h"
 #include "camera.h"
 #include "model.h"
 #include "stb_image.h"
@@ -23,15 +31,16 @@
 #include "collision_event_listener.h"
 #include "../editor/scene_loader.h"
 #include "../editor/scene_manager.h"
+#include "arena.h"
 using namespace reactphysics3d;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void bindKeys();
 void processInput(GLFWwindow* window);
-void setupPointLights(Shader* shader);
-void performPunch();
-void performJump();
+void setupLights(LightsData* lights);
 
 const Vector3 toPhysVec(glm::vec3 vec);
 const glm::vec3 toGlm(Vector3 vec);
@@ -41,7 +50,12 @@ bool USE_PHY_DEBUG_RENDERING = false;
 const int SCR_WIDTH = 1920;
 const int SCR_HEIGHT = 1080;
 const float _physicsTimestep = 1.0f / 60.0f;
-const int CAMERA_INDEX = NUM_PHY_OBJECTS - 1;
+// at most 4 steps a frame, solver iterations (15/8 from the arena) halve while that isn't enough
+TimestepSettings physicsTiming = { _physicsTimestep, 4, 0.25f, true, 15, 8, 2, 120 };
+// step physics on its own thread, overlapping with rendering at the cost of a frame of latency
+const bool PIPELINED_PHYSICS = true;
+// profiler zones still in the buffers are written here on exit, open it in chrome://tracing
+const char* TRACE_PATH = "mechanics_trace.json";
 
 // camera
 Camera camera;
@@ -49,6 +63,9 @@ float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
+// input
+InputSystem input;
+
 // timing
 float deltaTime = 0.0f;	// time between current frame and last frame
 float lastFrame = 0.0f;
@@ -57,13 +74,32 @@ float lastFrame = 0.0f;
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 
 // physics
-RigidBody* ballBody = nullptr;
-Collider* ballCollider = nullptr;
-RigidBody* cameraBody = nullptr;
 bool ballUsesGravity = false;
+PhysicsPipeline physicsPipeline;
 
-int main()
+// Usage: mechanics [--record <path>] [--replay <path>]
+int main(int argc, char** argv)
 {
+	string recordPath = "";
+	string replayPath = "";
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if (arg == "--record" && i + 1 < argc)
+			recordPath = argv[++i];
+		else if (arg == "--replay" && i + 1 < argc)
+			replayPath = argv[++i];
+		else
+		{
+			cout << "Usage: " << argv[0] << " [--record <path>] [--replay <path>]" << endl;
+			return -1;
+		}
+	}
+	// a replay starts from the world the recording started from
+	PhysicsReplay replay;
+	if (replayPath != "" && !replay.open(replayPath))
+		return -1;
+
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -80,6 +116,8 @@ int main()
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
+	glfwSetKeyCallback(window, key_callback);
+	bindKeys();
 
 	// tell GLFW to capture our mouse
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -94,18 +132,36 @@ int main()
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_FRAMEBUFFER_SRGB);
 
+	profiler.nameThread("main");
+	gpuProfiler.init();
+	float lastOverlayUpdate = 0.0f;
+
 	// With our nice shader class, just give the paths and call use
 	Shader lightShader("shaders/light/vertex.glsl", "shaders/light/fragment.glsl");
 	Shader skyboxShader("shaders/skybox/vertex.glsl", "shaders/skybox/fragment.glsl");
 	Shader lampShader("shaders/lamp/vertex.glsl", "shaders/lamp/fragment.glsl");
 	skyboxShader.use();
 	skyboxShader.setInt("skybox", 0);
+	lightShader.use();
+	lightShader.setFloat("material.shininess", 64.0f);
 	stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
 	Shader shaders[3] = {
 		lightShader, skyboxShader, lampShader
 	};
 
-	setupPointLights(&lightShader);
+	// Shared uniform blocks. Lights never change so they are uploaded once, FrameData once per frame.
+	UniformBuffer frameBuffer;
+	frameBuffer.init(sizeof(FrameData), FRAME_DATA_BINDING);
+	UniformBuffer lightsBuffer;
+	lightsBuffer.init(sizeof(LightsData), LIGHTS_BINDING);
+	LightsData lights = {};
+	setupLights(&lights);
+	lightsBuffer.update(&lights);
+	FrameData frameData = {};
+
+	// Images are decoded on worker threads and uploaded a few per frame, placeholders are shown until then
+	TextureLoader textureLoader;
+	textureLoader.start();
 
 	Skybox skybox;
 	// Set up our skybox
@@ -118,274 +174,242 @@ int main()
 		"assets/skybox/front.jpg",
 		"assets/skybox/back.jpg"
 	};
-	skybox.init(faces);
-
-	// Set up our objects for physics and rendering
-	RenderingState renders(NUM_RENDER_OBJECTS);
-	PhysicsState physics(NUM_PHY_OBJECTS);
-
-	auto ball = Model("assets/ball/ball.obj");
-	renders.models[0] = ball;
-	renders.shader_indices[0] = 0;
-	renders.names[0] = "ball";
-
-	for (unsigned int i = 1; i < NUM_RENDER_OBJECTS; i++)
+	skybox.init(faces, &textureLoader);
+
+	// Every object for physics and rendering lives in here
+	EntityStore entities;
+
+	// Entities using the same model file share one copy of its meshes and textures
+	AssetCache assets;
+	assets.textures.loader = &textureLoader;
+	EntityId environment = entities.create("environment1");
+	entities.transforms.add(environment, Transform::identity());
+	entities.renderables.add(environment, { assets.model("assets/plank/plank.obj"), 0 });
+	// the plank is big and solid enough to hide what is behind it, a slightly shrunk box of it
+	// stays inside the drawn mesh
 	{
-		renders.models[i] = Model("assets/plank/plank.obj");
-		renders.transforms[i] = Transform(Vector3::zero(), Quaternion::identity());
-		renders.shader_indices[i] = 0;
-		renders.names[i] = "environment" + to_string(i);
+		const Aabb& plankBounds = entities.renderables.get(environment).model->bounds;
+		glm::vec3 center = plankBounds.center();
+		glm::vec3 extents = plankBounds.extents() * 0.95f;
+		entities.occluders.add(environment, occluderFromBox({ center - extents, center + extents }));
 	}
 
-	// Create the world settings 
-	PhysicsWorld::WorldSettings settings;
-	settings.isSleepingEnabled = true;
-	settings.gravity = Vector3(0, -9.81f, 0);
+	// Create the physics world and the arena
 	PhysicsCommon common;
-	auto* world = common.createPhysicsWorld(settings);
+	auto* world = createArenaWorld(common);
 	CollisionEventListener coll_listener;
 	world->setEventListener(&coll_listener);
 	world->setIsDebugRenderingEnabled(true);
-	// Defaults are 10 and 5 so if this is laggy then change it.
-	world->setNbIterationsVelocitySolver(15);
-	world->setNbIterationsPositionSolver(8);
-
-	// Rigidbody setup
-	auto ballTransform = Transform(Vector3(15.0f, 30.0f, -50.0f), Quaternion::identity());
-	physics.prev_transforms[0] = ballTransform;
-	renders.transforms[0] = ballTransform;
-	ballBody = world->createRigidBody(ballTransform);
-	ballBody->setType(BodyType::DYNAMIC);
-	ballBody->enableGravity(ballUsesGravity);
-	physics.bodies[0] = ballBody;
-	physics.names[0] = "ball";
-	float ballRadius = 6.0f;
-	// TODO: how to get physics shapes to match extents of meshes?
-	SphereShape* sphereShape = common.createSphereShape(ballRadius);
-	Vector3 floorExtents(160.0f, 1.0f, 160.0f);
-	Vector3 wallExtents(75.0, 1.0f, floorExtents.z);
-	BoxShape* floorShape = common.createBoxShape(floorExtents);
-	BoxShape* wallShape = common.createBoxShape(wallExtents);
-	BoxShape* netShape = common.createBoxShape(Vector3(12.0f, 1.0f, floorExtents.z));
-	CapsuleShape* capsuleShape = common.createCapsuleShape(3.0f, 4.0f);
-
-	// Relative transform of the collider relative to the body origin 
-	Transform ident = Transform::identity();
-
-	// Add the collider to the rigid body 
-	ballCollider = ballBody->addCollider(sphereShape, ident);
-	ballCollider->getMaterial().setBounciness(0.6f);
-	ballCollider->getMaterial().setFrictionCoefficient(0.5f);
-	ballCollider->getMaterial().setRollingResistance(1.5f);
-	ballCollider->getMaterial().setMassDensity(2.0f);
-	ballBody->setIsAllowedToSleep(false);
-	ballCollider->setCollisionCategoryBits(CollisionCategories::BALL);
-	ballCollider->setCollideWithMaskBits(CollisionCategories::BALL | 
-		CollisionCategories::ENVIRONMENT | 
-		CollisionCategories::CAMERA | 
-		CollisionCategories::FLOOR | 
-		CollisionCategories::NET);
-	physics.colliders[0] = ballCollider;
 
 	camera.Init(glm::vec3(-50.0f, -20.0f, -250.0f), 
 		glm::vec3(250.0f, 0.0f, 50.0f),
 		glm::vec3(10.0f, -4.0f, 0.0f));
-	auto cameraTransform = Transform(toPhysVec(camera.Position), Quaternion::identity());
-	cameraBody = world->createRigidBody(cameraTransform);
-	cameraBody->setType(BodyType::DYNAMIC);
-	cameraBody->enableGravity(true);
-	cameraBody->setMass(5.0f);
-	auto cameraCollider = cameraBody->addCollider(capsuleShape, ident);
-	cameraCollider->setCollisionCategoryBits(CollisionCategories::CAMERA);
-	cameraCollider->setCollideWithMaskBits(CollisionCategories::BALL | 
-		CollisionCategories::ENVIRONMENT | 
-		CollisionCategories::FLOOR | 
-		CollisionCategories::NET);
-	physics.bodies[CAMERA_INDEX] = cameraBody;
-	physics.prev_transforms[CAMERA_INDEX] = cameraTransform;
-	physics.colliders[CAMERA_INDEX] = cameraCollider;
-	physics.names[CAMERA_INDEX] = "camera";
-
-	constexpr float rad90 = glm::radians(90.0f);
-	const auto envCount = NUM_PHY_OBJECTS - 2;
-	Vector3 angles[envCount] = {
-		Vector3(0.0f, 0.0f, 0.0f), // floor
-		Vector3(0.0f, 0.0f, rad90), // left wall
-		Vector3(rad90, 0.0f, rad90), // back wall
-		Vector3(0.0f, 0.0f, rad90), // right wall
-		Vector3(rad90, 0.0f, rad90), // front wall
-		Vector3(0.0f, 0.0f, 0.0f), // ceiling
-		Vector3(rad90, 0.0f, rad90) // net
-	};
-
-	Vector3 origin(25.0f, -25.0f, -25.0f);
-	Vector3 start(25.0f + floorExtents.x / 2, -25.0f, -25.0f + -1.0f * (floorExtents.z / 2));
-	Vector3 positions[envCount] = {
-		Vector3(origin.x + floorExtents.x / 2, origin.y, origin.z + -1.0f * (floorExtents.z / 2)), // floor
-		Vector3(origin.x - floorExtents.x / 2, floorExtents.y, origin.z - floorExtents.z / 2), // left wall
-		Vector3(origin.x + floorExtents.x / 2, floorExtents.y, 4 * origin.z - floorExtents.z), // back wall
-		Vector3(4 * origin.x + floorExtents.x, floorExtents.y, origin.z - floorExtents.z / 2), // right wall
-		Vector3(origin.x + floorExtents.x / 2, floorExtents.y, origin.z + floorExtents.z / 2), // front wall
-		Vector3(origin.x + floorExtents.x / 2, origin.y + 80.0f, origin.z + -1.0f * (floorExtents.z / 2)), // ceiling
-		Vector3(origin.x + floorExtents.x / 2, floorExtents.y - 15.0f, -100.0f), // back wall
-	};
-	BoxShape* boxShapes[envCount] = {
-		floorShape,
-		wallShape,
-		wallShape,
-		wallShape,
-		wallShape,
-		floorShape,
-		netShape,
-	};
-	// Start at 1 because we set up the ball collider manually
-	// Stop before the end because we set up the camera collider manually
-	for (unsigned int i = 1; i < (NUM_PHY_OBJECTS - 1); i++)
+	if (replayPath != "")
 	{
-		auto trans = Transform(positions[i - 1], Quaternion::fromEulerAngles(angles[i - 1]));
-		physics.prev_transforms[i] = trans;
-		auto rBody = world->createRigidBody(trans);
-		rBody->setType(BodyType::STATIC);
-		physics.bodies[i] = rBody;
-		auto coll = rBody->addCollider(boxShapes[i - 1], ident);
-		// All these indexes are hard coded right now, this will be fixed once we have an editor
-		if (i == 1)
-			coll->setCollisionCategoryBits(CollisionCategories::FLOOR);
-		else if (i == (NUM_PHY_OBJECTS - 2))
-			coll->setCollisionCategoryBits(CollisionCategories::NET);
-		else
-			coll->setCollisionCategoryBits(CollisionCategories::ENVIRONMENT);
-		coll->setCollideWithMaskBits(CollisionCategories::BALL | CollisionCategories::CAMERA);
-		physics.colliders[i] = coll;
-		physics.names[i] = "env" + to_string(i);
+		const RecordingHeader& recorded = replay.getHeader();
+		camera.Position = glm::vec3(recorded.cameraStart[0], recorded.cameraStart[1], recorded.cameraStart[2]);
+		ballUsesGravity = recorded.ballUsesGravity != 0;
 	}
+	auto arena = buildArena(common, world, entities, toPhysVec(camera.Position), ballUsesGravity);
+	// the ball is the one body that is drawn, so its transform follows the simulation
+	entities.transforms.add(arena.ball, arena.ballBody->getTransform());
+	entities.renderables.add(arena.ball, { assets.model("assets/ball/ball.obj"), 0 });
 
 	// Init variables for main loop
-	float accumulator = 0.0f;
-	float modelMatrix[16];
+	InstancedRenderer instancedRenderer;
+	instancedRenderer.build(entities);
+	// entities outside the view aren't drawn, the culler indexes them by their model bounds
+	FrustumCuller culler;
+	culler.build(entities);
+	// and the ones in view are tested against the occluders drawn into a small CPU depth buffer
+	OcclusionBuffer occlusion;
+	// the frame's draws, sorted to share GL state; depth is measured up to the far plane
+	RenderQueue renderQueue;
+	renderQueue.maxDepth = 800.0f;
+	// only bodies that move something drawn need interpolating
+	BodyInterpolator interpolator;
+	interpolator.build(entities);
+	physicsPipeline.applyCommand = [&arena](PhysicsWorld*, const PhysicsCommand& command)
+	{
+		applyArenaCommand(arena, command);
+	};
+	PhysicsRecorder recorder;
+	if (recordPath != "")
+	{
+		RecordingHeader header = {};
+		header.bodyCount = entities.bodies.size();
+		header.timestep = _physicsTimestep;
+		header.ballUsesGravity = ballUsesGravity;
+		header.cameraStart[0] = camera.Position.x;
+		header.cameraStart[1] = camera.Position.y;
+		header.cameraStart[2] = camera.Position.z;
+		if (recorder.open(recordPath, header))
+			physicsPipeline.setRecorder(&recorder);
+	}
+	if (replayPath != "")
+	{
+		if (replay.getHeader().bodyCount != entities.bodies.size())
+			cout << "Recording '" << replayPath << "' was made with " << replay.getHeader().bodyCount << " bodies, this world has " << entities.bodies.size() << endl;
+		physicsPipeline.setReplay(&replay);
+	}
+	physicsPipeline.start(world, &entities, &interpolator, physicsTiming, PIPELINED_PHYSICS);
 
 
 	//SceneLoader loader;
-	//loader.writeSceneToDisk("scene1.scene", "scene1", &renders, &physics, world);
-	//auto header = loader.loadScene("scene1.scene", "scene1");
+	//loader.writeSceneToDisk("scene1.scene", "scene1", &entities, world);
+	//loader.writeSceneBinaryToDisk("scene1.bscene", "scene1", &entities, world);
+	//auto header = loader.loadScene("scene1.scene", "scene1", &common, &assets);
 
 	// TODO: memory cleanup
 
 	//world = header->world;
-	//renders = *header->renders;
-	//physics = *header->physics;
+	//entities = std::move(*header->entities);
 	PhysicsDebugRenderer phyDebugRenderer(world);
 	float frameRate = 0.0f;
 
 	while (!glfwWindowShouldClose(window))
 	{
+		PROFILE_SCOPE("frame");
+		gpuProfiler.beginFrame();
+
 		// per-frame time logic
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
-		//frameRate = 1 / deltaTime;
-		//cout << "Frame rate: " << to_string(frameRate) << "fps" << endl;
 		lastFrame = currentFrame;
-		processInput(window);
-
-		//cout << "Camera position. X: " << camera.Position.x << " Y: " << camera.Position.y << " Z: " << camera.Position.z << endl;
 
-		cameraBody->setTransform(Transform(toPhysVec(camera.Position), Quaternion::identity()));
+		{
+			PROFILE_SCOPE("input");
+			processInput(window);
+		}
 
-		accumulator += deltaTime;
-		while (accumulator >= _physicsTimestep)
+		// upload whatever the texture workers finished since last frame
 		{
-			// Update the physics sim
-			world->update(_physicsTimestep);
-			accumulator -= _physicsTimestep;
+			PROFILE_SCOPE("texture uploads");
+			textureLoader.processUploads();
 		}
 
-		// Compute the time interpolation factor 
-		decimal factor = accumulator / _physicsTimestep;
+		//cout << "Camera position. X: " << camera.Position.x << " Y: " << camera.Position.y << " Z: " << camera.Position.z << endl;
 
-		for (unsigned int i = 0; i < NUM_PHY_OBJECTS; i++)
+		// Sync render transforms with the interpolated rigidbody transforms of the last simulated frame
+		physicsPipeline.wait();
+
+		// the world is idle until the next submit
+		if (USE_PHY_DEBUG_RENDERING)
 		{
-			const auto& currTrans = physics.bodies[i]->getTransform();
-			// Compute the interpolated transform of the rigid body 
-			Transform interpolatedTransform = Transform::interpolateTransforms(physics.prev_transforms[i], currTrans, factor);
+			PROFILE_SCOPE("debug render update");
+			phyDebugRenderer.updateDebugState();
+		}
 
-			// Update the previous transform 
-			physics.prev_transforms[i] = currTrans;
-			if (i < (NUM_RENDER_OBJECTS - 1))
-			{
-				// Sync render transform with rigidbody transform
-				renders.transforms[i] = interpolatedTransform;
-			}
+		// live overlay: the slowest zones of the last second and the simulation time dropped so far
+		if (currentFrame - lastOverlayUpdate > 0.5f)
+		{
+			lastOverlayUpdate = currentFrame;
+			string title = "Best Game Ever | " + profiler.summaryText(1000000000ull);
+			title += " | drawn " + to_string(culler.stats.drawn) + "/" + to_string(culler.stats.entries);
+			title += " (" + to_string(culler.stats.occluded) + " occluded), " + to_string(instancedRenderer.trianglesDrawn) + " triangles";
+			title += " | " + to_string(renderQueue.drawCalls) + " draws, " + to_string(renderQueue.stats.changes()) + " state changes ("
+				+ to_string(renderQueue.stats.skipped) + " skipped)";
+			const TimestepController& timing = physicsPipeline.timing();
+			if (timing.framesDropped() > 0)
+				title += " | physics dropped " + to_string((int)(timing.totalDropped() * 1000.0)) + " ms in " + to_string(timing.framesDropped()) + " frames";
+			glfwSetWindowTitle(window, title.c_str());
 		}
 
-		if (USE_PHY_DEBUG_RENDERING)
+		// Update the physics sim, on the physics thread while this frame is drawn
+		physicsPipeline.push({ PhysicsCommandType::MoveCamera, toPhysVec(camera.Position), toPhysVec(camera.Front) });
+		physicsPipeline.submit(deltaTime);
+		if (physicsPipeline.replaying())
 		{
-			phyDebugRenderer.updateDebugState();
+			if (physicsPipeline.replayFinished())
+			{
+				cout << "Replayed " << replay.framesRead() << " frames, " << physicsPipeline.replayMismatches() << " steps differed from the recording" << endl;
+				glfwSetWindowShouldClose(window, true);
+			}
+			// look from where the recording looked
+			for (const auto& command : physicsPipeline.replayedFrame().commands)
+			{
+				if (command.type == PhysicsCommandType::MoveCamera)
+					camera.SetPose(toGlm(command.position), toGlm(command.direction));
+			}
 		}
 
 		// Rendering logic
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// TODO: Be able to handle different shaders based on what is read from the scene
-		lightShader.use();
-
-		// Activate our shader program
-		lightShader.setVec3("viewPos", camera.Position);
-		lightShader.setFloat("material.shininess", 64.0f);
-		lightShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-		lightShader.setVec3("dirLight.ambient", 0.2f, 0.2f, 0.2f);
-		lightShader.setVec3("dirLight.diffuse", 0.5f, 0.5f, 0.5f);
-		lightShader.setVec3("dirLight.specular", 1.0f, 1.0f, 1.0f);
-
-		// camera/view transformation
-		glm::mat4 view = camera.GetViewMatrix();
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 800.0f);
-		lightShader.setMat4("view", view);
-		lightShader.setMat4("projection", projection);
-		for (unsigned int i = 0; i < NUM_RENDER_OBJECTS; i++)
+		// camera/view transformation, shared by every program through the FrameData block
+		frameData.view = camera.GetViewMatrix();
+		frameData.projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 800.0f);
+		frameData.viewPos = camera.Position;
+		frameBuffer.update(&frameData);
+
 		{
-			renders.transforms[i].getOpenGLMatrix(modelMatrix);
-			glm::mat4 model = glm::make_mat4(modelMatrix);
-			//model = glm::translate(model, trans.getPosition()); // add the translation from our source of truth translation to the model matrix
-			//model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));	// it's a bit too big for our scene, so scale it down
-			lightShader.setMat4("model", model);
-			renders.models[i].Draw(lightShader);
+			PROFILE_SCOPE("culling");
+			// the transforms published by wait() are the ones drawn this frame
+			culler.update(entities);
+			glm::mat4 viewProjection = frameData.projection * frameData.view;
+			occlusion.begin(viewProjection);
+			occlusion.rasterizeOccluders(entities);
+			culler.cull(Frustum::fromMatrix(viewProjection), &occlusion);
+		}
+
+		{
+			PROFILE_SCOPE("scene draw");
+			GPU_PROFILE_SCOPE("gpu scene draw");
+			// TODO: Be able to handle different shaders based on what is read from the scene
+			lightShader.use();
+			// one instanced draw per mesh and level of detail for all entries sharing a model, sorted by state
+			LodView lodView;
+			lodView.position = camera.Position;
+			lodView.pixelsPerUnit = SCR_HEIGHT / (2.0f * tan(glm::radians(camera.Zoom) * 0.5f));
+			instancedRenderer.submit(entities, lightShader, renderQueue, &culler, &lodView);
+			renderQueue.execute();
 		}
 
 		// draw skybox last
-		glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-		skyboxShader.use();
-		auto skyView = glm::mat4(glm::mat3(camera.GetViewMatrix())); // remove translation from the view matrix
-		skyboxShader.setMat4("projection", projection);
-		skyboxShader.setMat4("view", skyView);
-		// skybox cube
-		glBindVertexArray(skybox.VAO);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.cubemapTexture);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		glBindVertexArray(0);
-		glDepthFunc(GL_LESS); // set depth function back to default
+		{
+			PROFILE_SCOPE("skybox");
+			GPU_PROFILE_SCOPE("gpu skybox");
+			glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+			skyboxShader.use();
+			// skybox cube
+			glBindVertexArray(skybox.VAO);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.cubemapTexture);
+			glDrawArrays(GL_TRIANGLES, 0, 36);
+			glBindVertexArray(0);
+			glDepthFunc(GL_LESS); // set depth function back to default
+		}
 
 		if (USE_PHY_DEBUG_RENDERING)
 		{
+			PROFILE_SCOPE("debug draw");
+			GPU_PROFILE_SCOPE("gpu debug draw");
 			lampShader.use();
-			lampShader.setMat4("projection", projection);
-			lampShader.setMat4("view", view);
 			lampShader.setMat4("model", glm::mat4(1.0f));
 			phyDebugRenderer.draw();
 		}
 
-		glfwSwapBuffers(window);
+		{
+			PROFILE_SCOPE("swap");
+			glfwSwapBuffers(window);
+		}
 		glfwPollEvents();
 	}
 
 	// Clean up physics memory
-	for (unsigned int i = 0; i < NUM_PHY_OBJECTS; i++)
+	physicsPipeline.stop();
+	recorder.close();
+	for (unsigned int i = 0; i < entities.bodies.size(); i++)
 	{
-		world->destroyRigidBody(physics.bodies[i]);
+		world->destroyRigidBody(entities.bodies.at(i).body);
 	}
+	entities.clear();
 	common.destroyPhysicsWorld(world);
 
+	profiler.writeChromeTrace(TRACE_PATH);
+	gpuProfiler.release();
+	textureLoader.release();
 	glfwTerminate();
 	return 0;
 }
@@ -418,83 +442,83 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 	camera.ProcessMouseScroll(yoffset);
 }
 
-void performPunch()
+void bindKeys()
 {
-	// 1. Send raycast forward
-	float magnitude = 1000.0f;
-	float reach = 75.0f;
-	Vector3 direction = toPhysVec(camera.Front);
-
-	// Create the ray 
-	Vector3 startPoint = toPhysVec(camera.Position);
-	Vector3 endPoint = startPoint + (reach * direction);
-	Ray ray(startPoint, endPoint);
-
-	// Create the raycast info object for the 
-	// raycast result 
-	RaycastInfo raycastInfo;
-
-	// Test raycasting against a collider 
-	bool isHit = ballBody->raycast(ray, raycastInfo);
-	if (isHit)
-	{
-		float force = (1 - raycastInfo.hitFraction) * magnitude;
-		ballBody->applyForceToCenterOfMass(force * direction);
-		//ballBody->applyForceAtWorldPosition(force * direction, raycastInfo.worldPoint);
-		if (!ballUsesGravity)
-		{
-			ballBody->enableGravity(true);
-		}
-	}
+	input.bind(GLFW_KEY_ESCAPE, InputAction::Quit);
+	input.bind(GLFW_KEY_W, InputAction::MoveForward);
+	input.bind(GLFW_KEY_S, InputAction::MoveBackward);
+	input.bind(GLFW_KEY_A, InputAction::MoveLeft);
+	input.bind(GLFW_KEY_D, InputAction::MoveRight);
+	input.bind(GLFW_KEY_F1, InputAction::ToggleDebugRendering);
+	input.bind(GLFW_KEY_E, InputAction::Punch);
+	input.bind(GLFW_KEY_SPACE, InputAction::Jump);
 }
 
-void performJump()
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
-	auto force = 1000.0f * camera.WorldUp;
-	cameraBody->applyForceToCenterOfMass(toPhysVec(force));
+	input.onKey(key, action, glfwGetTime());
 }
 
 void processInput(GLFWwindow* window)
 {
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-		glfwSetWindowShouldClose(window, true);
+	// presses since last frame, each one acts once however long the key is held
+	input.drain([&](const InputEvent& event)
+	{
+		if (!event.pressed)
+			return;
+		switch (event.action)
+		{
+		case InputAction::Quit:
+			glfwSetWindowShouldClose(window, true);
+			break;
+		case InputAction::ToggleDebugRendering:
+			USE_PHY_DEBUG_RENDERING = !USE_PHY_DEBUG_RENDERING;
+			break;
+		// the bodies belong to the physics thread, so punches and jumps are handed over as commands
+		case InputAction::Punch:
+			physicsPipeline.push({ PhysicsCommandType::Punch, toPhysVec(camera.Position), toPhysVec(camera.Front) });
+			break;
+		case InputAction::Jump:
+			physicsPipeline.push({ PhysicsCommandType::Jump, Vector3::zero(), toPhysVec(camera.WorldUp) });
+			break;
+		default:
+			break;
+		}
+	});
 
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+	if (input.isHeld(InputAction::MoveForward))
 		camera.ProcessKeyboard(FORWARD, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+	if (input.isHeld(InputAction::MoveBackward))
 		camera.ProcessKeyboard(BACKWARD, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+	if (input.isHeld(InputAction::MoveLeft))
 		camera.ProcessKeyboard(LEFT, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+	if (input.isHeld(InputAction::MoveRight))
 		camera.ProcessKeyboard(RIGHT, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS)
-		USE_PHY_DEBUG_RENDERING = !USE_PHY_DEBUG_RENDERING;
-	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-		performPunch();
-	if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
-		performJump();
 }
 
-void setupPointLights(Shader* shader)
+void setupLights(LightsData* lights)
 {
-	glm::vec3 pointLightPositions[] = {
+	lights->dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+	lights->dirLight.ambient = glm::vec3(0.2f, 0.2f, 0.2f);
+	lights->dirLight.diffuse = glm::vec3(0.5f, 0.5f, 0.5f);
+	lights->dirLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+
+	glm::vec3 pointLightPositions[NR_POINT_LIGHTS] = {
 		glm::vec3(0.7f, 35.2f, 2.0f),
 		glm::vec3(2.3f, 32.3f, -4.0f),
 		glm::vec3(-4.0f, 36.0f, -12.0f),
 		glm::vec3(0.0f, 40.0f, -3.0f)
 	};
 
-	shader->use();
-	for (unsigned int i = 0; i < 4; i++)
+	for (unsigned int i = 0; i < NR_POINT_LIGHTS; i++)
 	{
-		auto s = std::to_string(i);
-		shader->setVec3("pointLights[" + s + "].position", pointLightPositions[i]);
-		shader->setFloat("pointLights[" + s + "].constant", 1.0f);
-		shader->setFloat("pointLights[" + s + "].linear", 0.09f);
-		shader->setFloat("pointLights[" + s + "].quadratic", 0.032f);
-		shader->setVec3("pointLights[" + s + "].ambient", 0.05f, 0.05f, 0.05f);
-		shader->setVec3("pointLights[" + s + "].diffuse", 0.8f, 0.8f, 0.8f);
-		shader->setVec3("pointLights[" + s + "].specular", 1.0f, 1.0f, 1.0f);
+		lights->pointLights[i].position = pointLightPositions[i];
+		lights->pointLights[i].constant = 1.0f;
+		lights->pointLights[i].linear = 0.09f;
+		lights->pointLights[i].quadratic = 0.032f;
+		lights->pointLights[i].ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+		lights->pointLights[i].diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+		lights->pointLights[i].specular = glm::vec3(1.0f, 1.0f, 1.0f);
 	}
 }
 
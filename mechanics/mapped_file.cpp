@@ -0,0 +1,97 @@
+#include "mapped_file.h"
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const string& path)
+{
+	close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	fileHandle = file;
+	mappingHandle = mapping;
+	bytes = static_cast<const unsigned char*>(view);
+	length = (size_t)fileSize.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps its own reference to the file
+	::close(fd);
+	if (view == MAP_FAILED)
+		return false;
+	bytes = static_cast<const unsigned char*>(view);
+	length = (size_t)info.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (bytes == nullptr)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(bytes);
+	CloseHandle((HANDLE)mappingHandle);
+	CloseHandle((HANDLE)fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	munmap((void*)bytes, length);
+#endif
+	bytes = nullptr;
+	length = 0;
+}
+
+bool isBakedFileCurrent(const string& bakedPath, const string& sourcePath)
+{
+	std::error_code ec;
+	auto bakedTime = std::filesystem::last_write_time(bakedPath, ec);
+	if (ec)
+		return false;
+	auto sourceTime = std::filesystem::last_write_time(sourcePath, ec);
+	// a baked file shipped without its source is always current
+	return ec || bakedTime >= sourceTime;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+using namespace std;
+
+// Read only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	bool open(const string& path);
+	void close();
+
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const unsigned char* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
+
+// True when the baked file exists and is at least as new as the source it was baked from
+bool isBakedFileCurrent(const string& bakedPath, const string& sourcePath);
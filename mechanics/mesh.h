@@ -1,10 +1,14 @@
 #ifndef MESH_H
 #define MESH_H
 
-#include <glm\glm.hpp>
+#include <glm/glm.hpp>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <cstdint>
 #include "shader.h"
+#include "bounds.h"
+#include "gl_state.h"
 using namespace std;
 
 struct Vertex
@@ -14,6 +18,54 @@ struct Vertex
 	glm::vec2 TexCoords;
 };
 
+// How a mesh's vertices are laid out in its vertex buffer
+enum class VertexFormat : uint32_t
+{
+	// Vertex, full floats
+	Float = 0,
+	// QuantizedVertex, half the size
+	Quantized = 1
+};
+
+// Compact vertex for meshes baked with quantization. The shader turns it back into a Vertex:
+// positions are unorm fractions of the mesh bounds, normals octahedral snorm, uvs half floats.
+struct QuantizedVertex
+{
+	uint16_t position[4];
+	int16_t normal[2];
+	uint16_t texCoords[2];
+};
+
+static_assert(sizeof(QuantizedVertex) == 16, "QuantizedVertex must stay 16 bytes");
+
+inline unsigned int vertexSize(VertexFormat format)
+{
+	return format == VertexFormat::Quantized ? sizeof(QuantizedVertex) : sizeof(Vertex);
+}
+
+// What a Mesh is uploaded from, pointing at memory it doesn't own, e.g. a mapped baked model
+struct MeshBuffers
+{
+	VertexFormat format = VertexFormat::Float;
+	const void* vertices = nullptr;
+	unsigned int vertexCount = 0;
+	// unsigned, 2 or 4 bytes each
+	const void* indices = nullptr;
+	unsigned int indexSize = 4;
+	unsigned int indexCount = 0;
+	// quantized positions are relative to it. Computed from float vertices when left invalid.
+	Aabb bounds;
+};
+
+// One level of detail, a range of the mesh's index buffer. Every level draws from the same vertices.
+struct MeshLod
+{
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	// how far the level strays from the full mesh, in model units
+	float error;
+};
+
 struct Texture
 {
 	unsigned int id;
@@ -24,26 +76,159 @@ struct Texture
 class Mesh
 {
 public:
-	// mesh data
-	vector<Vertex> vertices;
-	vector<unsigned int> indices;
+	// mesh data, vertices and indices only live on the GPU once uploaded
+	unsigned int vertexCount = 0;
+	// every level of detail together
+	unsigned int indexCount = 0;
+	VertexFormat format = VertexFormat::Float;
+	// GL_UNSIGNED_SHORT when the vertices fit, halving the index buffer
+	GLenum indexType = GL_UNSIGNED_INT;
 	vector<Texture> textures;
+	// model space bounds of the vertices, for culling
+	Aabb bounds;
+	// the full mesh first, then coarser levels with growing error
+	vector<MeshLod> lods;
+
+	Mesh(const vector<Vertex>& vertices, const vector<unsigned int>& indices, vector<Texture> textures, vector<MeshLod> lods = {})
+		: Mesh(floatBuffers(vertices, indices), std::move(textures), std::move(lods))
+	{
+	}
+
+	// uploads straight from the given memory without an intermediate copy.
+	// Without lods the whole index buffer is the one level.
+	Mesh(const MeshBuffers& buffers, vector<Texture> textures, vector<MeshLod> lods = {})
+		: vertexCount(buffers.vertexCount), indexCount(buffers.indexCount), format(buffers.format),
+		indexType(buffers.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT), textures(std::move(textures)),
+		bounds(buffers.bounds), lods(std::move(lods))
+	{
+		if (this->lods.empty())
+			this->lods.push_back({ 0, indexCount, 0.0f });
+		if (!bounds.valid() && format == VertexFormat::Float)
+		{
+			const Vertex* vertices = static_cast<const Vertex*>(buffers.vertices);
+			for (unsigned int i = 0; i < vertexCount; i++)
+				bounds.add(vertices[i].Position);
+		}
+		setupSamplerNames();
+		setupMesh(buffers);
+	}
+	// attaches a buffer of per-instance model matrices to attribute locations 3-6, starting at
+	// firstInstance since GL 3.3 has no base instance for the draw calls
+	void setInstanceBuffer(unsigned int instanceVBO, unsigned int firstInstance = 0)
+	{
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+		pointInstanceAttributes(instanceVBO, firstInstance);
+		glBindVertexArray(0);
+	}
+
+	// Drawing goes through the render queue with the state cache. bindInstances binds the VAO and
+	// leaves it bound, drawInstances expects it bound.
+	unsigned int vertexArray() const { return VAO; }
+
+	void bindMaterial(Shader& shader, GlStateCache& state)
+	{
+		resolveHandles(shader);
+		for (unsigned int i = 0; i < textures.size(); i++)
+		{
+			state.setInt(samplerHandles[i], i);
+			state.bindTexture(i, textures[i].id);
+		}
+		// float meshes go through the same decode with an identity transform
+		bool quantized = format == VertexFormat::Quantized;
+		state.setVec3(positionOffsetHandle, quantized ? bounds.min : glm::vec3(0.0f));
+		state.setVec3(positionScaleHandle, quantized ? bounds.max - bounds.min : glm::vec3(1.0f));
+		state.setInt(octNormalsHandle, quantized);
+	}
 
-	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+	// the attribute pointers are part of the VAO, so they're only respecified when the range moves
+	void bindInstances(unsigned int instanceVBO, unsigned int firstInstance, GlStateCache& state)
 	{
-		this->vertices = vertices;
-		this->indices = indices;
-		this->textures = textures;
+		state.bindVertexArray(VAO);
+		if (instanceVBO == instanceBuffer && firstInstance == instanceOffset)
+		{
+			state.stats.skipped++;
+			return;
+		}
+		state.bindArrayBuffer(instanceVBO);
+		pointInstanceAttributes(instanceVBO, firstInstance);
+	}
+
+	void drawInstances(unsigned int instanceCount, unsigned int lod = 0)
+	{
+		const MeshLod& level = lods[std::min(lod, (unsigned int)lods.size() - 1)];
+		glDrawElementsInstanced(GL_TRIANGLES, level.indexCount, indexType,
+			(void*)(level.firstIndex * (size_t)indexSize()), instanceCount);
+	}
+
+	// frees the GL buffers, the mesh can't be drawn afterwards
+	void release()
+	{
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+	}
+
+private:
+	//  render data
+	unsigned int VAO, VBO, EBO;
+	// "material.texture_diffuseN" style sampler name for each texture, and their locations in handleShader
+	vector<string> samplerNames;
+	vector<UniformHandle> samplerHandles;
+	// the uniforms a quantized mesh is decoded with
+	UniformHandle positionOffsetHandle, positionScaleHandle, octNormalsHandle;
+	unsigned int handleShader = 0;
+	// what the instance attributes of the VAO point at
+	unsigned int instanceBuffer = 0;
+	unsigned int instanceOffset = 0;
+
+	unsigned int indexSize() const { return indexType == GL_UNSIGNED_SHORT ? 2 : 4; }
+
+	static MeshBuffers floatBuffers(const vector<Vertex>& vertices, const vector<unsigned int>& indices)
+	{
+		MeshBuffers buffers;
+		buffers.vertices = vertices.data();
+		buffers.vertexCount = (unsigned int)vertices.size();
+		buffers.indices = indices.data();
+		buffers.indexCount = (unsigned int)indices.size();
+		return buffers;
+	}
 
-		setupMesh();
+	// uniform locations only need resolving again when drawn with a different program
+	void resolveHandles(Shader& shader)
+	{
+		if (handleShader == shader.ID)
+			return;
+		samplerHandles.clear();
+		for (unsigned int i = 0; i < samplerNames.size(); i++)
+			samplerHandles.push_back(shader.uniform(samplerNames[i]));
+		positionOffsetHandle = shader.uniform("positionOffset");
+		positionScaleHandle = shader.uniform("positionScale");
+		octNormalsHandle = shader.uniform("octNormals");
+		handleShader = shader.ID;
 	}
-	void Draw(Shader& shader)
+
+	// the VAO and the buffer have to be bound
+	void pointInstanceAttributes(unsigned int instanceVBO, unsigned int firstInstance)
+	{
+		// a mat4 attribute takes up one location per column
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			glEnableVertexAttribArray(3 + i);
+			glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+				(void*)(firstInstance * sizeof(glm::mat4) + i * sizeof(glm::vec4)));
+			glVertexAttribDivisor(3 + i, 1);
+		}
+		instanceBuffer = instanceVBO;
+		instanceOffset = firstInstance;
+	}
+
+	void setupSamplerNames()
 	{
 		unsigned int diffuseNr = 1;
 		unsigned int specularNr = 1;
 		for (unsigned int i = 0; i < textures.size(); i++)
 		{
-			glActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
 			// retrieve texture number (the N in diffuse_textureN)
 			string number;
 			string name = textures[i].type;
@@ -52,22 +237,11 @@ public:
 			else if (name == "texture_specular")
 				number = to_string(specularNr++);
 
-			shader.setInt(("material." + name + number).c_str(), i);
-			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+			samplerNames.push_back("material." + name + number);
 		}
-		glActiveTexture(GL_TEXTURE0);
-
-		// draw mesh
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
 	}
 
-private:
-	//  render data
-	unsigned int VAO, VBO, EBO;
-
-	void setupMesh()
+	void setupMesh(const MeshBuffers& buffers)
 	{
 		glGenVertexArrays(1, &VAO);
 		glGenBuffers(1, &VBO);
@@ -76,24 +250,42 @@ private:
 		glBindVertexArray(VAO);
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+		bool quantized = format == VertexFormat::Quantized;
+		GLsizei stride = vertexSize(format);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCount * stride, buffers.vertices, GL_STATIC_DRAW);
 
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
-			&indices[0], GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexCount * indexSize(),
+			buffers.indices, GL_STATIC_DRAW);
+
+		if (quantized)
+		{
+			// unorm positions, snorm octahedral normals and half float uvs
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(QuantizedVertex, position));
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(QuantizedVertex, normal));
+			if (!this->textures.empty())
+			{
+				glEnableVertexAttribArray(2);
+				glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(QuantizedVertex, texCoords));
+			}
+			glBindVertexArray(0);
+			return;
+		}
 
 		// vertex positions
 		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
 		// vertex normals
 		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Normal));
 
 		if (!this->textures.empty())
 		{
 			// vertex texture coords
 			glEnableVertexAttribArray(2);
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, TexCoords));
 		}
 
 		glBindVertexArray(0);
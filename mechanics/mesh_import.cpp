@@ -0,0 +1,166 @@
+#include "mesh_import.h"
+#include "mesh_optimize.h"
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <iostream>
+
+static void processNode(aiNode* node, const aiScene* scene, vector<MeshData>& meshes);
+static MeshData processMesh(aiMesh* mesh, const aiScene* scene);
+static void appendMaterialTextures(aiMaterial* mat, aiTextureType type, const string& typeName, vector<MaterialTexture>& textures);
+
+bool importModel(const string& path, vector<MeshData>& meshes, const ImportSettings& settings)
+{
+	// read file via ASSIMP
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+	// check for errors
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+	{
+		cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+		return false;
+	}
+
+	// process ASSIMP's root node recursively
+	size_t firstMesh = meshes.size();
+	processNode(scene->mRootNode, scene, meshes);
+	for (size_t i = firstMesh; i < meshes.size(); i++)
+		prepareMesh(meshes[i], settings);
+	return true;
+}
+
+void prepareMesh(MeshData& mesh, const ImportSettings& settings)
+{
+	weldVertices(mesh.vertices, mesh.indices);
+	generateLods(mesh.vertices, mesh.indices, mesh.lods, settings.lods);
+	if (settings.optimize)
+		optimizeMesh(mesh);
+	for (const auto& vertex : mesh.vertices)
+		mesh.bounds.add(vertex.Position);
+	if (settings.quantize)
+		quantizeMesh(mesh);
+}
+
+MeshBuffers meshBuffers(const MeshData& mesh, vector<uint16_t>& shortIndices)
+{
+	MeshBuffers buffers;
+	buffers.bounds = mesh.bounds;
+	if (mesh.quantized.empty())
+	{
+		buffers.format = VertexFormat::Float;
+		buffers.vertices = mesh.vertices.data();
+		buffers.vertexCount = (unsigned int)mesh.vertices.size();
+	}
+	else
+	{
+		buffers.format = VertexFormat::Quantized;
+		buffers.vertices = mesh.quantized.data();
+		buffers.vertexCount = (unsigned int)mesh.quantized.size();
+	}
+	buffers.indexCount = (unsigned int)mesh.indices.size();
+	if (fitsShortIndices(buffers.vertexCount))
+	{
+		shortIndices.resize(mesh.indices.size());
+		for (size_t i = 0; i < mesh.indices.size(); i++)
+			shortIndices[i] = (uint16_t)mesh.indices[i];
+		buffers.indices = shortIndices.data();
+		buffers.indexSize = 2;
+	}
+	else
+	{
+		buffers.indices = mesh.indices.data();
+		buffers.indexSize = 4;
+	}
+	return buffers;
+}
+
+// processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
+static void processNode(aiNode* node, const aiScene* scene, vector<MeshData>& meshes)
+{
+	// process each mesh located at the current node
+	for (unsigned int i = 0; i < node->mNumMeshes; i++)
+	{
+		// the node object only contains indices to index the actual objects in the scene.
+		// the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
+		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+		meshes.push_back(processMesh(mesh, scene));
+	}
+	// after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+	for (unsigned int i = 0; i < node->mNumChildren; i++)
+	{
+		processNode(node->mChildren[i], scene, meshes);
+	}
+}
+
+static MeshData processMesh(aiMesh* mesh, const aiScene* scene)
+{
+	MeshData data;
+
+	// walk through each of the mesh's vertices, written in place rather than pushed one at a time
+	data.vertices.resize(mesh->mNumVertices);
+	bool hasNormals = mesh->HasNormals();
+	const aiVector3D* texCoords = mesh->mTextureCoords[0];
+	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+	{
+		Vertex& vertex = data.vertices[i];
+		// positions
+		vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+		// normals
+		if (hasNormals)
+			vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+		else
+			vertex.Normal = glm::vec3(0.0f, 0.0f, 0.0f);
+		// texture coordinates
+		// a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
+		// use models where a vertex can have multiple texture coordinates so we always take the first set (0).
+		if (texCoords) // does the mesh contain texture coordinates?
+			vertex.TexCoords = glm::vec2(texCoords[i].x, texCoords[i].y);
+		else
+			vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+	}
+
+	// now walk through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+	// faces are triangles after aiProcess_Triangulate, so three indices per face is only a reservation hint
+	data.indices.reserve(mesh->mNumFaces * 3);
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+	{
+		const aiFace& face = mesh->mFaces[i];
+		// retrieve all indices of the face and store them in the indices vector
+		data.indices.insert(data.indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
+	}
+
+	if (!mesh->mMaterialIndex)
+	{
+		return data;
+	}
+
+	// process materials
+	aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+	// we assume a convention for sampler names in the shaders. Each diffuse texture should be named
+	// as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
+	// Same applies to other texture as the following list summarizes:
+	// diffuse: texture_diffuseN
+	// specular: texture_specularN
+	// normal: texture_normalN
+
+	// 1. diffuse maps
+	appendMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data.textures);
+	// 2. specular maps
+	appendMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data.textures);
+	// 3. normal maps
+	appendMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", data.textures);
+	// 4. height maps
+	appendMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", data.textures);
+
+	return data;
+}
+
+static void appendMaterialTextures(aiMaterial* mat, aiTextureType type, const string& typeName, vector<MaterialTexture>& textures)
+{
+	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+	{
+		aiString str;
+		mat->GetTexture(type, i, &str);
+		textures.push_back({ typeName, str.C_Str() });
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "mesh.h"
+#include "mesh_simplify.h"
+
+using namespace std;
+
+// A texture as referenced by the source material, before it is loaded
+struct MaterialTexture
+{
+	string type;
+	string path;
+};
+
+// CPU side data of one mesh as imported from a model file, ready to be uploaded or baked
+struct MeshData
+{
+	vector<Vertex> vertices;
+	// the full mesh followed by its simplified levels
+	vector<unsigned int> indices;
+	vector<MeshLod> lods;
+	vector<MaterialTexture> textures;
+	// bounds of the vertices
+	Aabb bounds;
+	// when quantized, these are uploaded and baked instead of the float vertices
+	vector<QuantizedVertex> quantized;
+};
+
+struct ImportSettings
+{
+	LodSettings lods;
+	// reorder triangles for the vertex cache and vertices for fetch locality
+	bool optimize = true;
+	// 16 byte QuantizedVertex instead of the 32 byte Vertex
+	bool quantize = false;
+};
+
+// Imports every mesh of the model file with Assimp and generates its levels of detail. Needs no GL context.
+// Returns false if the file couldn't be read.
+bool importModel(const string& path, vector<MeshData>& meshes, const ImportSettings& settings = ImportSettings());
+
+// What importModel does to every mesh it reads: welds the per corner vertices, generates the levels
+// of detail, optimizes and quantizes as the settings ask, and fills in the bounds
+void prepareMesh(MeshData& mesh, const ImportSettings& settings = ImportSettings());
+
+// What the imported mesh uploads from. Indices are narrowed into shortIndices when every vertex
+// can be addressed with 16 bits, so shortIndices has to outlive the result.
+MeshBuffers meshBuffers(const MeshData& mesh, vector<uint16_t>& shortIndices);
@@ -0,0 +1,255 @@
+#include "mesh_optimize.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <glm/gtc/packing.hpp>
+
+// the cache the scores model, bigger than any real one so the order suits every GPU
+static const unsigned int CACHE_SIZE = 32;
+
+static float vertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+	if (remainingTriangles == 0)
+		return -1.0f;
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// the previous triangle's vertices score a fixed amount so the next triangle doesn't
+		// always strip along the last edge
+		if (cachePosition < 3)
+			score = 0.75f;
+		else
+			score = std::pow(1.0f - (cachePosition - 3) / (float)(CACHE_SIZE - 3), 1.5f);
+	}
+	// vertices with few triangles left are finished first, so they can leave the cache for good
+	score += 2.0f / std::sqrt((float)remainingTriangles);
+	return score;
+}
+
+void weldVertices(vector<Vertex>& vertices, vector<unsigned int>& indices)
+{
+	// compared bit for bit, the importer copies the same floats into every corner
+	struct VertexHash
+	{
+		size_t operator()(const Vertex& v) const
+		{
+			uint32_t bits[sizeof(Vertex) / 4];
+			memcpy(bits, &v, sizeof(bits));
+			size_t hash = 0;
+			for (uint32_t b : bits)
+				hash = hash * 31 + b * 2654435761u;
+			return hash;
+		}
+	};
+	struct VertexEqual
+	{
+		bool operator()(const Vertex& a, const Vertex& b) const
+		{
+			return memcmp(&a, &b, sizeof(Vertex)) == 0;
+		}
+	};
+	unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> kept;
+	kept.reserve(vertices.size());
+	vector<unsigned int> remap(vertices.size());
+	vector<Vertex> welded;
+	for (unsigned int i = 0; i < vertices.size(); i++)
+	{
+		auto inserted = kept.emplace(vertices[i], (unsigned int)welded.size());
+		if (inserted.second)
+			welded.push_back(vertices[i]);
+		remap[i] = inserted.first->second;
+	}
+	for (unsigned int& index : indices)
+		index = remap[index];
+	vertices.swap(welded);
+}
+
+void optimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount)
+{
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// the live triangles of every vertex are the first remaining[v] entries of its range
+	vector<unsigned int> remaining(vertexCount, 0);
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+		remaining[indices[i]]++;
+	vector<unsigned int> start(vertexCount + 1, 0);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		start[v + 1] = start[v] + remaining[v];
+	vector<unsigned int> vertexTriangles(triangleCount * 3);
+	vector<unsigned int> fill(start.begin(), start.end() - 1);
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		for (int c = 0; c < 3; c++)
+			vertexTriangles[fill[indices[t * 3 + c]]++] = t;
+	}
+
+	vector<int> cachePosition(vertexCount, -1);
+	vector<float> scores(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		scores[v] = vertexScore(-1, remaining[v]);
+	vector<float> triangleScores(triangleCount);
+	vector<char> emitted(triangleCount, 0);
+	int best = 0;
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		triangleScores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+		if (triangleScores[t] > triangleScores[best])
+			best = t;
+	}
+
+	vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	vector<unsigned int> cache, newCache;
+	cache.reserve(CACHE_SIZE + 3);
+	newCache.reserve(CACHE_SIZE + 3);
+	unsigned int scan = 0;
+	while (best >= 0)
+	{
+		const unsigned int* corners = &indices[best * 3];
+		output.insert(output.end(), corners, corners + 3);
+		emitted[best] = 1;
+
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = corners[c];
+			unsigned int* live = &vertexTriangles[start[v]];
+			unsigned int* end = live + remaining[v];
+			std::iter_swap(std::find(live, end, (unsigned int)best), end - 1);
+			remaining[v]--;
+		}
+
+		// the triangle's vertices move to the front, the rest shift back and the oldest fall out
+		newCache.assign(corners, corners + 3);
+		for (unsigned int v : cache)
+		{
+			if (v != corners[0] && v != corners[1] && v != corners[2])
+				newCache.push_back(v);
+		}
+		for (unsigned int i = 0; i < newCache.size(); i++)
+		{
+			unsigned int v = newCache[i];
+			cachePosition[v] = i < CACHE_SIZE ? (int)i : -1;
+			float score = vertexScore(cachePosition[v], remaining[v]);
+			float delta = score - scores[v];
+			scores[v] = score;
+			for (unsigned int j = start[v]; j < start[v] + remaining[v]; j++)
+				triangleScores[vertexTriangles[j]] += delta;
+		}
+		if (newCache.size() > CACHE_SIZE)
+			newCache.resize(CACHE_SIZE);
+		cache.swap(newCache);
+
+		// the next triangle is the best one touching the cache, failing that any one left
+		best = -1;
+		float bestScore = -1.0f;
+		for (unsigned int v : cache)
+		{
+			for (unsigned int j = start[v]; j < start[v] + remaining[v]; j++)
+			{
+				unsigned int t = vertexTriangles[j];
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					best = (int)t;
+				}
+			}
+		}
+		if (best < 0)
+		{
+			while (scan < triangleCount && emitted[scan])
+				scan++;
+			if (scan < triangleCount)
+				best = (int)scan;
+		}
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeVertexFetch(vector<Vertex>& vertices, vector<unsigned int>& indices)
+{
+	const unsigned int unused = ~0u;
+	vector<unsigned int> remap(vertices.size(), unused);
+	vector<Vertex> ordered;
+	ordered.reserve(vertices.size());
+	for (unsigned int& index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = (unsigned int)ordered.size();
+			ordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(ordered);
+}
+
+float averageCacheMissRatio(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize)
+{
+	if (indexCount < 3)
+		return 0.0f;
+	// a vertex is still cached while fewer than cacheSize misses happened since it was loaded
+	vector<unsigned int> loadedAt(vertexCount, 0);
+	unsigned int misses = 0;
+	unsigned int time = cacheSize + 1;
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		if (time - loadedAt[indices[i]] > cacheSize)
+		{
+			loadedAt[indices[i]] = time++;
+			misses++;
+		}
+	}
+	return (float)misses / (indexCount / 3);
+}
+
+void optimizeMesh(MeshData& mesh)
+{
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+	if (mesh.lods.empty())
+		optimizeVertexCache(mesh.indices.data(), (unsigned int)mesh.indices.size(), vertexCount);
+	for (const auto& lod : mesh.lods)
+		optimizeVertexCache(mesh.indices.data() + lod.firstIndex, lod.indexCount, vertexCount);
+	// the full mesh comes first in the index buffer, so it gets the best fetch order
+	optimizeVertexFetch(mesh.vertices, mesh.indices);
+}
+
+static glm::vec2 octEncode(const glm::vec3& normal)
+{
+	float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if (sum == 0.0f)
+		return glm::vec2(0.0f);
+	glm::vec3 n = normal / sum;
+	glm::vec2 encoded(n.x, n.y);
+	// the lower half folds over the diagonals
+	if (n.z < 0.0f)
+	{
+		encoded = (1.0f - glm::abs(glm::vec2(n.y, n.x)))
+			* glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return encoded;
+}
+
+void quantizeMesh(MeshData& mesh)
+{
+	glm::vec3 size = mesh.bounds.max - mesh.bounds.min;
+	glm::vec3 inverseSize(size.x > 0.0f ? 1.0f / size.x : 0.0f, size.y > 0.0f ? 1.0f / size.y : 0.0f, size.z > 0.0f ? 1.0f / size.z : 0.0f);
+	mesh.quantized.resize(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		const Vertex& vertex = mesh.vertices[i];
+		QuantizedVertex& quantized = mesh.quantized[i];
+		glm::vec3 unit = (vertex.Position - mesh.bounds.min) * inverseSize;
+		for (int c = 0; c < 3; c++)
+			quantized.position[c] = glm::packUnorm1x16(unit[c]);
+		quantized.position[3] = 0;
+		glm::vec2 normal = octEncode(vertex.Normal);
+		quantized.normal[0] = (int16_t)glm::packSnorm1x16(normal.x);
+		quantized.normal[1] = (int16_t)glm::packSnorm1x16(normal.y);
+		quantized.texCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+		quantized.texCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+	}
+}
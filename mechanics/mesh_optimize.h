@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include "mesh_import.h"
+
+using namespace std;
+
+// Merges vertices that are equal in position, normal and texture coordinates, and points the indices
+// at the one kept. Importers emit one vertex per face corner, so until this runs no two triangles
+// share a vertex and neither simplification nor the vertex cache has anything to work with.
+void weldVertices(vector<Vertex>& vertices, vector<unsigned int>& indices);
+
+// Reorders the triangles of indices[0, indexCount) so the ones sharing vertices are drawn close
+// together and the GPU's post-transform cache catches the shared vertices (Forsyth's linear speed
+// vertex cache optimisation)
+void optimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount);
+
+// Renumbers the vertices in the order the indices first use them and drops unused ones, so vertex
+// fetch walks the buffer front to back
+void optimizeVertexFetch(vector<Vertex>& vertices, vector<unsigned int>& indices);
+
+// Vertices transformed per triangle with a FIFO cache of cacheSize entries. 3 means nothing is
+// reused, a well ordered regular mesh gets close to 0.5.
+float averageCacheMissRatio(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize = 16);
+
+// Vertex cache order for every level of detail, then fetch order for the vertices all of them share
+void optimizeMesh(MeshData& mesh);
+
+// Fills mesh.quantized from the float vertices, positions relative to mesh.bounds
+void quantizeMesh(MeshData& mesh);
+
+// 16 bit indices can address every vertex
+inline bool fitsShortIndices(unsigned int vertexCount)
+{
+	return vertexCount <= 65536;
+}
@@ -0,0 +1,331 @@
+#include "mesh_simplify.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+// Sum of squared distances to a set of planes, area weighted, as the symmetric 4x4 matrix
+// [ A b ; b^T c ] so the error at p is p^T A p + 2 b.p + c
+struct Quadric
+{
+	double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+	double b0 = 0, b1 = 0, b2 = 0;
+	double c = 0;
+	double weight = 0;
+
+	static Quadric fromPlane(const glm::dvec3& normal, double distance, double weight)
+	{
+		Quadric q;
+		q.a00 = weight * normal.x * normal.x; q.a01 = weight * normal.x * normal.y; q.a02 = weight * normal.x * normal.z;
+		q.a11 = weight * normal.y * normal.y; q.a12 = weight * normal.y * normal.z;
+		q.a22 = weight * normal.z * normal.z;
+		q.b0 = weight * normal.x * distance; q.b1 = weight * normal.y * distance; q.b2 = weight * normal.z * distance;
+		q.c = weight * distance * distance;
+		q.weight = weight;
+		return q;
+	}
+
+	void add(const Quadric& other)
+	{
+		a00 += other.a00; a01 += other.a01; a02 += other.a02;
+		a11 += other.a11; a12 += other.a12; a22 += other.a22;
+		b0 += other.b0; b1 += other.b1; b2 += other.b2;
+		c += other.c;
+		weight += other.weight;
+	}
+
+	double evaluate(const glm::vec3& p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double result = a00 * x * x + a11 * y * y + a22 * z * z
+			+ 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+			+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+		return std::max(result, 0.0);
+	}
+};
+
+// root mean square distance of p to the planes merged into a and b
+static float collapseError(const Quadric& a, const Quadric& b, const glm::vec3& p)
+{
+	double weight = a.weight + b.weight;
+	if (weight <= 0.0)
+		return 0.0f;
+	return (float)std::sqrt((a.evaluate(p) + b.evaluate(p)) / weight);
+}
+
+static uint64_t edgeKey(unsigned int a, unsigned int b)
+{
+	if (a > b)
+		std::swap(a, b);
+	return ((uint64_t)a << 32) | b;
+}
+
+// The importer splits a corner into several vertices where normals or texture coordinates differ,
+// those vertices move together as a group. group[v] is the first vertex at v's position and the
+// group's vertices are members[memberStart[group], memberStart[group + 1]).
+struct PositionGroups
+{
+	vector<unsigned int> group;
+	vector<unsigned int> memberStart;
+	vector<unsigned int> members;
+	// groups that must keep their place: ones on an edge only one triangle uses, and texture seams,
+	// where the members' texture coordinates differ and moving would tear the texture
+	vector<char> locked;
+};
+
+static PositionGroups findPositionGroups(const vector<Vertex>& vertices, const vector<unsigned int>& indices)
+{
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& p) const
+		{
+			uint32_t bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			return bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u;
+		}
+	};
+	unsigned int vertexCount = (unsigned int)vertices.size();
+	PositionGroups groups;
+	groups.group.resize(vertexCount);
+	groups.memberStart.assign(vertexCount + 1, 0);
+	groups.locked.assign(vertexCount, 0);
+	unordered_map<glm::vec3, unsigned int, PositionHash> firstAtPosition;
+	firstAtPosition.reserve(vertexCount);
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		unsigned int group = firstAtPosition.emplace(vertices[i].Position, i).first->second;
+		groups.group[i] = group;
+		groups.memberStart[group + 1]++;
+		if (vertices[i].TexCoords != vertices[group].TexCoords)
+			groups.locked[group] = 1;
+	}
+	for (unsigned int v = 0; v < vertexCount; v++)
+		groups.memberStart[v + 1] += groups.memberStart[v];
+	groups.members.resize(vertexCount);
+	vector<unsigned int> fill(groups.memberStart.begin(), groups.memberStart.end() - 1);
+	for (unsigned int i = 0; i < vertexCount; i++)
+		groups.members[fill[groups.group[i]]++] = i;
+
+	unordered_map<uint64_t, unsigned int> edgeUses;
+	edgeUses.reserve(indices.size());
+	for (size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		for (int e = 0; e < 3; e++)
+			edgeUses[edgeKey(groups.group[indices[t + e]], groups.group[indices[t + (e + 1) % 3]])]++;
+	}
+	for (const auto& edge : edgeUses)
+	{
+		if (edge.second == 1)
+		{
+			groups.locked[(unsigned int)(edge.first >> 32)] = 1;
+			groups.locked[(unsigned int)(edge.first & 0xffffffffu)] = 1;
+		}
+	}
+	return groups;
+}
+
+// The vertex of group target that takes the place of vertex v: the closest texture coordinates,
+// then the closest normal, so flat shaded faces keep the normal nearest their own
+static unsigned int closestMember(const vector<Vertex>& vertices, const PositionGroups& groups, unsigned int target, unsigned int v)
+{
+	unsigned int best = target;
+	float bestDistance = FLT_MAX, bestDot = -FLT_MAX;
+	for (unsigned int i = groups.memberStart[target]; i < groups.memberStart[target + 1]; i++)
+	{
+		unsigned int member = groups.members[i];
+		glm::vec2 offset = vertices[member].TexCoords - vertices[v].TexCoords;
+		float distance = glm::dot(offset, offset);
+		float dot = glm::dot(vertices[member].Normal, vertices[v].Normal);
+		if (distance < bestDistance || (distance == bestDistance && dot > bestDot))
+		{
+			best = member;
+			bestDistance = distance;
+			bestDot = dot;
+		}
+	}
+	return best;
+}
+
+// true when moving group from onto group target turns any of its other triangles over
+static bool collapseFlips(const vector<Vertex>& vertices, const vector<unsigned int>& group, const vector<unsigned int>& indices,
+	const unsigned int* triangles, unsigned int triangleCount, unsigned int from, unsigned int target)
+{
+	const glm::vec3& newPosition = vertices[target].Position;
+	for (unsigned int i = 0; i < triangleCount; i++)
+	{
+		const unsigned int* corners = &indices[triangles[i] * 3];
+		if (group[corners[0]] == target || group[corners[1]] == target || group[corners[2]] == target)
+			continue; // collapses away
+		glm::vec3 before[3], after[3];
+		for (int c = 0; c < 3; c++)
+		{
+			before[c] = vertices[corners[c]].Position;
+			after[c] = group[corners[c]] == from ? newPosition : before[c];
+		}
+		glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+		glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+		// turned over, or close enough to edge on that it would shade badly
+		float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+		if (glm::dot(normalBefore, normalAfter) <= 0.25f * lengths)
+			return true;
+	}
+	return false;
+}
+
+float simplifyMesh(const vector<Vertex>& vertices, const vector<unsigned int>& indices,
+	unsigned int targetIndexCount, float maxError, vector<unsigned int>& result)
+{
+	result = indices;
+	unsigned int vertexCount = (unsigned int)vertices.size();
+	PositionGroups groups = findPositionGroups(vertices, indices);
+	const vector<unsigned int>& group = groups.group;
+
+	// quadrics, adjacency and collapses are all per group, indexed by its first vertex
+	vector<Quadric> quadrics(vertexCount);
+	for (size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		glm::dvec3 p0 = vertices[indices[t]].Position, p1 = vertices[indices[t + 1]].Position, p2 = vertices[indices[t + 2]].Position;
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		double length = glm::length(normal);
+		if (length <= 0.0)
+			continue;
+		normal /= length;
+		Quadric plane = Quadric::fromPlane(normal, -glm::dot(normal, p0), length * 0.5);
+		for (int c = 0; c < 3; c++)
+			quadrics[group[indices[t + c]]].add(plane);
+	}
+
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int target;
+		float error;
+	};
+	vector<Collapse> collapses;
+	vector<unsigned int> triangleStart(vertexCount + 1), groupTriangles;
+	vector<unsigned int> remap(vertexCount);
+	vector<char> touched(vertexCount);
+	float resultError = 0.0f;
+
+	// Every pass sorts the possible collapses by cost and makes the cheapest ones that don't share
+	// a triangle with another collapse of the same pass, then rebuilds the index buffer
+	while (result.size() > targetIndexCount)
+	{
+		unsigned int triangleCount = (unsigned int)result.size() / 3;
+
+		std::fill(triangleStart.begin(), triangleStart.end(), 0);
+		for (unsigned int index : result)
+			triangleStart[group[index] + 1]++;
+		for (unsigned int v = 0; v < vertexCount; v++)
+			triangleStart[v + 1] += triangleStart[v];
+		groupTriangles.resize(result.size());
+		vector<unsigned int> fill(triangleStart.begin(), triangleStart.end() - 1);
+		for (unsigned int t = 0; t < triangleCount; t++)
+		{
+			for (int c = 0; c < 3; c++)
+				groupTriangles[fill[group[result[t * 3 + c]]]++] = t;
+		}
+
+		collapses.clear();
+		for (unsigned int t = 0; t < triangleCount; t++)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int a = group[result[t * 3 + e]];
+				unsigned int b = group[result[t * 3 + (e + 1) % 3]];
+				// the cheaper direction of the edge, a locked group can only be the target
+				float errorAB = groups.locked[a] ? FLT_MAX : collapseError(quadrics[a], quadrics[b], vertices[b].Position);
+				float errorBA = groups.locked[b] ? FLT_MAX : collapseError(quadrics[b], quadrics[a], vertices[a].Position);
+				if (errorAB == FLT_MAX && errorBA == FLT_MAX)
+					continue;
+				if (errorAB <= errorBA)
+					collapses.push_back({ a, b, errorAB });
+				else
+					collapses.push_back({ b, a, errorBA });
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+		// a collapse takes about two triangles away, don't overshoot the target by much
+		unsigned int wanted = (triangleCount - targetIndexCount / 3) / 2 + 1;
+		unsigned int made = 0;
+		for (unsigned int v = 0; v < vertexCount; v++)
+			remap[v] = v;
+		std::fill(touched.begin(), touched.end(), 0);
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.error > maxError || made >= wanted)
+				break;
+			if (touched[collapse.from] || touched[collapse.target])
+				continue;
+			const unsigned int* triangles = &groupTriangles[triangleStart[collapse.from]];
+			unsigned int count = triangleStart[collapse.from + 1] - triangleStart[collapse.from];
+			if (collapseFlips(vertices, group, result, triangles, count, collapse.from, collapse.target))
+				continue;
+
+			for (unsigned int i = groups.memberStart[collapse.from]; i < groups.memberStart[collapse.from + 1]; i++)
+			{
+				unsigned int member = groups.members[i];
+				remap[member] = closestMember(vertices, groups, collapse.target, member);
+			}
+			quadrics[collapse.target].add(quadrics[collapse.from]);
+			resultError = std::max(resultError, collapse.error);
+			made++;
+			// the neighbourhood has changed, leave it alone for the rest of this pass
+			for (unsigned int i = 0; i < count; i++)
+			{
+				for (int c = 0; c < 3; c++)
+					touched[group[result[triangles[i] * 3 + c]]] = 1;
+			}
+		}
+		if (made == 0)
+			break;
+
+		// collapsed triangles have two corners at the same position now
+		size_t write = 0;
+		for (size_t t = 0; t < result.size(); t += 3)
+		{
+			unsigned int a = remap[result[t]], b = remap[result[t + 1]], c = remap[result[t + 2]];
+			if (group[a] == group[b] || group[b] == group[c] || group[c] == group[a])
+				continue;
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+	return resultError;
+}
+
+void generateLods(const vector<Vertex>& vertices, vector<unsigned int>& indices, vector<MeshLod>& lods,
+	const LodSettings& settings)
+{
+	lods.clear();
+	lods.push_back({ 0, (unsigned int)indices.size(), 0.0f });
+	if (settings.maxLods == 0 || indices.size() < (size_t)settings.minTriangles * 3)
+		return;
+
+	Aabb bounds;
+	for (const auto& vertex : vertices)
+		bounds.add(vertex.Position);
+	float maxError = settings.maxError * glm::length(bounds.max - bounds.min);
+
+	// every level starts from the full mesh so its error is measured against the original
+	vector<unsigned int> full = indices;
+	vector<unsigned int> simplified;
+	float target = (float)full.size() / 3;
+	for (unsigned int level = 1; level <= settings.maxLods; level++)
+	{
+		target *= settings.reduction;
+		if (target < settings.minTriangles)
+			break;
+		float error = simplifyMesh(vertices, full, (unsigned int)target * 3, maxError, simplified);
+		// out of error budget, this level wouldn't save enough to be worth it
+		MeshLod previous = lods.back();
+		if (simplified.size() > previous.indexCount * 0.8f)
+			break;
+		lods.push_back({ (unsigned int)indices.size(), (unsigned int)simplified.size(), std::max(error, previous.error) });
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include "mesh.h"
+
+using namespace std;
+
+// How much detail import takes away for the coarser levels of each mesh
+struct LodSettings
+{
+	// levels after the full mesh, 0 turns generation off
+	unsigned int maxLods = 3;
+	// each level aims for this fraction of the previous level's triangles
+	float reduction = 0.5f;
+	// the error budget: no collapse may move the surface further than this fraction of the mesh's
+	// bounding box diagonal, so a level can end up with more triangles than it aimed for
+	float maxError = 0.02f;
+	// meshes smaller than this aren't worth simplifying
+	unsigned int minTriangles = 64;
+};
+
+// Quadric error edge collapse. Vertices are merged into one of their neighbours until the index
+// buffer is down to targetIndexCount or every remaining collapse costs more than maxError, in model
+// units. The result indexes the same vertices, so all levels of a mesh share one vertex buffer.
+// Vertices at one position move together and each lands on the target vertex with the closest
+// attributes. Positions on open borders and on texture seams never move. Expects welded vertices,
+// see weldVertices. Returns the error of the result.
+float simplifyMesh(const vector<Vertex>& vertices, const vector<unsigned int>& indices,
+	unsigned int targetIndexCount, float maxError, vector<unsigned int>& result);
+
+// Appends the simplified levels of the mesh to its index buffer and describes every level, the full
+// mesh included, in lods
+void generateLods(const vector<Vertex>& vertices, vector<unsigned int>& indices, vector<MeshLod>& lods,
+	const LodSettings& settings = LodSettings());
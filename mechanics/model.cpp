@@ -0,0 +1,56 @@
+#include "model.h"
+#include "baked_texture.h"
+#include <filesystem>
+
+unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
+{
+	// Fully qualified file paths from the textures sometimes??
+	// TODO: Get to the bottom of this
+	string filename = string(path);
+
+	// pick the path before decoding so a miss doesn't cost a second decode attempt
+	std::error_code ec;
+	if (!std::filesystem::exists(filename, ec))
+	{
+		cout << "Model: No texture at default path: " << filename << ". Going to try and add directory." << endl;
+		filename = directory + '/' + filename;
+	}
+
+	// an up to date baked file already has its compressed mip chain
+	if (unsigned int baked = loadBakedTexture(filename))
+		return baked;
+
+	int width, height, nrComponents;
+	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+
+	unsigned int textureID;
+	glGenTextures(1, &textureID);
+	if (data)
+	{
+		GLenum format;
+		if (nrComponents == 1)
+			format = GL_RED;
+		else if (nrComponents == 3)
+			format = GL_RGB;
+		else if (nrComponents == 4)
+			format = GL_RGBA;
+
+		glBindTexture(GL_TEXTURE_2D, textureID);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		stbi_image_free(data);
+	}
+	else
+	{
+		std::cout << "Texture failed to load at path: " << filename << std::endl;
+		stbi_image_free(data);
+	}
+
+	return textureID;
+}
@@ -6,18 +6,19 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "stb_image.h"
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
 
 #include "mesh.h"
+#include "mesh_import.h"
+#include "baked_mesh.h"
 #include "shader.h"
+#include "texture_cache.h"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
 using namespace std;
 
@@ -29,9 +30,16 @@ public:
 	// model data 
 	vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
 	vector<Mesh>    meshes;
+	// bounds of every mesh together, invalid while the model has no vertices
+	Aabb bounds;
+	// the largest error of any mesh at each level of detail, in model units. Meshes with fewer
+	// levels draw their coarsest one for the levels they don't have.
+	vector<float> lodErrors;
 	string directory;
 	string model_path;
 	bool gammaCorrection;
+	// textures shared with other models through the cache, held so they stay alive while this model does
+	vector<shared_ptr<SharedTexture>> shared_textures;
 
 	// So we can use the empty version in struct init
 	Model()
@@ -39,162 +47,108 @@ public:
 	}
 
 	// constructor, expects a filepath to a 3D model.
-	Model(string const& path, bool gamma = false) : gammaCorrection(gamma)
+	// With a texture cache, textures are shared with every other model loaded through the same cache.
+	Model(string const& path, bool gamma = false, TextureCache* textureCache = nullptr) : gammaCorrection(gamma), textureCache(textureCache)
 	{
 		model_path = path;
 		loadModel(path);
+		for (const auto& mesh : meshes)
+		{
+			if (mesh.bounds.valid())
+				bounds = Aabb::merge(bounds, mesh.bounds);
+			if (mesh.lods.size() > lodErrors.size())
+				lodErrors.resize(mesh.lods.size(), 0.0f);
+		}
+		for (unsigned int level = 0; level < lodErrors.size(); level++)
+		{
+			for (const auto& mesh : meshes)
+				lodErrors[level] = std::max(lodErrors[level], mesh.lods[std::min(level, (unsigned int)mesh.lods.size() - 1)].error);
+		}
+	}
+
+	// every mesh reads its per-instance model matrices from instanceVBO, from firstInstance on
+	void setInstanceBuffer(unsigned int instanceVBO, unsigned int firstInstance = 0)
+	{
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			meshes[i].setInstanceBuffer(instanceVBO, firstInstance);
+	}
+
+	unsigned int triangleCount(unsigned int lod = 0) const
+	{
+		unsigned int count = 0;
+		for (const auto& mesh : meshes)
+			count += mesh.lods[std::min(lod, (unsigned int)mesh.lods.size() - 1)].indexCount / 3;
+		return count;
 	}
 
-	// draws the model, and thus all its meshes
-	void Draw(Shader& shader)
+	// frees the GL buffers of every mesh. Textures are freed with their last SharedTexture reference.
+	void release()
 	{
 		for (unsigned int i = 0; i < meshes.size(); i++)
-			meshes[i].Draw(shader);
+			meshes[i].release();
+		meshes.clear();
+		shared_textures.clear();
 	}
 
 private:
-	// loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+	TextureCache* textureCache = nullptr;
+
+	// loads a model from its baked file when there is an up to date one, otherwise imports it with
+	// ASSIMP, and stores the resulting meshes in the meshes vector.
 	void loadModel(string const& path)
 	{
-		// read file via ASSIMP
-		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-		// check for errors
-		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
-		{
-			cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-			return;
-		}
 		// retrieve the directory path of the filepath
 		directory = path.substr(0, path.find_last_of('/'));
 
-		// process ASSIMP's root node recursively
-		processNode(scene->mRootNode, scene);
-	}
-
-	// processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-	void processNode(aiNode* node, const aiScene* scene)
-	{
-		// process each mesh located at the current node
-		for (unsigned int i = 0; i < node->mNumMeshes; i++)
-		{
-			// the node object only contains indices to index the actual objects in the scene. 
-			// the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-			meshes.push_back(processMesh(mesh, scene));
-		}
-		// after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-		for (unsigned int i = 0; i < node->mNumChildren; i++)
-		{
-			processNode(node->mChildren[i], scene);
-		}
+		string bakedPath = bakedModelPath(path);
+		if (isBakedFileCurrent(bakedPath, path) && loadBaked(bakedPath))
+			return;
 
+		vector<MeshData> imported;
+		if (!importModel(path, imported))
+			return;
+		meshes.reserve(imported.size());
+		vector<uint16_t> shortIndices;
+		for (auto& data : imported)
+			meshes.emplace_back(meshBuffers(data, shortIndices), loadMaterialTextures(data.textures), data.lods);
 	}
 
-	Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+	// uploads every mesh straight out of the mapped file, the mapping is dropped once they are on the GPU
+	bool loadBaked(const string& bakedPath)
 	{
-		// data to fill
-		vector<Vertex> vertices;
-		vector<unsigned int> indices;
-		vector<Texture> textures;
-
-		// walk through each of the mesh's vertices
-		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+		MappedFile file;
+		BakedModelView view;
+		if (!file.open(bakedPath) || !view.parse(file.data(), file.size()))
 		{
-			Vertex vertex;
-			glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-			// positions
-			vector.x = mesh->mVertices[i].x;
-			vector.y = mesh->mVertices[i].y;
-			vector.z = mesh->mVertices[i].z;
-			vertex.Position = vector;
-			// normals
-			if (mesh->HasNormals())
-			{
-				vector.x = mesh->mNormals[i].x;
-				vector.y = mesh->mNormals[i].y;
-				vector.z = mesh->mNormals[i].z;
-				vertex.Normal = vector;
-			}
-			// texture coordinates
-			if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
-			{
-				glm::vec2 vec;
-				// a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
-				// use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-				vec.x = mesh->mTextureCoords[0][i].x;
-				vec.y = mesh->mTextureCoords[0][i].y;
-				vertex.TexCoords = vec;
-				// tangent
-				//vector.x = mesh->mTangents[i].x;
-				//vector.y = mesh->mTangents[i].y;
-				//vector.z = mesh->mTangents[i].z;
-				//vertex.Tangent = vector;
-				//// bitangent
-				//vector.x = mesh->mBitangents[i].x;
-				//vector.y = mesh->mBitangents[i].y;
-				//vector.z = mesh->mBitangents[i].z;
-				//vertex.Bitangent = vector;
-			}
-			else
-				vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-			vertices.push_back(vertex);
-		}
-		// now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-		for (unsigned int i = 0; i < mesh->mNumFaces; i++)
-		{
-			aiFace face = mesh->mFaces[i];
-			// retrieve all indices of the face and store them in the indices vector
-			for (unsigned int j = 0; j < face.mNumIndices; j++)
-				indices.push_back(face.mIndices[j]);
+			cout << "ERROR::MODEL:: '" << bakedPath << "' is not a valid baked model, importing the source instead" << endl;
+			return false;
 		}
 
-		if (!mesh->mMaterialIndex)
+		meshes.reserve(view.header->meshCount);
+		for (uint32_t i = 0; i < view.header->meshCount; i++)
 		{
-			return Mesh(vertices, indices, textures);
+			const BakedMeshRecord& record = view.meshes[i];
+			vector<MaterialTexture> materialTextures;
+			for (uint32_t t = record.firstTexture; t < record.firstTexture + record.textureCount; t++)
+				materialTextures.push_back({ view.textures[t].type, view.textures[t].path });
+			meshes.emplace_back(view.buffers(record), loadMaterialTextures(materialTextures), view.meshLods(record));
 		}
-
-		// process materials
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		// we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-		// as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-		// Same applies to other texture as the following list summarizes:
-		// diffuse: texture_diffuseN
-		// specular: texture_specularN
-		// normal: texture_normalN
-
-		// 1. diffuse maps
-		vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-		// 2. specular maps
-		vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-		// 3. normal maps
-		std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-		// 4. height maps
-		std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-		// return a mesh object created from the extracted mesh data
-		return Mesh(vertices, indices, textures);
+		return true;
 	}
 
-	// checks all material textures of a given type and loads the textures if they're not loaded yet.
+	// loads the material textures of a mesh if they're not loaded yet.
 	// the required info is returned as a Texture struct.
-	vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+	vector<Texture> loadMaterialTextures(const vector<MaterialTexture>& materialTextures)
 	{
 		vector<Texture> textures;
-		for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+		for (const auto& material : materialTextures)
 		{
-			aiString str;
-			mat->GetTexture(type, i, &str);
+			const char* path = material.path.c_str();
 			// check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
 			bool skip = false;
 			for (unsigned int j = 0; j < textures_loaded.size(); j++)
 			{
-				if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+				if (textures_loaded[j].path == material.path)
 				{
 					textures.push_back(textures_loaded[j]);
 					skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
@@ -204,9 +158,18 @@ private:
 			if (!skip)
 			{   // if texture hasn't been loaded already, load it
 				Texture texture;
-				texture.id = TextureFromFile(str.C_Str(), this->directory);
-				texture.type = typeName;
-				texture.path = str.C_Str();
+				if (textureCache != nullptr)
+				{
+					auto shared = textureCache->load(path, this->directory);
+					texture.id = shared->id;
+					shared_textures.push_back(shared);
+				}
+				else
+				{
+					texture.id = TextureFromFile(path, this->directory);
+				}
+				texture.type = material.type;
+				texture.path = material.path;
 				textures.push_back(texture);
 				textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
 			}
@@ -214,52 +177,4 @@ private:
 		return textures;
 	}
 };
-
-
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
-{
-	// Fully qualified file paths from the textures sometimes??
-	// TODO: Get to the bottom of this
-	string filename = string(path);
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-	if (!data)
-	{
-		cout << "Model: Failed to load texture from default path: " << filename << ". Going to try and add directory." << endl;
-		filename = directory + '/' + filename;
-		data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-	}
-
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << filename << std::endl;
-		stbi_image_free(data);
-	}
-
-	return textureID;
-}
 #endif
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include "occlusion_buffer.h"
+#include <cmath>
+#include <algorithm>
+#include <glm/gtc/quaternion.hpp>
+
+#if !defined(MECHANICS_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define OCCLUSION_SSE2
+#include <emmintrin.h>
+#endif
+
+OcclusionBuffer::OcclusionBuffer(unsigned int width, unsigned int height)
+{
+	resize(width, height);
+}
+
+void OcclusionBuffer::resize(unsigned int width, unsigned int height)
+{
+	this->width = width;
+	this->height = height;
+	stride = (width + 3) & ~3u;
+	depth.assign(stride * height, 1.0f);
+}
+
+void OcclusionBuffer::begin(const glm::mat4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	stats = OcclusionStats();
+}
+
+void OcclusionBuffer::rasterize(const glm::vec3* triangles, unsigned int vertexCount, const glm::mat4& model)
+{
+	glm::mat4 mvp = viewProjection * model;
+	for (unsigned int i = 0; i + 2 < vertexCount; i += 3)
+	{
+		glm::vec4 clip[3] = {
+			mvp * glm::vec4(triangles[i], 1.0f),
+			mvp * glm::vec4(triangles[i + 1], 1.0f),
+			mvp * glm::vec4(triangles[i + 2], 1.0f)
+		};
+		rasterizeClipped(clip, 3);
+		stats.occluderTriangles++;
+	}
+}
+
+void OcclusionBuffer::rasterizeOccluders(EntityStore& store)
+{
+	EntityStore::each(store.occluders, store.transforms, [&](EntityId, OccluderComponent& occluder, Transform& transform)
+	{
+		const Vector3& position = transform.getPosition();
+		const Quaternion& orientation = transform.getOrientation();
+		glm::mat4 model = glm::mat4_cast(glm::quat(orientation.w, orientation.x, orientation.y, orientation.z));
+		model[3] = glm::vec4(position.x, position.y, position.z, 1.0f);
+		rasterize(occluder.triangles.data(), (unsigned int)occluder.triangles.size(), model);
+	});
+}
+
+// Clips the triangle against the near plane (z >= -w), which also keeps w positive, then hands
+// the one or two resulting triangles to the rasterizer in screen space
+void OcclusionBuffer::rasterizeClipped(const glm::vec4* clip, unsigned int count)
+{
+	glm::vec4 clipped[4];
+	unsigned int clippedCount = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const glm::vec4& current = clip[i];
+		const glm::vec4& next = clip[(i + 1) % count];
+		float currentDistance = current.z + current.w;
+		float nextDistance = next.z + next.w;
+		if (currentDistance >= 0.0f)
+			clipped[clippedCount++] = current;
+		if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+			clipped[clippedCount++] = glm::mix(current, next, currentDistance / (currentDistance - nextDistance));
+	}
+	if (clippedCount < 3)
+		return;
+
+	glm::vec3 screen[4];
+	for (unsigned int i = 0; i < clippedCount; i++)
+	{
+		// on the near plane w can only be 0 when the near distance is, guard anyway
+		float inverseW = 1.0f / std::max(clipped[i].w, 1e-6f);
+		screen[i] = glm::vec3(
+			(clipped[i].x * inverseW * 0.5f + 0.5f) * width,
+			(clipped[i].y * inverseW * 0.5f + 0.5f) * height,
+			clipped[i].z * inverseW * 0.5f + 0.5f);
+	}
+	for (unsigned int i = 1; i + 1 < clippedCount; i++)
+		rasterizeTriangle(screen[0], screen[i], screen[i + 1]);
+}
+
+void OcclusionBuffer::rasterizeTriangle(const glm::vec3& a, const glm::vec3& b0, const glm::vec3& c0)
+{
+	float area = (b0.x - a.x) * (c0.y - a.y) - (b0.y - a.y) * (c0.x - a.x);
+	if (std::abs(area) < 1e-6f)
+		return;
+	// counter clockwise from here on, occluders have no back faces
+	glm::vec3 b = area > 0.0f ? b0 : c0;
+	glm::vec3 c = area > 0.0f ? c0 : b0;
+	area = std::abs(area);
+
+	int minX = std::max(0, (int)std::floor(std::min({ a.x, b.x, c.x })));
+	int maxX = std::min((int)width - 1, (int)std::ceil(std::max({ a.x, b.x, c.x })));
+	int minY = std::max(0, (int)std::floor(std::min({ a.y, b.y, c.y })));
+	int maxY = std::min((int)height - 1, (int)std::ceil(std::max({ a.y, b.y, c.y })));
+	if (minX > maxX || minY > maxY)
+		return;
+
+	// edge functions e = A * x + B * y + C, positive inside
+	const glm::vec3* from[3] = { &a, &b, &c };
+	const glm::vec3* to[3] = { &b, &c, &a };
+	float edgeA[3], edgeB[3], edgeC[3];
+	for (int e = 0; e < 3; e++)
+	{
+		edgeA[e] = -(to[e]->y - from[e]->y);
+		edgeB[e] = to[e]->x - from[e]->x;
+		edgeC[e] = -(edgeA[e] * from[e]->x + edgeB[e] * from[e]->y);
+	}
+	// depth plane z = zA * x + zB * y + zC from the barycentric weights, edge e is opposite vertex (e + 2) % 3
+	float zA = (edgeA[1] * a.z + edgeA[2] * b.z + edgeA[0] * c.z) / area;
+	float zB = (edgeB[1] * a.z + edgeB[2] * b.z + edgeB[0] * c.z) / area;
+	float zC = (edgeC[1] * a.z + edgeC[2] * b.z + edgeC[0] * c.z) / area;
+	// the farthest the plane gets inside a pixel
+	zC += 0.5f * (std::abs(zA) + std::abs(zB));
+
+#ifdef OCCLUSION_SSE2
+	int startX = minX & ~3;
+#endif
+	for (int y = minY; y <= maxY; y++)
+	{
+		float py = y + 0.5f;
+		float* row = depth.data() + y * stride;
+		float rowE[3];
+		for (int e = 0; e < 3; e++)
+			rowE[e] = edgeB[e] * py + edgeC[e];
+		float rowZ = zB * py + zC;
+#ifdef OCCLUSION_SSE2
+		const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 zero = _mm_setzero_ps();
+		__m128 stepE0 = _mm_set1_ps(edgeA[0]), stepE1 = _mm_set1_ps(edgeA[1]), stepE2 = _mm_set1_ps(edgeA[2]);
+		__m128 stepZ = _mm_set1_ps(zA);
+		for (int x = startX; x <= maxX; x += 4)
+		{
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(stepE0, px), _mm_set1_ps(rowE[0]));
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(stepE1, px), _mm_set1_ps(rowE[1]));
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(stepE2, px), _mm_set1_ps(rowE[2]));
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+			__m128 z = _mm_add_ps(_mm_mul_ps(stepZ, px), _mm_set1_ps(rowZ));
+			__m128 current = _mm_loadu_ps(row + x);
+			__m128 nearer = _mm_min_ps(current, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+		}
+#else
+		for (int x = minX; x <= maxX; x++)
+		{
+			float px = x + 0.5f;
+			if (edgeA[0] * px + rowE[0] < 0.0f || edgeA[1] * px + rowE[1] < 0.0f || edgeA[2] * px + rowE[2] < 0.0f)
+				continue;
+			row[x] = std::min(row[x], zA * px + rowZ);
+		}
+#endif
+	}
+}
+
+bool OcclusionBuffer::isVisible(const Aabb& worldBox)
+{
+	stats.tested++;
+	float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner((i & 1) ? worldBox.max.x : worldBox.min.x, (i & 2) ? worldBox.max.y : worldBox.min.y, (i & 4) ? worldBox.max.z : worldBox.min.z);
+		glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+		// reaching past the near plane, it could be right in front of the camera
+		if (clip.z < -clip.w || clip.w <= 1e-6f)
+			return true;
+		float inverseW = 1.0f / clip.w;
+		float x = (clip.x * inverseW * 0.5f + 0.5f) * width;
+		float y = (clip.y * inverseW * 0.5f + 0.5f) * height;
+		minX = std::min(minX, x); maxX = std::max(maxX, x);
+		minY = std::min(minY, y); maxY = std::max(maxY, y);
+		minZ = std::min(minZ, clip.z * inverseW * 0.5f + 0.5f);
+	}
+
+	int x0 = std::max(0, (int)std::floor(minX));
+	int x1 = std::min((int)width - 1, (int)std::floor(maxX));
+	int y0 = std::max(0, (int)std::floor(minY));
+	int y1 = std::min((int)height - 1, (int)std::floor(maxY));
+	// off screen is for the frustum test to decide
+	if (x0 > x1 || y0 > y1)
+		return true;
+
+	for (int y = y0; y <= y1; y++)
+	{
+		const float* row = depth.data() + y * stride;
+		int x = x0;
+#ifdef OCCLUSION_SSE2
+		__m128 boxZ = _mm_set1_ps(minZ);
+		for (; x + 3 <= x1; x += 4)
+		{
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxZ)) != 0)
+				return true;
+		}
+#endif
+		for (; x <= x1; x++)
+		{
+			if (row[x] >= minZ)
+				return true;
+		}
+	}
+	stats.occluded++;
+	return false;
+}
+
+OccluderComponent occluderFromBox(const Aabb& box)
+{
+	glm::vec3 corners[8];
+	for (int i = 0; i < 8; i++)
+		corners[i] = glm::vec3((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+	// two triangles per face, winding doesn't matter to the rasterizer
+	static const int faces[6][4] = {
+		{ 0, 1, 3, 2 }, { 4, 5, 7, 6 },
+		{ 0, 1, 5, 4 }, { 2, 3, 7, 6 },
+		{ 0, 2, 6, 4 }, { 1, 3, 7, 5 }
+	};
+	OccluderComponent occluder;
+	for (const auto& face : faces)
+	{
+		occluder.triangles.insert(occluder.triangles.end(), { corners[face[0]], corners[face[1]], corners[face[2]] });
+		occluder.triangles.insert(occluder.triangles.end(), { corners[face[0]], corners[face[2]], corners[face[3]] });
+	}
+	return occluder;
+}
+
+const char* occlusionBufferPath()
+{
+#ifdef OCCLUSION_SSE2
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
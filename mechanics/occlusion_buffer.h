@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "bounds.h"
+#include "entity_store.h"
+
+using namespace std;
+
+struct OcclusionStats
+{
+	unsigned int occluderTriangles = 0;
+	unsigned int tested = 0;
+	unsigned int occluded = 0;
+};
+
+// Low resolution depth buffer rasterized on the CPU from the occluder entities, then used to test
+// bounding boxes before their entities are drawn. Nothing in here touches OpenGL.
+//
+// Occluders write the pixels whose centers they cover, with the farthest depth they reach inside
+// the pixel, and a box counts as hidden only when its nearest corner is behind every pixel its
+// screen rectangle touches. Coverage at an occluder's edges can be off by up to half a pixel, so
+// occluder geometry has to sit a little inside the model that is actually drawn.
+class OcclusionBuffer
+{
+public:
+	static const unsigned int DEFAULT_WIDTH = 256;
+	static const unsigned int DEFAULT_HEIGHT = 144;
+
+	OcclusionStats stats;
+
+	OcclusionBuffer(unsigned int width = DEFAULT_WIDTH, unsigned int height = DEFAULT_HEIGHT);
+	void resize(unsigned int width, unsigned int height);
+
+	// clears the depth and takes the camera the frame is drawn with
+	void begin(const glm::mat4& viewProjection);
+	// model space triangles, three vertices each
+	void rasterize(const glm::vec3* triangles, unsigned int vertexCount, const glm::mat4& model);
+	// every entity with an occluder and a transform
+	void rasterizeOccluders(EntityStore& store);
+
+	// false only when the box is certainly behind the occluders
+	bool isVisible(const Aabb& worldBox);
+
+	unsigned int getWidth() const { return width; }
+	unsigned int getHeight() const { return height; }
+	// 0 at the near plane, 1 at the far plane and where nothing was drawn
+	float depthAt(unsigned int x, unsigned int y) const { return depth[y * stride + x]; }
+
+private:
+	unsigned int width = 0;
+	unsigned int height = 0;
+	// rows padded to a multiple of 4 pixels for the SIMD loops
+	unsigned int stride = 0;
+	vector<float> depth;
+	glm::mat4 viewProjection = glm::mat4(1.0f);
+
+	void rasterizeClipped(const glm::vec4* clip, unsigned int count);
+	void rasterizeTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+};
+
+// The 12 triangles of a box, e.g. a slightly shrunk copy of a plank's bounds as its occluder
+OccluderComponent occluderFromBox(const Aabb& box);
+
+// "sse2" or "scalar", whichever the rasterizer and the box test were compiled for
+const char* occlusionBufferPath();
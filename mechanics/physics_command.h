@@ -0,0 +1,22 @@
+#pragma once
+#include <reactphysics3d/reactphysics3d.h>
+
+using namespace reactphysics3d;
+
+enum class PhysicsCommandType
+{
+	MoveCamera,
+	Punch,
+	Jump
+};
+
+// Input that changes the simulation. It is recorded on the render thread and applied on the
+// physics thread right before the frame it was pushed for is stepped.
+struct PhysicsCommand
+{
+	PhysicsCommandType type;
+	// where the camera moved to, or where a punch starts
+	Vector3 position;
+	// punch or jump direction, for MoveCamera where the camera looks (only replays use that)
+	Vector3 direction;
+};
@@ -1,19 +1,34 @@
 #pragma once
 #include <reactphysics3d/reactphysics3d.h>
-#include <glad\glad.h>
+#include <glad/glad.h>
+#include <cstring>
+#include <algorithm>
 
 using namespace reactphysics3d;
 
+// Streams the debug lines and triangles of the physics world into a ring of RING_FRAMES regions
+// in one buffer. A frame writes its own region with an unsynchronized map and fences it after
+// drawing, so the driver never has to wait on or copy a buffer the GPU is still reading.
+// rp3d already stores lines and triangles as position + color vertices, they are copied as is.
 struct PhysicsDebugRenderer
 {
+	static const unsigned int RING_FRAMES = 3;
+	// a Vector3 and a uint32 color per vertex
+	static const int vertexSize = sizeof(Vector3) + sizeof(uint32);
+	static_assert(sizeof(DebugRenderer::DebugLine) == 2 * vertexSize, "debug lines are expected to be two packed vertices");
+	static_assert(sizeof(DebugRenderer::DebugTriangle) == 3 * vertexSize, "debug triangles are expected to be three packed vertices");
+
 	DebugRenderer* debugRenderer;
-	static const int floatsPerLine = 2 * 3;
-	static const int floatsPerTri = 3 * 3;
-	float* lineVertices = nullptr;
-	float* triVertices = nullptr;
-	unsigned int debugLineVAO, debugLineVBO, debugTriVAO, debugTriVBO;
-	int numLineVertices = 0;
-	int numTriVertices = 0;
+	unsigned int debugVAO, debugVBO;
+	// bytes per frame region, grows when a frame doesn't fit
+	GLsizeiptr regionSize = 0;
+	unsigned int region = 0;
+	GLsync fences[RING_FRAMES] = {};
+	// vertices of the current region, triangles follow the lines
+	GLint firstLineVertex = 0;
+	GLsizei numLineVertices = 0;
+	GLint firstTriVertex = 0;
+	GLsizei numTriVertices = 0;
 
 	PhysicsDebugRenderer(PhysicsWorld* world)
 	{
@@ -23,111 +38,114 @@ struct PhysicsDebugRenderer
 		//debugRenderer->setIsDebugItemDisplayed(DebugRenderer::DebugItem::COLLIDER_BROADPHASE_AABB, true);
 
 		// Init render buffers
-		glGenVertexArrays(1, &debugLineVAO);
-		glGenBuffers(1, &debugLineVBO);
-		glGenVertexArrays(1, &debugTriVAO);
-		glGenBuffers(1, &debugTriVBO);
+		glGenVertexArrays(1, &debugVAO);
+		glGenBuffers(1, &debugVBO);
+		glBindVertexArray(debugVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, debugVBO);
+		// vertex positions, the colors in between are skipped
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertexSize, (void*)0);
+		glBindVertexArray(0);
 	}
 
 	void draw(bool disableDepthTest = true)
 	{
+		if (numLineVertices == 0 && numTriVertices == 0)
+			return;
 		if (disableDepthTest)
 		{
 			glDisable(GL_DEPTH_TEST);
 		}
+		glBindVertexArray(debugVAO);
 		if (numLineVertices > 0)
 		{
-			glBindVertexArray(debugLineVAO);
-			glDrawArrays(GL_LINES, 0, numLineVertices);
+			glDrawArrays(GL_LINES, firstLineVertex, numLineVertices);
 		}
 		if (numTriVertices > 0)
 		{
-			//glBindVertexArray(debugTriVAO);
-			//glDrawArrays(GL_TRIANGLES, 0, numTriVertices);
+			// filled triangles in one flat color would hide everything behind them
+			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+			glDrawArrays(GL_TRIANGLES, firstTriVertex, numTriVertices);
+			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 		}
+		glBindVertexArray(0);
 		if (disableDepthTest)
 		{
 			glEnable(GL_DEPTH_TEST);
 		}
+		// the region can be written again once the GPU is past this point
+		deleteFence(fences[region]);
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 	}
 
 	void updateDebugState()
 	{
 		auto nbLines = debugRenderer->getNbLines();
-		auto lineVtxCount = double(floatsPerLine) * nbLines;
-		if (lineVertices == nullptr || lineVtxCount != numLineVertices)
-		{
-			delete[numLineVertices] lineVertices;
-			numLineVertices = lineVtxCount;
-			lineVertices = new float[numLineVertices];
-		}
-		if (numLineVertices > 0)
+		auto nbTris = debugRenderer->getNbTriangles();
+		GLsizeiptr lineBytes = GLsizeiptr(nbLines) * sizeof(DebugRenderer::DebugLine);
+		GLsizeiptr triBytes = GLsizeiptr(nbTris) * sizeof(DebugRenderer::DebugTriangle);
+		GLsizeiptr bytes = lineBytes + triBytes;
+		numLineVertices = 0;
+		numTriVertices = 0;
+		if (bytes == 0)
+			return;
+
+		glBindBuffer(GL_ARRAY_BUFFER, debugVBO);
+		if (bytes > regionSize)
 		{
-			auto* debugLines = debugRenderer->getLinesArray();
-			for (int i = 0; i < nbLines; i++)
+			// the old storage is orphaned, so pending fences no longer guard anything
+			for (auto& fence : fences)
 			{
-				int vertexIx = i * floatsPerLine;
-				float floats[floatsPerLine] = {
-					debugLines[i].point1.x,
-					debugLines[i].point1.y,
-					debugLines[i].point1.z,
-					debugLines[i].point2.x,
-					debugLines[i].point2.y,
-					debugLines[i].point2.z
-				};
-				for (int j = 0; j < floatsPerLine; j++)
-				{
-					lineVertices[vertexIx + j] = floats[j];
-				}
+				deleteFence(fence);
 			}
+			regionSize = std::max<GLsizeiptr>(std::max<GLsizeiptr>(bytes, regionSize * 2), 64 * 1024);
+			glBufferData(GL_ARRAY_BUFFER, regionSize * RING_FRAMES, nullptr, GL_STREAM_DRAW);
+			region = 0;
+		}
+		else
+		{
+			region = (region + 1) % RING_FRAMES;
+			waitForRegion(region);
 		}
 
-		auto nbTris = debugRenderer->getNbTriangles();
-		auto triVtxCount = double(floatsPerTri) * nbTris;
-		if (triVertices == nullptr || triVtxCount != numTriVertices)
+		GLintptr offset = GLintptr(region) * regionSize;
+		auto* mapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, offset, bytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (mapped != nullptr)
 		{
-			delete[numTriVertices] triVertices;
-			numTriVertices = triVtxCount;
-			triVertices = new float[numTriVertices];
+			memcpy(mapped, debugRenderer->getLinesArray(), lineBytes);
+			memcpy(mapped + lineBytes, debugRenderer->getTrianglesArray(), triBytes);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
 		}
-		if (numTriVertices > 0)
+		else
 		{
-			auto* debugTris = debugRenderer->getTrianglesArray();
-			for (int i = 0; i < nbTris; i++)
-			{
-				int vertexIx = i * floatsPerTri;
-				float floats[floatsPerTri] = {
-					debugTris[i].point1.x,
-					debugTris[i].point1.y,
-					debugTris[i].point1.z,
-					debugTris[i].point2.x,
-					debugTris[i].point2.y,
-					debugTris[i].point2.z,
-					debugTris[i].point3.x,
-					debugTris[i].point3.y,
-					debugTris[i].point3.z
-				};
-				for (int j = 0; j < floatsPerTri; j++)
-				{
-					triVertices[vertexIx + j] = floats[j];
-				}
-			}
+			glBufferSubData(GL_ARRAY_BUFFER, offset, lineBytes, debugRenderer->getLinesArray());
+			glBufferSubData(GL_ARRAY_BUFFER, offset + lineBytes, triBytes, debugRenderer->getTrianglesArray());
 		}
 
-		glBindVertexArray(debugLineVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, debugLineVBO);
-		glBufferData(GL_ARRAY_BUFFER, numLineVertices * sizeof(float), &lineVertices[0], GL_STATIC_DRAW);
-
-		// line vertex positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+		firstLineVertex = GLint(offset / vertexSize);
+		numLineVertices = GLsizei(nbLines * 2);
+		firstTriVertex = GLint((offset + lineBytes) / vertexSize);
+		numTriVertices = GLsizei(nbTris * 3);
+	}
 
-		glBindVertexArray(debugTriVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, debugTriVBO);
-		glBufferData(GL_ARRAY_BUFFER, numTriVertices * sizeof(float), &triVertices[0], GL_STATIC_DRAW);
+	void waitForRegion(unsigned int ix)
+	{
+		if (fences[ix] == nullptr)
+			return;
+		// three frames back this has practically always signaled already
+		while (glClientWaitSync(fences[ix], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+		{
+		}
+		deleteFence(fences[ix]);
+	}
 
-		// tri vertex positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	static void deleteFence(GLsync& fence)
+	{
+		if (fence != nullptr)
+		{
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
 	}
 };
@@ -0,0 +1,195 @@
+#include "physics_pipeline.h"
+#include "profiler.h"
+#include <iostream>
+
+PhysicsPipeline::~PhysicsPipeline()
+{
+	stop();
+}
+
+void PhysicsPipeline::start(PhysicsWorld* world, EntityStore* store, BodyInterpolator* interpolator, const TimestepSettings& settings, bool threaded)
+{
+	stop();
+	this->world = world;
+	this->store = store;
+	this->interpolator = interpolator;
+	controller.configure(settings);
+	stopping = false;
+	busy = false;
+	unpublished = false;
+	pending.clear();
+	submitted.clear();
+	if (threaded)
+		worker = thread(&PhysicsPipeline::workerLoop, this);
+}
+
+void PhysicsPipeline::stop()
+{
+	if (!worker.joinable())
+		return;
+	wait();
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	frameSubmitted.notify_one();
+	worker.join();
+}
+
+void PhysicsPipeline::push(const PhysicsCommand& command)
+{
+	pending.push_back(command);
+}
+
+void PhysicsPipeline::submit(float deltaTime)
+{
+	// the worker only looks at submitted while busy, so it is free to swap once the last frame is done
+	wait();
+	if (replay != nullptr)
+	{
+		// live input has no say in a replay
+		pending.clear();
+		if (replayDone || !replay->next(replayFrame))
+		{
+			replayDone = true;
+			return;
+		}
+		submitted = replayFrame.commands;
+	}
+	else
+	{
+		submitted.swap(pending);
+	}
+	frameTime = deltaTime;
+	if (!threaded())
+	{
+		simulate();
+		publish();
+		return;
+	}
+	{
+		lock_guard<mutex> guard(lock);
+		busy = true;
+	}
+	frameSubmitted.notify_one();
+}
+
+void PhysicsPipeline::wait()
+{
+	if (threaded())
+	{
+		PROFILE_SCOPE("physics wait");
+		unique_lock<mutex> guard(lock);
+		frameDone.wait(guard, [this] { return !busy; });
+	}
+	publish();
+}
+
+void PhysicsPipeline::workerLoop()
+{
+	profiler.nameThread("physics");
+	unique_lock<mutex> guard(lock);
+	while (true)
+	{
+		frameSubmitted.wait(guard, [this] { return busy || stopping; });
+		if (stopping)
+			return;
+		guard.unlock();
+		simulate();
+		guard.lock();
+		busy = false;
+		frameDone.notify_one();
+	}
+}
+
+void PhysicsPipeline::simulate()
+{
+	PROFILE_SCOPE("physics frame");
+	if (applyCommand)
+	{
+		for (const auto& command : submitted)
+			applyCommand(world, command);
+	}
+	if (recorder != nullptr)
+	{
+		recordFrame.commands.swap(submitted);
+		recordFrame.checksums.clear();
+	}
+	submitted.clear();
+
+	unsigned int steps = 0;
+	float blendFactor = 0.0f;
+	if (replay != nullptr)
+	{
+		steps = replayFrame.steps;
+		blendFactor = replayFrame.blendFactor;
+		if (world->getNbIterationsVelocitySolver() != replayFrame.velocityIterations)
+			world->setNbIterationsVelocitySolver(replayFrame.velocityIterations);
+		if (world->getNbIterationsPositionSolver() != replayFrame.positionIterations)
+			world->setNbIterationsPositionSolver(replayFrame.positionIterations);
+	}
+	else
+	{
+		steps = controller.advance(frameTime);
+		blendFactor = controller.blendFactor();
+		controller.applyIterations(world);
+	}
+
+	float timestep = controller.getSettings().timestep;
+	for (unsigned int i = 0; i < steps; i++)
+	{
+		PROFILE_SCOPE("physics step");
+		world->update(timestep);
+		// recording a replay writes the checksums it verified, every step needs one
+		if (replay != nullptr || recorder != nullptr)
+		{
+			uint64_t checksum = checksumBodies(*store);
+			if (replay != nullptr)
+				verifyStep(i, checksum);
+			if (recorder != nullptr)
+				recordFrame.checksums.push_back(checksum);
+		}
+	}
+
+	if (recorder != nullptr)
+	{
+		recordFrame.steps = steps;
+		recordFrame.velocityIterations = world->getNbIterationsVelocitySolver();
+		recordFrame.positionIterations = world->getNbIterationsPositionSolver();
+		recordFrame.blendFactor = blendFactor;
+		recorder->write(recordFrame);
+	}
+	if (interpolator != nullptr)
+	{
+		PROFILE_SCOPE("interpolation");
+		interpolator->blend(*store, blendFactor);
+		unpublished = true;
+	}
+}
+
+void PhysicsPipeline::setReplay(PhysicsReplay* replay)
+{
+	this->replay = replay;
+	replayDone = false;
+	mismatches = 0;
+	replayedSteps = 0;
+}
+
+void PhysicsPipeline::verifyStep(unsigned int step, uint64_t checksum)
+{
+	if (checksum != replayFrame.checksums[step])
+	{
+		if (mismatches == 0)
+			cout << "Replay diverged at step " << replayedSteps << " (frame " << replay->framesRead() << ")" << endl;
+		mismatches++;
+	}
+	replayedSteps++;
+}
+
+void PhysicsPipeline::publish()
+{
+	if (!unpublished)
+		return;
+	interpolator->apply(*store);
+	unpublished = false;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <reactphysics3d/reactphysics3d.h>
+#include "entity_store.h"
+#include "body_interpolator.h"
+#include "timestep_controller.h"
+#include "physics_command.h"
+#include "physics_recording.h"
+
+using namespace std;
+using namespace reactphysics3d;
+
+// Steps the physics world for frame N+1 on a worker thread while the render thread draws frame N.
+//
+// The render thread calls, once per frame:
+//   wait()   - blocks until the frame submitted last is simulated and copies its blended
+//              transforms into the store, those are what gets drawn this frame
+//   push()   - input for the frame about to be submitted
+//   submit() - hands the frame time and the input over, the worker steps the world and blends
+//              into the interpolator's arrays while the render thread draws
+// Between wait() and submit() the worker is idle, so that is the place to read the world (debug
+// lines) or to add and remove bodies. While a frame is in flight the render thread must leave the
+// world and the store's body pool alone; it only reads transforms and render components.
+//
+// This adds one frame of latency. Without a worker, submit() simulates and publishes right away.
+//
+// With a recorder every simulated frame is written to it. With a replay, submit() takes the
+// commands, step count and solver iterations of the next recorded frame instead of the frame time
+// and the pushed commands, and every step is checked against the recorded checksum.
+class PhysicsPipeline
+{
+public:
+	// called on the physics thread for every pushed command, before stepping
+	function<void(PhysicsWorld*, const PhysicsCommand&)> applyCommand;
+
+	PhysicsPipeline() = default;
+	PhysicsPipeline(const PhysicsPipeline&) = delete;
+	PhysicsPipeline& operator=(const PhysicsPipeline&) = delete;
+	~PhysicsPipeline();
+
+	void start(PhysicsWorld* world, EntityStore* store, BodyInterpolator* interpolator, const TimestepSettings& settings, bool threaded = true);
+	// finishes the frame in flight and joins the worker
+	void stop();
+
+	void push(const PhysicsCommand& command);
+	void submit(float deltaTime);
+	void wait();
+
+	bool threaded() const { return worker.joinable(); }
+	// step and dropped time counters, only read them between wait() and submit()
+	const TimestepController& timing() const { return controller; }
+
+	// call before start or between wait() and submit(), nullptr turns it off
+	void setRecorder(PhysicsRecorder* recorder) { this->recorder = recorder; }
+	void setReplay(PhysicsReplay* replay);
+	bool replaying() const { return replay != nullptr; }
+	// the recording has no more frames, the world stays as the last one left it
+	bool replayFinished() const { return replayDone; }
+	// steps whose bodies didn't match the recording
+	unsigned int replayMismatches() const { return mismatches; }
+	// the frame submitted last, e.g. to put the camera where it was
+	const RecordedFrame& replayedFrame() const { return replayFrame; }
+
+private:
+	PhysicsWorld* world = nullptr;
+	EntityStore* store = nullptr;
+	BodyInterpolator* interpolator = nullptr;
+	TimestepController controller;
+
+	thread worker;
+	mutex lock;
+	condition_variable frameSubmitted;
+	condition_variable frameDone;
+	bool stopping = false;
+	// a frame is submitted and not simulated yet
+	bool busy = false;
+	// the interpolator holds a blend that isn't in the store yet
+	bool unpublished = false;
+
+	float frameTime = 0.0f;
+
+	PhysicsRecorder* recorder = nullptr;
+	RecordedFrame recordFrame;
+	PhysicsReplay* replay = nullptr;
+	RecordedFrame replayFrame;
+	bool replayDone = false;
+	unsigned int mismatches = 0;
+	unsigned long long replayedSteps = 0;
+	// filled by push, handed to the worker by submit
+	vector<PhysicsCommand> pending;
+	vector<PhysicsCommand> submitted;
+
+	void workerLoop();
+	void simulate();
+	void verifyStep(unsigned int step, uint64_t checksum);
+	void publish();
+};
@@ -0,0 +1,134 @@
+#include "physics_recording.h"
+#include <cstring>
+#include <iostream>
+
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t size)
+{
+	auto* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+uint64_t checksumBodies(EntityStore& store)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (unsigned int i = 0; i < store.bodies.size(); i++)
+	{
+		const Transform& transform = store.bodies.at(i).body->getTransform();
+		const Vector3& position = transform.getPosition();
+		const Quaternion& orientation = transform.getOrientation();
+		decimal values[7] = { position.x, position.y, position.z, orientation.x, orientation.y, orientation.z, orientation.w };
+		hash = fnv1a(hash, values, sizeof(values));
+	}
+	return hash;
+}
+
+bool PhysicsRecorder::open(const string& path, const RecordingHeader& header)
+{
+	close();
+	file.open(path, ios::binary | ios::trunc);
+	if (!file.is_open())
+	{
+		cout << "Could not open recording file at location: '" << path << "'." << endl;
+		return false;
+	}
+	RecordingHeader out = header;
+	memcpy(out.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+	out.version = RECORDING_VERSION;
+	out.decimalSize = sizeof(decimal);
+	file.write((const char*)&out, sizeof(out));
+	frames = 0;
+	return true;
+}
+
+void PhysicsRecorder::write(const RecordedFrame& frame)
+{
+	if (!file.is_open())
+		return;
+	// a frame never runs more than the step cap
+	RecordedFrameHeader frameHeader = {};
+	frameHeader.steps = (uint8_t)frame.steps;
+	frameHeader.velocityIterations = (uint8_t)frame.velocityIterations;
+	frameHeader.positionIterations = (uint8_t)frame.positionIterations;
+	frameHeader.commandCount = (uint32_t)frame.commands.size();
+	frameHeader.blendFactor = frame.blendFactor;
+	file.write((const char*)&frameHeader, sizeof(frameHeader));
+	for (unsigned int i = 0; i < frameHeader.commandCount; i++)
+	{
+		const PhysicsCommand& command = frame.commands[i];
+		RecordedCommand record = {};
+		record.type = (uint32_t)command.type;
+		record.position[0] = command.position.x; record.position[1] = command.position.y; record.position[2] = command.position.z;
+		record.direction[0] = command.direction.x; record.direction[1] = command.direction.y; record.direction[2] = command.direction.z;
+		file.write((const char*)&record, sizeof(record));
+	}
+	file.write((const char*)frame.checksums.data(), frameHeader.steps * sizeof(uint64_t));
+	frames++;
+}
+
+void PhysicsRecorder::close()
+{
+	if (file.is_open())
+		file.close();
+}
+
+bool PhysicsReplay::open(const string& path)
+{
+	if (!file.open(path))
+	{
+		cout << "Could not open recording at location '" << path << "'." << endl;
+		return false;
+	}
+	if (file.size() < sizeof(RecordingHeader))
+	{
+		cout << "Recording '" << path << "' is truncated." << endl;
+		return false;
+	}
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0 || header.version != RECORDING_VERSION
+		|| header.decimalSize != sizeof(decimal))
+	{
+		cout << "Recording '" << path << "' is not a valid recording of this version." << endl;
+		return false;
+	}
+	cursor = sizeof(RecordingHeader);
+	frames = 0;
+	return true;
+}
+
+bool PhysicsReplay::next(RecordedFrame& frame)
+{
+	if (file.data() == nullptr || cursor + sizeof(RecordedFrameHeader) > file.size())
+		return false;
+	RecordedFrameHeader frameHeader;
+	memcpy(&frameHeader, file.data() + cursor, sizeof(frameHeader));
+	size_t frameSize = sizeof(frameHeader) + (size_t)frameHeader.commandCount * sizeof(RecordedCommand) + frameHeader.steps * sizeof(uint64_t);
+	if (cursor + frameSize > file.size())
+		return false;
+	const unsigned char* data = file.data() + cursor + sizeof(frameHeader);
+
+	frame.steps = frameHeader.steps;
+	frame.velocityIterations = frameHeader.velocityIterations;
+	frame.positionIterations = frameHeader.positionIterations;
+	frame.blendFactor = frameHeader.blendFactor;
+	frame.commands.clear();
+	for (unsigned int i = 0; i < frameHeader.commandCount; i++)
+	{
+		RecordedCommand record;
+		memcpy(&record, data, sizeof(record));
+		data += sizeof(record);
+		frame.commands.push_back({ (PhysicsCommandType)record.type,
+			Vector3(record.position[0], record.position[1], record.position[2]),
+			Vector3(record.direction[0], record.direction[1], record.direction[2]) });
+	}
+	frame.checksums.resize(frameHeader.steps);
+	memcpy(frame.checksums.data(), data, frameHeader.steps * sizeof(uint64_t));
+
+	cursor += frameSize;
+	frames++;
+	return true;
+}
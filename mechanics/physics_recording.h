@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <reactphysics3d/reactphysics3d.h>
+#include "entity_store.h"
+#include "physics_command.h"
+#include "mapped_file.h"
+
+using namespace std;
+using namespace reactphysics3d;
+
+// Recording of a play session, one entry per simulated frame. A frame holds the commands applied
+// before stepping, how many fixed steps ran and with how many solver iterations, and a checksum
+// of every body transform after each step. Replaying feeds the same commands into the same
+// number of steps, so the simulation doesn't depend on the frame times of the replaying machine,
+// and the checksums show the first tick where it went another way.
+//
+// Layout (little endian):
+//   RecordingHeader
+//   per frame: RecordedFrameHeader, RecordedCommand[commandCount], uint64_t checksum[steps]
+//
+// Like physics in general, a replay only matches on the same build and CPU architecture.
+
+const char RECORDING_MAGIC[4] = { 'M', 'R', 'E', 'C' };
+const uint32_t RECORDING_VERSION = 2;
+
+struct RecordingHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t decimalSize;
+	uint32_t bodyCount;
+	float timestep;
+	// how the arena was built, a replay has to start from the same world
+	uint32_t ballUsesGravity;
+	float cameraStart[3];
+	uint32_t reserved;
+};
+
+struct RecordedFrameHeader
+{
+	uint8_t steps;
+	uint8_t velocityIterations;
+	uint8_t positionIterations;
+	uint8_t reserved;
+	// every command simulate() applied, a replay can't match with any left out
+	uint32_t commandCount;
+	// interpolation factor the frame was drawn with
+	float blendFactor;
+};
+
+struct RecordedCommand
+{
+	uint32_t type;
+	float position[3];
+	float direction[3];
+};
+
+struct RecordedFrame
+{
+	unsigned int steps = 0;
+	unsigned int velocityIterations = 0;
+	unsigned int positionIterations = 0;
+	float blendFactor = 0.0f;
+	vector<PhysicsCommand> commands;
+	vector<uint64_t> checksums;
+};
+
+// FNV-1a over the position and orientation bits of every body, in body pool order
+uint64_t checksumBodies(EntityStore& store);
+
+// Streams frames to disk. Used by one thread at a time, the physics pipeline writes from
+// whichever thread simulates.
+class PhysicsRecorder
+{
+public:
+	bool open(const string& path, const RecordingHeader& header);
+	void write(const RecordedFrame& frame);
+	void close();
+
+	bool isOpen() const { return file.is_open(); }
+	unsigned int framesWritten() const { return frames; }
+
+private:
+	ofstream file;
+	unsigned int frames = 0;
+};
+
+class PhysicsReplay
+{
+public:
+	// false if the file is missing, from another version or from a build with another decimal
+	bool open(const string& path);
+	// the next frame, false once the recording is over or cut off
+	bool next(RecordedFrame& frame);
+
+	const RecordingHeader& getHeader() const { return header; }
+	unsigned int framesRead() const { return frames; }
+
+private:
+	MappedFile file;
+	RecordingHeader header = {};
+	size_t cursor = 0;
+	unsigned int frames = 0;
+};
@@ -0,0 +1,270 @@
+#include "profiler.h"
+#include <glad/glad.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <unordered_map>
+#include <string_view>
+
+FrameProfiler profiler;
+GpuProfiler gpuProfiler;
+
+static uint64_t steadyNanoseconds()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FrameProfiler::FrameProfiler()
+{
+	// one nanosecond back so now() is never 0, which scopes use for "not recording"
+	origin = steadyNanoseconds() - 1;
+}
+
+uint64_t FrameProfiler::now() const
+{
+	return steadyNanoseconds() - origin;
+}
+
+FrameProfiler::Track* FrameProfiler::addTrack(const string& name)
+{
+	auto track = make_unique<Track>();
+	track->name = name;
+	track->id = (unsigned int)tracks.size() + 1;
+	track->events.resize(EVENTS_PER_THREAD);
+	tracks.push_back(std::move(track));
+	return tracks.back().get();
+}
+
+FrameProfiler::Track* FrameProfiler::threadTrack()
+{
+	thread_local Track* track = nullptr;
+	if (track == nullptr)
+	{
+		lock_guard<mutex> guard(tracksLock);
+		track = addTrack("thread " + to_string(tracks.size() + 1));
+	}
+	return track;
+}
+
+FrameProfiler::Track* FrameProfiler::namedTrack(const char* name)
+{
+	lock_guard<mutex> guard(tracksLock);
+	for (auto& track : tracks)
+	{
+		if (track->name == name)
+			return track.get();
+	}
+	return addTrack(name);
+}
+
+void FrameProfiler::record(const char* name, uint64_t start, uint64_t end)
+{
+	threadTrack()->push({ name, start, end });
+}
+
+void FrameProfiler::nameThread(const char* name)
+{
+	Track* track = threadTrack();
+	lock_guard<mutex> guard(tracksLock);
+	track->name = name;
+}
+
+void FrameProfiler::recordOn(const char* track, const char* name, uint64_t start, uint64_t end)
+{
+	if (!enabled.load(memory_order_relaxed))
+		return;
+	namedTrack(track)->push({ name, start, end });
+}
+
+void FrameProfiler::readEvents(const Track& track, vector<ProfileEvent>& out)
+{
+	// events being overwritten while this runs can come out torn, fine for a profiler
+	uint64_t written = track.written.load(memory_order_acquire);
+	uint64_t first = written > EVENTS_PER_THREAD ? written - EVENTS_PER_THREAD : 0;
+	for (uint64_t i = first; i < written; i++)
+		out.push_back(track.events[i % EVENTS_PER_THREAD]);
+}
+
+vector<ProfileZoneStats> FrameProfiler::summary(uint64_t windowNs)
+{
+	uint64_t since = now();
+	since = since > windowNs ? since - windowNs : 0;
+	struct Totals
+	{
+		uint64_t total = 0;
+		unsigned int count = 0;
+	};
+	// by text, the same literal can have a different address in every translation unit
+	unordered_map<string_view, Totals> totals;
+	vector<ProfileEvent> events;
+	{
+		lock_guard<mutex> guard(tracksLock);
+		for (auto& track : tracks)
+			readEvents(*track, events);
+	}
+	for (const auto& event : events)
+	{
+		if (event.end < since || event.end < event.start)
+			continue;
+		Totals& zone = totals[event.name];
+		zone.total += event.end - event.start;
+		zone.count++;
+	}
+
+	vector<ProfileZoneStats> stats;
+	for (const auto& zone : totals)
+		stats.push_back({ zone.first.data(), zone.second.total / 1.0e6 / zone.second.count, zone.second.count });
+	std::sort(stats.begin(), stats.end(), [](const ProfileZoneStats& a, const ProfileZoneStats& b) { return a.averageMs > b.averageMs; });
+	return stats;
+}
+
+string FrameProfiler::summaryText(uint64_t windowNs, unsigned int maxZones)
+{
+	auto stats = summary(windowNs);
+	// zones running several times per frame (physics steps) show how often they ran per "frame" zone
+	unsigned int frames = 0;
+	for (const auto& zone : stats)
+	{
+		if (string(zone.name) == "frame")
+			frames = zone.count;
+	}
+
+	std::ostringstream text;
+	text << std::fixed << std::setprecision(2);
+	for (unsigned int i = 0; i < stats.size() && i < maxZones; i++)
+	{
+		if (i > 0)
+			text << ", ";
+		text << stats[i].name << " " << stats[i].averageMs << " ms";
+		if (frames > 0 && stats[i].count > frames)
+			text << " x" << std::setprecision(1) << (double)stats[i].count / frames << std::setprecision(2);
+	}
+	return text.str();
+}
+
+// chrome://tracing needs names JSON escaped, zone names are literals but track names aren't
+static string jsonString(const string& text)
+{
+	string out = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			out += '\\';
+		if ((unsigned char)c < 0x20)
+			continue;
+		out += c;
+	}
+	return out + "\"";
+}
+
+bool FrameProfiler::writeChromeTrace(const string& path)
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+	{
+		cout << "Could not open trace file at location: '" << path << "'." << endl;
+		return false;
+	}
+
+	file << "{\"traceEvents\":[\n";
+	file << std::fixed << std::setprecision(3);
+	bool first = true;
+	lock_guard<mutex> guard(tracksLock);
+	vector<ProfileEvent> events;
+	for (auto& track : tracks)
+	{
+		if (!first)
+			file << ",\n";
+		first = false;
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track->id
+			<< ",\"args\":{\"name\":" << jsonString(track->name) << "}}";
+
+		events.clear();
+		readEvents(*track, events);
+		for (const auto& event : events)
+		{
+			if (event.end < event.start)
+				continue;
+			// microseconds, the unit the format uses
+			file << ",\n{\"name\":" << jsonString(event.name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << track->id
+				<< ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+		}
+	}
+	file << "\n]}\n";
+	return file.good();
+}
+
+void GpuProfiler::init()
+{
+	if (initialized)
+		return;
+	for (unsigned int f = 0; f < FRAME_LATENCY; f++)
+	{
+		for (unsigned int z = 0; z < MAX_ZONES; z++)
+			glGenQueries(1, &zones[f][z].query);
+		zoneCounts[f] = 0;
+	}
+	frame = 0;
+	initialized = true;
+}
+
+void GpuProfiler::release()
+{
+	if (!initialized)
+		return;
+	for (unsigned int f = 0; f < FRAME_LATENCY; f++)
+	{
+		for (unsigned int z = 0; z < MAX_ZONES; z++)
+			glDeleteQueries(1, &zones[f][z].query);
+	}
+	initialized = false;
+}
+
+void GpuProfiler::beginFrame()
+{
+	if (!initialized)
+		return;
+	frame = (frame + 1) % FRAME_LATENCY;
+	// this slot was issued FRAME_LATENCY frames ago
+	collect(frame);
+}
+
+void GpuProfiler::collect(unsigned int frameIx)
+{
+	for (unsigned int z = 0; z < zoneCounts[frameIx]; z++)
+	{
+		Zone& zone = zones[frameIx][z];
+		GLint available = 0;
+		glGetQueryObjectiv(zone.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		// a GPU this far behind gets its sample dropped rather than stalling the frame
+		if (!available)
+			continue;
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(zone.query, GL_QUERY_RESULT, &elapsed);
+		profiler.recordOn("GPU", zone.name, zone.cpuStart, zone.cpuStart + elapsed);
+	}
+	zoneCounts[frameIx] = 0;
+}
+
+bool GpuProfiler::begin(const char* name)
+{
+	if (!initialized || active || zoneCounts[frame] == MAX_ZONES || !profiler.enabled.load(memory_order_relaxed))
+		return false;
+	Zone& zone = zones[frame][zoneCounts[frame]++];
+	zone.name = name;
+	zone.cpuStart = profiler.now();
+	glBeginQuery(GL_TIME_ELAPSED, zone.query);
+	active = true;
+	return true;
+}
+
+void GpuProfiler::end()
+{
+	if (!active)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	active = false;
+}
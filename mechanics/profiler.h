@@ -0,0 +1,166 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+using namespace std;
+
+// Lightweight frame profiler.
+//
+// PROFILE_SCOPE("name") times the rest of the enclosing block. Every thread writes its zones into
+// its own ring buffer, so recording takes no lock; only the first zone of a thread registers the
+// buffer. Zone names have to be string literals, only the pointer is kept.
+//
+// GPU work is timed by GpuProfiler with GL_TIME_ELAPSED queries and shows up on its own track.
+// writeChromeTrace dumps everything still in the buffers for chrome://tracing (or ui.perfetto.dev).
+
+struct ProfileEvent
+{
+	const char* name;
+	// nanoseconds since the profiler was created
+	uint64_t start;
+	uint64_t end;
+};
+
+// Average time per occurrence and how often a zone ran, over the window asked for
+struct ProfileZoneStats
+{
+	const char* name;
+	double averageMs;
+	unsigned int count;
+};
+
+// not just Profiler, reactphysics3d already has a class of that name
+class FrameProfiler
+{
+public:
+	// events kept per thread, older ones are overwritten
+	static const unsigned int EVENTS_PER_THREAD = 1 << 16;
+
+	// recording can be switched off at runtime, scopes then only read the flag
+	atomic<bool> enabled{ true };
+
+	FrameProfiler();
+
+	uint64_t now() const;
+
+	// records a zone for the calling thread
+	void record(const char* name, uint64_t start, uint64_t end);
+	// the name of the calling thread's track in the trace
+	void nameThread(const char* name);
+	// records on a track not tied to a thread, e.g. "GPU". Only one thread may write to each.
+	void recordOn(const char* track, const char* name, uint64_t start, uint64_t end);
+
+	// zones that ended within the last windowNs, slowest first
+	vector<ProfileZoneStats> summary(uint64_t windowNs);
+	// "frame 16.61 ms, physics step 0.52 ms x2, ..." from summary, for the live overlay
+	string summaryText(uint64_t windowNs, unsigned int maxZones = 6);
+
+	bool writeChromeTrace(const string& path);
+
+private:
+	struct Track
+	{
+		string name;
+		unsigned int id = 0;
+		vector<ProfileEvent> events;
+		// total events ever written, the ring holds the last EVENTS_PER_THREAD of them
+		atomic<uint64_t> written{ 0 };
+
+		void push(const ProfileEvent& event)
+		{
+			uint64_t n = written.load(memory_order_relaxed);
+			events[n % EVENTS_PER_THREAD] = event;
+			written.store(n + 1, memory_order_release);
+		}
+	};
+
+	uint64_t origin;
+	mutex tracksLock;
+	vector<unique_ptr<Track>> tracks;
+
+	Track* addTrack(const string& name);
+	Track* threadTrack();
+	Track* namedTrack(const char* name);
+	// copies the events a track still holds, oldest first
+	static void readEvents(const Track& track, vector<ProfileEvent>& out);
+};
+
+extern FrameProfiler profiler;
+
+// Times the enclosing scope on the calling thread
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name) : name(name), start(profiler.enabled.load(memory_order_relaxed) ? profiler.now() : 0) {}
+	~ProfileScope()
+	{
+		if (start != 0)
+			profiler.record(name, start, profiler.now());
+	}
+
+private:
+	const char* name;
+	uint64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+// Times GL work with a ring of GL_TIME_ELAPSED queries. Results are read FRAME_LATENCY frames
+// later, when the GPU is long done with them, so reading never stalls. Zones can't nest because
+// only one time elapsed query may be active at a time. GL thread only.
+class GpuProfiler
+{
+public:
+	static const unsigned int FRAME_LATENCY = 4;
+	static const unsigned int MAX_ZONES = 16;
+
+	void init();
+	void release();
+
+	// call once per frame before the first zone, collects the frame that is now old enough
+	void beginFrame();
+	// false when the zone isn't timed, e.g. inside another zone; end() must only follow a true
+	bool begin(const char* name);
+	void end();
+
+private:
+	struct Zone
+	{
+		const char* name;
+		unsigned int query;
+		// when the zone was issued, the GPU time is placed there on the trace
+		uint64_t cpuStart;
+	};
+
+	Zone zones[FRAME_LATENCY][MAX_ZONES] = {};
+	unsigned int zoneCounts[FRAME_LATENCY] = {};
+	unsigned int frame = 0;
+	bool active = false;
+	bool initialized = false;
+
+	void collect(unsigned int frameIx);
+};
+
+extern GpuProfiler gpuProfiler;
+
+class GpuProfileScope
+{
+public:
+	GpuProfileScope(const char* name) : began(gpuProfiler.begin(name)) {}
+	~GpuProfileScope()
+	{
+		if (began)
+			gpuProfiler.end();
+	}
+
+private:
+	bool began;
+};
+
+#define GPU_PROFILE_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
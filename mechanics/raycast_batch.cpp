@@ -0,0 +1,124 @@
+#include "raycast_batch.h"
+#include <algorithm>
+
+// Keeps the closest hit; returning its fraction shortens the ray, so later hits are always closer
+struct ClosestHitCallback : public RaycastCallback
+{
+	RaycastHits& hits;
+	unsigned int ix;
+
+	ClosestHitCallback(RaycastHits& hits, unsigned int ix) : hits(hits), ix(ix) {}
+
+	virtual decimal notifyRaycastHit(const RaycastInfo& info) override
+	{
+		hits.hit[ix] = 1;
+		hits.fraction[ix] = info.hitFraction;
+		hits.px[ix] = info.worldPoint.x; hits.py[ix] = info.worldPoint.y; hits.pz[ix] = info.worldPoint.z;
+		hits.nx[ix] = info.worldNormal.x; hits.ny[ix] = info.worldNormal.y; hits.nz[ix] = info.worldNormal.z;
+		hits.bodies[ix] = info.body;
+		hits.colliders[ix] = info.collider;
+		return info.hitFraction;
+	}
+};
+
+unsigned int RaycastHits::hitCount() const
+{
+	unsigned int count = 0;
+	for (auto h : hit)
+		count += h;
+	return count;
+}
+
+RaycastBatcher::~RaycastBatcher()
+{
+	stop();
+}
+
+void RaycastBatcher::start(unsigned int workerCount)
+{
+	stop();
+	stopping = false;
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers.emplace_back(&RaycastBatcher::workerLoop, this);
+}
+
+void RaycastBatcher::stop()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	workReady.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+	workers.clear();
+}
+
+void RaycastBatcher::cast(const PhysicsWorld* world, const RayBatch& batch, RaycastHits& hits)
+{
+	unsigned int count = batch.size();
+	hits.resize(count);
+	unsigned int chunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	// waking the workers isn't worth it for a couple of chunks
+	if (workers.empty() || chunks < 2)
+	{
+		castRange(world, batch, hits, 0, count);
+		return;
+	}
+
+	{
+		lock_guard<mutex> guard(lock);
+		this->world = world;
+		this->batch = &batch;
+		this->hits = &hits;
+		chunkCount = chunks;
+		nextChunk.store(0, memory_order_relaxed);
+		busyWorkers = (unsigned int)workers.size();
+		generation++;
+	}
+	workReady.notify_all();
+	runChunks();
+
+	unique_lock<mutex> guard(lock);
+	workDone.wait(guard, [this] { return busyWorkers == 0; });
+}
+
+void RaycastBatcher::workerLoop()
+{
+	unsigned int seen = 0;
+	unique_lock<mutex> guard(lock);
+	while (true)
+	{
+		workReady.wait(guard, [&] { return stopping || generation != seen; });
+		if (stopping)
+			return;
+		seen = generation;
+		guard.unlock();
+		runChunks();
+		guard.lock();
+		if (--busyWorkers == 0)
+			workDone.notify_one();
+	}
+}
+
+void RaycastBatcher::runChunks()
+{
+	unsigned int count = batch->size();
+	while (true)
+	{
+		unsigned int chunk = nextChunk.fetch_add(1, memory_order_relaxed);
+		if (chunk >= chunkCount)
+			return;
+		unsigned int begin = chunk * CHUNK_SIZE;
+		castRange(world, *batch, *hits, begin, std::min(begin + CHUNK_SIZE, count));
+	}
+}
+
+void RaycastBatcher::castRange(const PhysicsWorld* world, const RayBatch& batch, RaycastHits& hits, unsigned int begin, unsigned int end)
+{
+	for (unsigned int i = begin; i < end; i++)
+	{
+		ClosestHitCallback callback(hits, i);
+		world->raycast(batch.rays[i], &callback, batch.masks[i]);
+	}
+}
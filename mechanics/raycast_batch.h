@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <reactphysics3d/reactphysics3d.h>
+
+using namespace std;
+using namespace reactphysics3d;
+
+// Rays to cast together, each with the CollisionCategories it may hit
+struct RayBatch
+{
+	vector<Ray> rays;
+	vector<unsigned short> masks;
+
+	void clear()
+	{
+		rays.clear();
+		masks.clear();
+	}
+
+	void add(const Vector3& from, const Vector3& to, unsigned short categoryMask = 0xFFFF)
+	{
+		rays.emplace_back(from, to);
+		masks.push_back(categoryMask);
+	}
+
+	unsigned int size() const { return (unsigned int)rays.size(); }
+};
+
+// The closest hit of every ray, one array per field. Fields of rays that missed are left as they were.
+struct RaycastHits
+{
+	vector<uint8_t> hit;
+	// between 0 at the ray start and 1 at its end
+	vector<float> fraction;
+	vector<float> px, py, pz;
+	vector<float> nx, ny, nz;
+	vector<CollisionBody*> bodies;
+	vector<Collider*> colliders;
+
+	void resize(unsigned int count)
+	{
+		hit.assign(count, 0);
+		fraction.resize(count);
+		px.resize(count); py.resize(count); pz.resize(count);
+		nx.resize(count); ny.resize(count); nz.resize(count);
+		bodies.resize(count);
+		colliders.resize(count);
+	}
+
+	unsigned int hitCount() const;
+};
+
+// Answers a RayBatch through PhysicsWorld::raycast, i.e. the broad-phase AABB tree, spread over
+// a few worker threads plus the calling one. Raycasting only reads the world, so a batch may run
+// whenever the world isn't being stepped (on the physics thread between steps, or on the render
+// thread between PhysicsPipeline::wait and submit).
+class RaycastBatcher
+{
+public:
+	// rays handed out per grab, small enough to balance, large enough to keep the counter cold
+	static const unsigned int CHUNK_SIZE = 256;
+
+	RaycastBatcher() = default;
+	RaycastBatcher(const RaycastBatcher&) = delete;
+	RaycastBatcher& operator=(const RaycastBatcher&) = delete;
+	~RaycastBatcher();
+
+	// 0 workers casts everything on the calling thread
+	void start(unsigned int workerCount);
+	void stop();
+
+	void cast(const PhysicsWorld* world, const RayBatch& batch, RaycastHits& hits);
+
+	unsigned int workerCount() const { return (unsigned int)workers.size(); }
+
+private:
+	vector<thread> workers;
+	mutex lock;
+	condition_variable workReady;
+	condition_variable workDone;
+	bool stopping = false;
+	// bumped per batch, workers run once for every value they haven't seen
+	unsigned int generation = 0;
+	unsigned int busyWorkers = 0;
+
+	const PhysicsWorld* world = nullptr;
+	const RayBatch* batch = nullptr;
+	RaycastHits* hits = nullptr;
+	unsigned int chunkCount = 0;
+	atomic<unsigned int> nextChunk{ 0 };
+
+	void workerLoop();
+	void runChunks();
+	static void castRange(const PhysicsWorld* world, const RayBatch& batch, RaycastHits& hits, unsigned int begin, unsigned int end);
+};
@@ -0,0 +1,263 @@
+#include "render_bvh.h"
+#include "model.h"
+#include <algorithm>
+
+int RenderBvh::allocateNode()
+{
+	if (freeList == NULL_NODE)
+	{
+		nodes.emplace_back();
+		return (int)nodes.size() - 1;
+	}
+	int ix = freeList;
+	freeList = nodes[ix].parent;
+	nodes[ix] = Node();
+	return ix;
+}
+
+void RenderBvh::freeNode(int ix)
+{
+	nodes[ix].parent = freeList;
+	nodes[ix].height = -1;
+	freeList = ix;
+}
+
+int RenderBvh::insert(const Aabb& box, EntityId entity)
+{
+	int leaf = allocateNode();
+	nodes[leaf].box = box.grown(FAT_MARGIN * glm::length(box.extents()));
+	nodes[leaf].entity = entity;
+	nodes[leaf].height = 0;
+	insertLeaf(leaf);
+	return leaf;
+}
+
+void RenderBvh::remove(int proxy)
+{
+	removeLeaf(proxy);
+	freeNode(proxy);
+}
+
+bool RenderBvh::move(int proxy, const Aabb& box)
+{
+	if (nodes[proxy].box.contains(box))
+		return false;
+	removeLeaf(proxy);
+	nodes[proxy].box = box.grown(FAT_MARGIN * glm::length(box.extents()));
+	insertLeaf(proxy);
+	return true;
+}
+
+void RenderBvh::clear()
+{
+	nodes.clear();
+	root = NULL_NODE;
+	freeList = NULL_NODE;
+}
+
+void RenderBvh::insertLeaf(int leaf)
+{
+	if (root == NULL_NODE)
+	{
+		root = leaf;
+		nodes[root].parent = NULL_NODE;
+		return;
+	}
+
+	// find the sibling that grows the tree's surface area the least
+	Aabb leafBox = nodes[leaf].box;
+	int ix = root;
+	while (!nodes[ix].isLeaf())
+	{
+		int child1 = nodes[ix].child1;
+		int child2 = nodes[ix].child2;
+		float area = nodes[ix].box.halfArea();
+		float combinedArea = Aabb::merge(nodes[ix].box, leafBox).halfArea();
+		// making a new parent for this node and the leaf
+		float cost = 2.0f * combinedArea;
+		// pushing the leaf further down adds the growth of this node to every level below
+		float inheritance = 2.0f * (combinedArea - area);
+
+		auto descendCost = [&](int child)
+		{
+			Aabb merged = Aabb::merge(leafBox, nodes[child].box);
+			if (nodes[child].isLeaf())
+				return merged.halfArea() + inheritance;
+			return merged.halfArea() - nodes[child].box.halfArea() + inheritance;
+		};
+		float cost1 = descendCost(child1);
+		float cost2 = descendCost(child2);
+		if (cost < cost1 && cost < cost2)
+			break;
+		ix = cost1 < cost2 ? child1 : child2;
+	}
+
+	int sibling = ix;
+	int oldParent = nodes[sibling].parent;
+	int newParent = allocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].box = Aabb::merge(leafBox, nodes[sibling].box);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	if (oldParent == NULL_NODE)
+		root = newParent;
+	else if (nodes[oldParent].child1 == sibling)
+		nodes[oldParent].child1 = newParent;
+	else
+		nodes[oldParent].child2 = newParent;
+
+	refitUpwards(nodes[leaf].parent);
+}
+
+void RenderBvh::removeLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = NULL_NODE;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+	if (grandParent == NULL_NODE)
+	{
+		root = sibling;
+		nodes[sibling].parent = NULL_NODE;
+		freeNode(parent);
+		return;
+	}
+
+	// the sibling takes the parent's place
+	if (nodes[grandParent].child1 == parent)
+		nodes[grandParent].child1 = sibling;
+	else
+		nodes[grandParent].child2 = sibling;
+	nodes[sibling].parent = grandParent;
+	freeNode(parent);
+	refitUpwards(grandParent);
+}
+
+void RenderBvh::refitUpwards(int ix)
+{
+	while (ix != NULL_NODE)
+	{
+		ix = balance(ix);
+		int child1 = nodes[ix].child1;
+		int child2 = nodes[ix].child2;
+		nodes[ix].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+		nodes[ix].box = Aabb::merge(nodes[child1].box, nodes[child2].box);
+		ix = nodes[ix].parent;
+	}
+}
+
+// Rotates the taller child up when the children's heights differ by more than one. Returns the
+// node that now sits where ix was.
+int RenderBvh::balance(int a)
+{
+	Node& nodeA = nodes[a];
+	if (nodeA.isLeaf() || nodeA.height < 2)
+		return a;
+
+	int b = nodeA.child1;
+	int c = nodeA.child2;
+	int diff = nodes[c].height - nodes[b].height;
+	if (diff >= -1 && diff <= 1)
+		return a;
+
+	// promote the taller child, up becomes the parent of a
+	int up = diff > 1 ? c : b;
+	int upChild1 = nodes[up].child1;
+	int upChild2 = nodes[up].child2;
+
+	nodes[up].child1 = a;
+	nodes[up].parent = nodes[a].parent;
+	nodes[a].parent = up;
+	if (nodes[up].parent == NULL_NODE)
+		root = up;
+	else if (nodes[nodes[up].parent].child1 == a)
+		nodes[nodes[up].parent].child1 = up;
+	else
+		nodes[nodes[up].parent].child2 = up;
+
+	// the taller grandchild stays under up, the shorter one moves down to a
+	int keep = nodes[upChild1].height > nodes[upChild2].height ? upChild1 : upChild2;
+	int give = keep == upChild1 ? upChild2 : upChild1;
+	nodes[up].child2 = keep;
+	if (diff > 1)
+		nodes[a].child2 = give;
+	else
+		nodes[a].child1 = give;
+	nodes[give].parent = a;
+
+	nodes[a].box = Aabb::merge(nodes[nodes[a].child1].box, nodes[nodes[a].child2].box);
+	nodes[a].height = 1 + std::max(nodes[nodes[a].child1].height, nodes[nodes[a].child2].height);
+	nodes[up].box = Aabb::merge(nodes[a].box, nodes[keep].box);
+	nodes[up].height = 1 + std::max(nodes[a].height, nodes[keep].height);
+	return up;
+}
+
+Aabb FrustumCuller::worldBounds(const Aabb& local, const Transform& transform)
+{
+	const Vector3& position = transform.getPosition();
+	const Quaternion& orientation = transform.getOrientation();
+	return local.transformed(glm::vec3(position.x, position.y, position.z),
+		glm::quat(orientation.w, orientation.x, orientation.y, orientation.z));
+}
+
+void FrustumCuller::build(EntityStore& store)
+{
+	tree.clear();
+	entries.clear();
+	store.eachRenderable([&](EntityId entity, Transform& transform, RenderComponent& render)
+	{
+		if (render.model == nullptr || !render.model->bounds.valid())
+			return;
+		Entry entry;
+		entry.localBounds = render.model->bounds;
+		entry.fitted = transform;
+		entry.worldBox = worldBounds(entry.localBounds, transform);
+		entry.proxy = tree.insert(entry.worldBox, entity);
+		entries.add(entity, entry);
+	});
+}
+
+void FrustumCuller::update(EntityStore& store)
+{
+	for (unsigned int i = 0; i < entries.size(); i++)
+	{
+		Entry& entry = entries.at(i);
+		const Transform& transform = store.transforms.get(entries.entity(i));
+		if (transform == entry.fitted)
+			continue;
+		entry.fitted = transform;
+		entry.worldBox = worldBounds(entry.localBounds, transform);
+		tree.move(entry.proxy, entry.worldBox);
+	}
+}
+
+void FrustumCuller::cull(const Frustum& frustum, OcclusionBuffer* occlusion)
+{
+	frame++;
+	unsigned int drawn = 0;
+	unsigned int occluded = 0;
+	stats.tested = tree.query(frustum, [&](int proxy)
+	{
+		Entry& entry = entries.get(tree.entity(proxy));
+		// the fat leaf box only passed the frustum, the occlusion test gets the tight one
+		if (occlusion != nullptr && !occlusion->isVisible(entry.worldBox))
+		{
+			occluded++;
+			return;
+		}
+		entry.visibleFrame = frame;
+		drawn++;
+	});
+	stats.entries = entries.size();
+	stats.drawn = drawn;
+	stats.occluded = occluded;
+	stats.culled = stats.entries - drawn;
+}
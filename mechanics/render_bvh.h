@@ -0,0 +1,163 @@
+#pragma once
+#include <vector>
+#include "bounds.h"
+#include "entity_store.h"
+#include "occlusion_buffer.h"
+
+using namespace std;
+
+// Dynamic AABB tree over the render entities. Leaves store fattened boxes so an entity that only
+// moves a little stays in its leaf; only one that leaves its fat box is taken out and reinserted.
+// Insertion picks the sibling by surface area and the tree is kept balanced with rotations, the
+// same scheme the physics broad-phase uses.
+class RenderBvh
+{
+public:
+	static const int NULL_NODE = -1;
+
+	// returns the proxy of the new leaf
+	int insert(const Aabb& box, EntityId entity);
+	void remove(int proxy);
+	// false when the box still fits the leaf and nothing changed
+	bool move(int proxy, const Aabb& box);
+	void clear();
+
+	EntityId entity(int proxy) const { return nodes[proxy].entity; }
+	const Aabb& fatBounds(int proxy) const { return nodes[proxy].box; }
+	int height() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+
+	// calls visit(proxy) for every leaf that may be inside the frustum, returns the nodes tested
+	template<typename Visit>
+	unsigned int query(const Frustum& frustum, Visit visit) const
+	{
+		unsigned int tested = 0;
+		if (root == NULL_NODE)
+			return tested;
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			int ix = stack.back();
+			stack.pop_back();
+			const Node& node = nodes[ix];
+			tested++;
+			FrustumTest result = frustum.test(node.box);
+			if (result == FrustumTest::Outside)
+				continue;
+			if (node.isLeaf())
+				visit(ix);
+			else if (result == FrustumTest::Inside)
+				visitLeaves(ix, visit);
+			else
+			{
+				stack.push_back(node.child1);
+				stack.push_back(node.child2);
+			}
+		}
+		return tested;
+	}
+
+private:
+	struct Node
+	{
+		Aabb box;
+		// the next free node while on the free list
+		int parent = NULL_NODE;
+		int child1 = NULL_NODE;
+		int child2 = NULL_NODE;
+		// leaves are 0, free nodes -1
+		int height = -1;
+		EntityId entity = NULL_ENTITY;
+
+		bool isLeaf() const { return child1 == NULL_NODE; }
+	};
+
+	// grows the leaf boxes so small moves don't touch the tree
+	static constexpr float FAT_MARGIN = 0.1f;
+
+	vector<Node> nodes;
+	int root = NULL_NODE;
+	int freeList = NULL_NODE;
+	mutable vector<int> stack;
+
+	int allocateNode();
+	void freeNode(int ix);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	int balance(int ix);
+	// walks up from ix refitting boxes and heights, balancing on the way
+	void refitUpwards(int ix);
+
+	// a subtree entirely inside the frustum, its leaves are visible without more tests
+	template<typename Visit>
+	void visitLeaves(int ix, Visit& visit) const
+	{
+		size_t base = stack.size();
+		stack.push_back(ix);
+		while (stack.size() > base)
+		{
+			int current = stack.back();
+			stack.pop_back();
+			const Node& node = nodes[current];
+			if (node.isLeaf())
+				visit(current);
+			else
+			{
+				stack.push_back(node.child1);
+				stack.push_back(node.child2);
+			}
+		}
+	}
+};
+
+// What the last cull did, for the overlay
+struct CullStats
+{
+	unsigned int entries = 0;
+	// tree nodes tested against the frustum
+	unsigned int tested = 0;
+	unsigned int culled = 0;
+	// in the frustum but behind an occluder, counted in culled too
+	unsigned int occluded = 0;
+	unsigned int drawn = 0;
+};
+
+// Keeps a RenderBvh in sync with the renderable entities and marks which are in view
+class FrustumCuller
+{
+public:
+	CullStats stats;
+
+	// one leaf per entity with a transform and a model. Call again whenever entities are added,
+	// removed or change model, together with InstancedRenderer::build.
+	void build(EntityStore& store);
+	// moves the leaves of entities whose transform changed since the last update
+	void update(EntityStore& store);
+	// entities in the frustum are also tested against the occlusion buffer when one is given,
+	// after its occluders have been rasterized for the same camera
+	void cull(const Frustum& frustum, OcclusionBuffer* occlusion = nullptr);
+
+	bool isVisible(EntityId entity) const
+	{
+		const Entry* entry = entries.find(entity);
+		return entry == nullptr || entry->visibleFrame == frame;
+	}
+
+private:
+	struct Entry
+	{
+		int proxy = RenderBvh::NULL_NODE;
+		// model space bounds of the model
+		Aabb localBounds;
+		// the transform the leaf was last fitted to, and the exact world bounds for it
+		Transform fitted;
+		Aabb worldBox;
+		unsigned int visibleFrame = 0;
+	};
+
+	RenderBvh tree;
+	ComponentPool<Entry> entries;
+	unsigned int frame = 0;
+
+	static Aabb worldBounds(const Aabb& local, const Transform& transform);
+};
@@ -0,0 +1,89 @@
+#include "render_queue.h"
+#include <algorithm>
+
+static const unsigned int SHADER_BITS = 6;
+static const unsigned int ID_BITS = 16;
+static const unsigned int DEPTH_BITS = 24;
+
+static unsigned int nextId(size_t count, unsigned int bits)
+{
+	return (unsigned int)std::min<size_t>(count, (1u << bits) - 1);
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, unsigned int shader, unsigned int material, unsigned int mesh, unsigned int depth)
+{
+	uint64_t key = (uint64_t)pass << 62;
+	if (pass == RenderPass::Transparent)
+	{
+		// farthest first
+		uint64_t inverted = ((1u << DEPTH_BITS) - 1) - depth;
+		return key | inverted << 38 | (uint64_t)shader << 32 | (uint64_t)material << 16 | mesh;
+	}
+	return key | (uint64_t)shader << 56 | (uint64_t)material << 40 | (uint64_t)mesh << 24 | depth;
+}
+
+unsigned int RenderQueue::shaderId(const Shader& shader)
+{
+	auto it = shaderIds.find(shader.ID);
+	if (it == shaderIds.end())
+		it = shaderIds.emplace(shader.ID, nextId(shaderIds.size(), SHADER_BITS)).first;
+	return it->second;
+}
+
+const RenderQueue::MeshIds& RenderQueue::idsOf(const Mesh& mesh)
+{
+	auto it = meshIds.find(&mesh);
+	if (it != meshIds.end())
+		return it->second;
+	// meshes bound to the same textures in the same units share a material
+	string textures;
+	for (const auto& texture : mesh.textures)
+		textures += to_string(texture.id) + ",";
+	auto material = materialIds.find(textures);
+	if (material == materialIds.end())
+		material = materialIds.emplace(textures, nextId(materialIds.size(), ID_BITS)).first;
+	MeshIds ids = { material->second, nextId(meshIds.size(), ID_BITS) };
+	return meshIds.emplace(&mesh, ids).first->second;
+}
+
+void RenderQueue::submit(RenderPass pass, Shader& shader, Mesh& mesh, unsigned int lod,
+	unsigned int instanceVBO, unsigned int firstInstance, unsigned int instanceCount, float depth)
+{
+	if (instanceCount == 0)
+		return;
+	const MeshIds& ids = idsOf(mesh);
+	float fraction = std::min(std::max(depth / maxDepth, 0.0f), 1.0f);
+	unsigned int quantizedDepth = (unsigned int)(fraction * ((1u << DEPTH_BITS) - 1));
+	uint64_t key = makeKey(pass, shaderId(shader), ids.material, ids.mesh, quantizedDepth);
+	packets.push_back({ key, &shader, &mesh, lod, instanceVBO, firstInstance, instanceCount });
+}
+
+void RenderQueue::execute()
+{
+	std::sort(packets.begin(), packets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+
+	// whatever ran before the queue changed state behind the cache's back
+	state.reset();
+	for (const DrawPacket& packet : packets)
+	{
+		state.useProgram(packet.shader->ID);
+		packet.mesh->bindInstances(packet.instanceVBO, packet.firstInstance, state);
+		packet.mesh->bindMaterial(*packet.shader, state);
+		packet.mesh->drawInstances(packet.instanceCount, packet.lod);
+	}
+	drawCalls = (unsigned int)packets.size();
+	stats = state.stats;
+	packets.clear();
+
+	state.activeTexture(0);
+	state.bindVertexArray(0);
+	state.bindArrayBuffer(0);
+}
+
+void RenderQueue::clear()
+{
+	packets.clear();
+	shaderIds.clear();
+	meshIds.clear();
+	materialIds.clear();
+}
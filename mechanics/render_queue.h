@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include "mesh.h"
+#include "shader.h"
+#include "gl_state.h"
+
+using namespace std;
+
+// Passes run in this order, the key's top bits
+enum class RenderPass : uint32_t
+{
+	Opaque = 0,
+	Transparent = 1
+};
+
+// One instanced draw of a mesh, collected during the frame and drawn by RenderQueue::execute
+struct DrawPacket
+{
+	uint64_t key;
+	Shader* shader;
+	Mesh* mesh;
+	unsigned int lod;
+	unsigned int instanceVBO;
+	unsigned int firstInstance;
+	unsigned int instanceCount;
+};
+
+// Collects the frame's draws and issues them sorted by a 64 bit key so draws sharing a program,
+// textures and vertex array end up next to each other, and the GL calls they have in common are
+// only made once through a GlStateCache.
+//
+// Opaque keys are pass (2 bits), shader (6), material (16), mesh (16) and depth front to back (24),
+// so state changes come first and depth only orders the draws of one mesh. Transparent keys put
+// depth back to front right after the pass, blending needs that order more than fewer state changes.
+class RenderQueue
+{
+public:
+	// depth in the key is distance from the camera as a fraction of this, usually the far plane
+	float maxDepth = 1000.0f;
+
+	// the last execute's GL calls and draws
+	GlStateStats stats;
+	unsigned int drawCalls = 0;
+
+	void submit(RenderPass pass, Shader& shader, Mesh& mesh, unsigned int lod,
+		unsigned int instanceVBO, unsigned int firstInstance, unsigned int instanceCount, float depth);
+
+	// sorts and draws everything submitted since the last execute. Leaves texture unit 0 active
+	// and no vertex array bound.
+	void execute();
+
+	// forgets the ids of shaders and meshes, e.g. after a scene reload
+	void clear();
+
+	static uint64_t makeKey(RenderPass pass, unsigned int shader, unsigned int material, unsigned int mesh, unsigned int depth);
+
+private:
+	struct MeshIds
+	{
+		unsigned int material;
+		unsigned int mesh;
+	};
+
+	vector<DrawPacket> packets;
+	GlStateCache state;
+	// compact ids for the key, they only steer the order so running out just groups less
+	unordered_map<unsigned int, unsigned int> shaderIds;
+	unordered_map<const Mesh*, MeshIds> meshIds;
+	unordered_map<string, unsigned int> materialIds;
+
+	unsigned int shaderId(const Shader& shader);
+	const MeshIds& idsOf(const Mesh& mesh);
+};
@@ -7,10 +7,20 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "uniform_buffers.h"
 
+// A uniform location resolved once up front, so setting it needs no string lookup.
+// An invalid handle (location -1) is silently ignored by glUniform*, same as a missing name.
+struct UniformHandle
+{
+    int location = -1;
+
+    bool valid() const { return location != -1; }
+};
 
 class Shader
 {
@@ -71,6 +81,8 @@ public:
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
+        reflectUniforms();
+        bindUniformBlocks();
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -78,39 +90,114 @@ public:
     { 
         glUseProgram(ID); 
     }
+    // looks up a uniform reflected at link time. Resolve handles once, outside of draw loops.
+    // ------------------------------------------------------------------------
+    UniformHandle uniform(const std::string &name) const
+    {
+        UniformHandle handle;
+        auto it = uniformLocations.find(name);
+        if (it != uniformLocations.end())
+            handle.location = it->second;
+        return handle;
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        setBool(uniform(name), value);
+    }
+    void setBool(UniformHandle handle, bool value) const
+    {
+        glUniform1i(handle.location, (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        setInt(uniform(name), value);
+    }
+    void setInt(UniformHandle handle, int value) const
+    {
+        glUniform1i(handle.location, value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        setFloat(uniform(name), value);
+    }
+    void setFloat(UniformHandle handle, float value) const
+    {
+        glUniform1f(handle.location, value);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, glm::mat4 value) const
+    void setMat4(const std::string &name, const glm::mat4 &value) const
     { 
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+        setMat4(uniform(name), value);
+    }
+    void setMat4(UniformHandle handle, const glm::mat4 &value) const
+    {
+        glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(value));
     }
+    // ------------------------------------------------------------------------
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        // TODO: Not sure if this works
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(glm::vec3(x, y, z)));
+        setVec3(uniform(name), glm::vec3(x, y, z));
+    }
+    void setVec3(const std::string& name, const glm::vec3 &value) const
+    {
+        setVec3(uniform(name), value);
     }
-    void setVec3(const std::string& name, glm::vec3 value) const
+    void setVec3(UniformHandle handle, const glm::vec3 &value) const
     {
-        // TODO: Not sure if this works
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+        glUniform3fv(handle.location, 1, glm::value_ptr(value));
     }
 
 private:
+    // active uniforms of the linked program, by the name GLSL knows them as
+    std::unordered_map<std::string, int> uniformLocations;
+
+    // asks the driver for every active uniform once so the setters never have to.
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        int count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string name(maxLength, '\0');
+        for (int i = 0; i < count; i++)
+        {
+            int length = 0, size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, (GLuint)i, maxLength, &length, &size, &type, &name[0]);
+            std::string uniformName = name.substr(0, length);
+            uniformLocations[uniformName] = glGetUniformLocation(ID, uniformName.c_str());
+
+            // arrays of basic types are only reported as "name[0]", register every element and the bare name too
+            auto bracket = uniformName.rfind("[0]");
+            if (bracket != std::string::npos && bracket + 3 == uniformName.size())
+            {
+                std::string base = uniformName.substr(0, bracket);
+                uniformLocations[base] = uniformLocations[uniformName];
+                for (int element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+        }
+    }
+
+    // attaches the shared uniform blocks this program declares to their binding points
+    // ------------------------------------------------------------------------
+    void bindUniformBlocks()
+    {
+        for (const auto& block : UNIFORM_BLOCKS)
+        {
+            unsigned int index = glGetUniformBlockIndex(ID, block.name);
+            if (index != GL_INVALID_INDEX)
+                glUniformBlockBinding(ID, index, block.binding);
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(unsigned int shader, std::string type)
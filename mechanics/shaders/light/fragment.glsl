@@ -19,15 +19,14 @@ struct DirLight {
     vec3 specular;
 };
 
+// members are ordered to pack into the std140 layout mirrored by PointLightData in uniform_buffers.h
 struct PointLight {    
     vec3 position;
-    
     float constant;
-    float linear;
-    float quadratic;  
-
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
 };  
 
@@ -49,11 +48,21 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);  
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 FragPos, vec3 viewDir);
 
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+layout (std140) uniform Lights
+{
+    DirLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+};
+
 uniform SpotLight spotLight;
 uniform Material material;
-uniform vec3 viewPos;
 
 void main()
 {
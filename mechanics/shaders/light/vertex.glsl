@@ -1,20 +1,42 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+// xy only for octahedral normals
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// per-instance model matrix, takes up locations 3 to 6
+layout (location = 3) in mat4 aInstanceModel;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+// quantized meshes store positions as fractions of their bounds, float meshes get offset 0 and scale 1
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform bool octNormals;
 
 out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoords;
 
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    mat4 model = aInstanceModel;
+    vec3 position = positionOffset + aPos * positionScale;
+    vec3 normal = octNormals ? octDecode(aNormal.xy) : aNormal;
+    gl_Position = projection * view * model * vec4(position, 1.0);
+    Normal = mat3(transpose(inverse(model))) * normal;
+    FragPos = vec3(model * vec4(position, 1.0));
     TexCoords = aTexCoords;
 }
\ No newline at end of file
@@ -2,10 +2,12 @@
 #include <string>
 #include <map>
 #include <vector>
-#include <glad\glad.h>
+#include <glad/glad.h>
 #include "stb_image.h"
 #include <iostream>
 #include "shader.h"
+#include "texture_loader.h"
+#include "baked_texture.h"
 
 using namespace std;
 
@@ -16,7 +18,8 @@ struct Skybox
 
 	unsigned int VAO, VBO, cubemapTexture;
 
-	void init(vector<std::string> faces)
+	// with a loader the faces are decoded in parallel on its workers and the sky stays black until they're uploaded
+	void init(vector<std::string> faces, TextureLoader* loader = nullptr)
 	{
 		glGenVertexArrays(1, &VAO);
 		glGenBuffers(1, &VBO);
@@ -30,11 +33,17 @@ struct Skybox
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
-		cubemapTexture = loadCubemap(faces);
+		if (loader != nullptr)
+			cubemapTexture = loader->loadCubemap(faces);
+		else
+			cubemapTexture = loadCubemap(faces);
 	}
 
 	static unsigned int loadCubemap(vector<std::string> faces)
 	{
+		if (unsigned int baked = loadBakedCubemap(faces))
+			return baked;
+
 		stbi_set_flip_vertically_on_load(false);
 		unsigned int textureID;
 		glGenTextures(1, &textureID);
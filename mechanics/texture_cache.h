@@ -0,0 +1,81 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <filesystem>
+#include "texture_loader.h"
+
+using namespace std;
+
+unsigned int TextureFromFile(const char* path, const string& directory, bool gamma);
+
+// A GL texture shared by every mesh using the same image file, deleted with its last reference
+struct SharedTexture
+{
+	unsigned int id = 0;
+	string path;
+
+	~SharedTexture()
+	{
+		glDeleteTextures(1, &id);
+	}
+};
+
+// Hands out one texture per image file across all models, keyed by the canonical file path
+class TextureCache
+{
+public:
+	// when set, images are decoded on its worker threads and show a placeholder until uploaded
+	TextureLoader* loader = nullptr;
+
+	// resolves the path the same way TextureFromFile does: as given first, then relative to directory
+	shared_ptr<SharedTexture> load(const string& path, const string& directory)
+	{
+		string resolved = path;
+		std::error_code ec;
+		if (!std::filesystem::exists(resolved, ec))
+			resolved = directory + '/' + path;
+		string key = canonicalPath(resolved);
+
+		auto it = textures.find(key);
+		if (it != textures.end())
+		{
+			if (auto texture = it->second.lock())
+				return texture;
+		}
+
+		auto texture = make_shared<SharedTexture>();
+		if (loader != nullptr)
+			texture->id = loader->load2D(resolved);
+		else
+			texture->id = TextureFromFile(resolved.c_str(), directory, false);
+		texture->path = key;
+		textures[key] = texture;
+		return texture;
+	}
+
+	// number of textures still referenced by at least one model
+	unsigned int liveCount() const
+	{
+		unsigned int count = 0;
+		for (const auto& entry : textures)
+		{
+			if (!entry.second.expired())
+				count++;
+		}
+		return count;
+	}
+
+	static string canonicalPath(const string& path)
+	{
+		std::error_code ec;
+		auto canonical = std::filesystem::weakly_canonical(std::filesystem::path(path), ec);
+		if (ec)
+			return path;
+		return canonical.generic_string();
+	}
+
+private:
+	unordered_map<string, weak_ptr<SharedTexture>> textures;
+};
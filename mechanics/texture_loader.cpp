@@ -0,0 +1,296 @@
+#include "texture_loader.h"
+#include "stb_image.h"
+#include "baked_texture.h"
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+
+static GLenum formatForComponents(int components)
+{
+	switch (components)
+	{
+	case 1: return GL_RED;
+	case 2: return GL_RG;
+	case 3: return GL_RGB;
+	default: return GL_RGBA;
+	}
+}
+
+TextureLoader::~TextureLoader()
+{
+	// GL objects can't be freed here, the context is usually gone by now
+	stopWorkers();
+}
+
+void TextureLoader::start(unsigned int threadCount)
+{
+	if (!workers.empty())
+		return;
+	if (threadCount == 0)
+	{
+		unsigned int hardwareThreads = thread::hardware_concurrency();
+		// leave one core for the render thread
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	stopping = false;
+	for (unsigned int i = 0; i < threadCount; i++)
+		workers.emplace_back(&TextureLoader::workerLoop, this);
+}
+
+void TextureLoader::release()
+{
+	stopWorkers();
+	if (pbos[0] != 0)
+	{
+		glDeleteBuffers(PBO_COUNT, pbos);
+		memset(pbos, 0, sizeof(pbos));
+	}
+}
+
+void TextureLoader::stopWorkers()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	jobAvailable.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+	workers.clear();
+
+	// anything left over keeps its placeholder
+	for (auto& request : ready)
+		freeImages(*request);
+	jobs.clear();
+	ready.clear();
+	inFlight = 0;
+}
+
+unsigned int TextureLoader::load2D(const string& path, bool flipVertically)
+{
+	// baked textures need no decoding, they go straight up from the mapped file
+	if (!flipVertically)
+	{
+		if (unsigned int baked = loadBakedTexture(path))
+			return baked;
+	}
+
+	unsigned int textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// no mipmaps until the real image arrives
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	auto request = make_shared<Request>();
+	request->texture = textureID;
+	request->target = GL_TEXTURE_2D;
+	request->flipVertically = flipVertically;
+	request->images.resize(1);
+	request->images[0].path = path;
+	queue(request);
+	return textureID;
+}
+
+unsigned int TextureLoader::loadCubemap(const vector<string>& faces)
+{
+	if (unsigned int baked = loadBakedCubemap(faces))
+		return baked;
+
+	unsigned int textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+	const unsigned char placeholder[4] = { 0, 0, 0, 255 };
+	for (unsigned int i = 0; i < 6; i++)
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+	auto request = make_shared<Request>();
+	request->texture = textureID;
+	request->target = GL_TEXTURE_CUBE_MAP;
+	request->images.resize(faces.size() < 6 ? faces.size() : 6);
+	for (unsigned int i = 0; i < request->images.size(); i++)
+		request->images[i].path = faces[i];
+	queue(request);
+	return textureID;
+}
+
+void TextureLoader::queue(const shared_ptr<Request>& request)
+{
+	start();
+	{
+		lock_guard<mutex> guard(lock);
+		request->remaining = (unsigned int)request->images.size();
+		for (unsigned int i = 0; i < request->images.size(); i++)
+			jobs.push_back({ request, i });
+		inFlight++;
+	}
+	jobAvailable.notify_all();
+}
+
+void TextureLoader::workerLoop()
+{
+	while (true)
+	{
+		Job job;
+		{
+			unique_lock<mutex> guard(lock);
+			jobAvailable.wait(guard, [this] { return stopping || !jobs.empty(); });
+			if (stopping)
+				return;
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		Request& request = *job.request;
+		Image& image = request.images[job.image];
+		// the flip flag is per thread so workers never race on stb_image's global one
+		stbi_set_flip_vertically_on_load_thread(request.flipVertically);
+		int width, height, components;
+		unsigned char* pixels = stbi_load(image.path.c_str(), &width, &height, &components, 0);
+		if (!pixels)
+			cout << "Texture failed to load at path: " << image.path << endl;
+
+		lock_guard<mutex> guard(lock);
+		image.pixels = pixels;
+		image.width = width;
+		image.height = height;
+		image.components = components;
+		if (--request.remaining == 0)
+		{
+			ready.push_back(job.request);
+			requestReady.notify_all();
+		}
+	}
+}
+
+unsigned int TextureLoader::processUploads(size_t byteBudget)
+{
+	unsigned int uploaded = 0;
+	size_t bytes = 0;
+	while (bytes < byteBudget)
+	{
+		shared_ptr<Request> request;
+		{
+			lock_guard<mutex> guard(lock);
+			if (ready.empty())
+				break;
+			request = ready.front();
+			ready.pop_front();
+		}
+
+		bytes += upload(*request);
+		uploaded++;
+
+		lock_guard<mutex> guard(lock);
+		inFlight--;
+	}
+	return uploaded;
+}
+
+void TextureLoader::finish()
+{
+	while (true)
+	{
+		processUploads(SIZE_MAX);
+		unique_lock<mutex> guard(lock);
+		if (inFlight == 0)
+			return;
+		requestReady.wait(guard, [this] { return !ready.empty() || inFlight == 0; });
+	}
+}
+
+unsigned int TextureLoader::pending() const
+{
+	lock_guard<mutex> guard(lock);
+	return inFlight;
+}
+
+size_t TextureLoader::upload(Request& request)
+{
+	size_t total = 0;
+	for (const auto& image : request.images)
+	{
+		if (image.pixels)
+			total += (size_t)image.width * image.height * image.components;
+	}
+	// nothing decoded keeps the placeholder, and a texture deleted while loading has nothing to upload into
+	if (total == 0 || !glIsTexture(request.texture))
+	{
+		freeImages(request);
+		return 0;
+	}
+
+	if (pbos[0] == 0)
+		glGenBuffers(PBO_COUNT, pbos);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[nextPbo]);
+	nextPbo = (nextPbo + 1) % PBO_COUNT;
+	// orphan the previous storage so we never wait on a transfer that is still reading it
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, total, nullptr, GL_STREAM_DRAW);
+	unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, total,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mapped)
+	{
+		size_t offset = 0;
+		for (const auto& image : request.images)
+		{
+			if (!image.pixels)
+				continue;
+			size_t size = (size_t)image.width * image.height * image.components;
+			memcpy(mapped + offset, image.pixels, size);
+			offset += size;
+		}
+		if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+			mapped = nullptr;
+	}
+	if (!mapped)
+	{
+		// fall back to uploading straight from the decoded pixels
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	// rows of 1 and 3 component images aren't 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glBindTexture(request.target, request.texture);
+	size_t offset = 0;
+	for (unsigned int i = 0; i < request.images.size(); i++)
+	{
+		const Image& image = request.images[i];
+		if (!image.pixels)
+			continue;
+		GLenum target = request.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + i : GL_TEXTURE_2D;
+		GLenum format = formatForComponents(image.components);
+		const void* source = mapped ? (const void*)offset : (const void*)image.pixels;
+		glTexImage2D(target, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, source);
+		offset += (size_t)image.width * image.height * image.components;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (request.target == GL_TEXTURE_2D)
+	{
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	}
+
+	freeImages(request);
+	return total;
+}
+
+void TextureLoader::freeImages(Request& request)
+{
+	for (auto& image : request.images)
+	{
+		stbi_image_free(image.pixels);
+		image.pixels = nullptr;
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+using namespace std;
+
+// Decodes images on a pool of worker threads and uploads them on the GL thread.
+//
+// load2D and loadCubemap return a texture name straight away, holding a 1x1 placeholder, so
+// meshes can be set up and drawn before their images arrive. The decoded pixels are uploaded
+// into that same texture by processUploads, which the render loop calls once per frame.
+// Uploads go through a small ring of pixel unpack buffers so the driver copies them to the
+// GPU asynchronously instead of stalling glTexImage2D.
+class TextureLoader
+{
+public:
+	// bytes of pixel data uploaded per processUploads call, so a burst of finished
+	// images is spread over several frames instead of causing one long one
+	static const size_t DEFAULT_UPLOAD_BUDGET = 16 * 1024 * 1024;
+	static const unsigned int PBO_COUNT = 3;
+
+	TextureLoader() = default;
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+	~TextureLoader();
+
+	// starts the worker threads, 0 uses one less than the number of hardware threads
+	void start(unsigned int threadCount = 0);
+	// joins the workers and frees the unpack buffers. Needs the GL context that is still current.
+	void release();
+
+	// queues an image for decoding, the returned texture shows the placeholder until it is uploaded
+	unsigned int load2D(const string& path, bool flipVertically = false);
+	// queues the six faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X order, uploaded together once all are decoded
+	unsigned int loadCubemap(const vector<string>& faces);
+
+	// GL thread only: uploads decoded images until byteBudget is used up. Returns the number uploaded.
+	unsigned int processUploads(size_t byteBudget = DEFAULT_UPLOAD_BUDGET);
+	// GL thread only: blocks until every queued image is decoded and uploaded
+	void finish();
+
+	// requests that are still being decoded or waiting for upload
+	unsigned int pending() const;
+
+private:
+	struct Image
+	{
+		string path;
+		unsigned char* pixels = nullptr;
+		int width = 0;
+		int height = 0;
+		int components = 0;
+	};
+
+	struct Request
+	{
+		unsigned int texture = 0;
+		GLenum target = GL_TEXTURE_2D;
+		bool flipVertically = false;
+		vector<Image> images;
+		// images not decoded yet, the request is ready for upload when this reaches 0
+		unsigned int remaining = 0;
+	};
+
+	struct Job
+	{
+		shared_ptr<Request> request;
+		unsigned int image;
+	};
+
+	vector<thread> workers;
+	bool stopping = false;
+
+	mutable mutex lock;
+	condition_variable jobAvailable;
+	condition_variable requestReady;
+	deque<Job> jobs;
+	deque<shared_ptr<Request>> ready;
+	unsigned int inFlight = 0;
+
+	unsigned int pbos[PBO_COUNT] = {};
+	unsigned int nextPbo = 0;
+
+	void stopWorkers();
+	void workerLoop();
+	void queue(const shared_ptr<Request>& request);
+	size_t upload(Request& request);
+	static void freeImages(Request& request);
+};
@@ -0,0 +1,146 @@
+#pragma once
+#include <algorithm>
+#include <reactphysics3d/reactphysics3d.h>
+
+using namespace std;
+using namespace reactphysics3d;
+
+struct TimestepSettings
+{
+	float timestep = 1.0f / 60.0f;
+	// steps run in one frame at most, time beyond that is dropped so a hitch can't snowball
+	unsigned int maxSubsteps = 4;
+	// frame times above this (window drags, loads) are clamped before they reach the accumulator
+	float maxFrameTime = 0.25f;
+
+	// lower the solver iterations while time is being dropped, raise them again once it stops
+	bool adaptiveIterations = false;
+	unsigned int velocityIterations = 15;
+	unsigned int positionIterations = 8;
+	// how many times the iterations may be halved
+	unsigned int maxIterationReduction = 2;
+	// frames without drops before the iterations go back up a level
+	unsigned int recoveryFrames = 120;
+};
+
+// The fixed timestep accumulator. advance() is called once per frame with the frame time and
+// says how many fixed steps to run; anything the step cap can't cover is dropped and counted,
+// keeping only the fraction of a step that the interpolation needs.
+class TimestepController
+{
+public:
+	void configure(const TimestepSettings& settings)
+	{
+		this->settings = settings;
+		accumulator = 0.0f;
+		droppedSeconds = 0.0;
+		droppedFrames = 0;
+		lastDropped = 0.0f;
+		lastSteps = 0;
+		reduction = 0;
+		calmFrames = 0;
+		cappedFrames = 0;
+		appliedReduction = ~0u;
+	}
+
+	const TimestepSettings& getSettings() const { return settings; }
+
+	unsigned int advance(float frameTime)
+	{
+		lastDropped = 0.0f;
+		if (frameTime > settings.maxFrameTime)
+		{
+			lastDropped += frameTime - settings.maxFrameTime;
+			frameTime = settings.maxFrameTime;
+		}
+		accumulator += max(frameTime, 0.0f);
+
+		unsigned int steps = 0;
+		while (accumulator >= settings.timestep && steps < settings.maxSubsteps)
+		{
+			accumulator -= settings.timestep;
+			steps++;
+		}
+		if (accumulator >= settings.timestep)
+		{
+			// keep the fraction so the blend factor stays continuous
+			float whole = settings.timestep * (unsigned int)(accumulator / settings.timestep);
+			lastDropped += whole;
+			accumulator -= whole;
+			accumulator = min(accumulator, settings.timestep * 0.999f);
+		}
+
+		if (lastDropped > 0.0f)
+		{
+			droppedSeconds += lastDropped;
+			droppedFrames++;
+		}
+		lastSteps = steps;
+		updateLoad();
+		return steps;
+	}
+
+	// how far between the last two steps the frame is, for interpolation
+	float blendFactor() const { return accumulator / settings.timestep; }
+
+	// sets the solver iterations for the current load, only touches the world when they change
+	void applyIterations(PhysicsWorld* world)
+	{
+		// without adaptive iterations the world keeps whatever the scene set up
+		if (!settings.adaptiveIterations || reduction == appliedReduction)
+			return;
+		world->setNbIterationsVelocitySolver(velocityIterations());
+		world->setNbIterationsPositionSolver(positionIterations());
+		appliedReduction = reduction;
+	}
+
+	unsigned int velocityIterations() const { return max(settings.velocityIterations >> reduction, 1u); }
+	unsigned int positionIterations() const { return max(settings.positionIterations >> reduction, 1u); }
+
+	unsigned int stepsLastFrame() const { return lastSteps; }
+	float droppedLastFrame() const { return lastDropped; }
+	// simulation time skipped since configure, in seconds
+	double totalDropped() const { return droppedSeconds; }
+	unsigned int framesDropped() const { return droppedFrames; }
+	unsigned int iterationReduction() const { return reduction; }
+
+private:
+	TimestepSettings settings;
+	float accumulator = 0.0f;
+
+	double droppedSeconds = 0.0;
+	unsigned int droppedFrames = 0;
+	float lastDropped = 0.0f;
+	unsigned int lastSteps = 0;
+
+	unsigned int reduction = 0;
+	unsigned int calmFrames = 0;
+	unsigned int cappedFrames = 0;
+	unsigned int appliedReduction = ~0u;
+
+	void updateLoad()
+	{
+		if (!settings.adaptiveIterations)
+		{
+			reduction = 0;
+			return;
+		}
+		// one capped frame is a hitch, capped frames in a row mean stepping can't keep up
+		if (lastSteps == settings.maxSubsteps && lastDropped > 0.0f)
+		{
+			calmFrames = 0;
+			if (++cappedFrames >= 2)
+			{
+				cappedFrames = 0;
+				reduction = min(reduction + 1, settings.maxIterationReduction);
+			}
+			return;
+		}
+		cappedFrames = 0;
+		if (reduction > 0 && ++calmFrames >= settings.recoveryFrames)
+		{
+			calmFrames = 0;
+			reduction--;
+		}
+	}
+};
@@ -0,0 +1,211 @@
+#include "transform_batch.h"
+#include <cmath>
+
+// MECHANICS_NO_SIMD keeps to the plain loops, so they can be tested on machines with SIMD
+#if defined(MECHANICS_NO_SIMD)
+#elif defined(__AVX2__)
+#define TRANSFORM_BATCH_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_BATCH_SSE2
+#include <emmintrin.h>
+#endif
+
+// Single transform versions, for builds without SIMD and for what is left over after the last full vector
+
+static void interpolateOne(const TransformSoA& prev, const TransformSoA& curr, float factor, TransformSoA& out, unsigned int i)
+{
+	float keep = 1.0f - factor;
+	out.px[i] = prev.px[i] * keep + curr.px[i] * factor;
+	out.py[i] = prev.py[i] * keep + curr.py[i] * factor;
+	out.pz[i] = prev.pz[i] * keep + curr.pz[i] * factor;
+
+	// q and -q are the same rotation, blend towards whichever is closer
+	float dot = prev.qx[i] * curr.qx[i] + prev.qy[i] * curr.qy[i] + prev.qz[i] * curr.qz[i] + prev.qw[i] * curr.qw[i];
+	float towards = dot < 0.0f ? -factor : factor;
+	float x = prev.qx[i] * keep + curr.qx[i] * towards;
+	float y = prev.qy[i] * keep + curr.qy[i] * towards;
+	float z = prev.qz[i] * keep + curr.qz[i] * towards;
+	float w = prev.qw[i] * keep + curr.qw[i] * towards;
+	float lengthSquare = x * x + y * y + z * z + w * w;
+	float inverseLength = lengthSquare > 0.0f ? 1.0f / std::sqrt(lengthSquare) : 0.0f;
+	out.qx[i] = x * inverseLength;
+	out.qy[i] = y * inverseLength;
+	out.qz[i] = z * inverseLength;
+	out.qw[i] = w * inverseLength;
+}
+
+// Same terms as Quaternion::getMatrix, so unnormalized quaternions give the same result too
+static void matrixOne(const TransformSoA& transforms, unsigned int i, float* m)
+{
+	float x = transforms.qx[i], y = transforms.qy[i], z = transforms.qz[i], w = transforms.qw[i];
+	float lengthSquare = x * x + y * y + z * z + w * w;
+	float s = lengthSquare > 0.0f ? 2.0f / lengthSquare : 0.0f;
+	float xs = x * s, ys = y * s, zs = z * s;
+	float wxs = w * xs, wys = w * ys, wzs = w * zs;
+	float xxs = x * xs, xys = x * ys, xzs = x * zs;
+	float yys = y * ys, yzs = y * zs, zzs = z * zs;
+
+	m[0] = 1.0f - yys - zzs; m[1] = xys + wzs; m[2] = xzs - wys; m[3] = 0.0f;
+	m[4] = xys - wzs; m[5] = 1.0f - xxs - zzs; m[6] = yzs + wxs; m[7] = 0.0f;
+	m[8] = xzs + wys; m[9] = yzs - wxs; m[10] = 1.0f - xxs - yys; m[11] = 0.0f;
+	m[12] = transforms.px[i]; m[13] = transforms.py[i]; m[14] = transforms.pz[i]; m[15] = 1.0f;
+}
+
+#if defined(TRANSFORM_BATCH_AVX2) || defined(TRANSFORM_BATCH_SSE2)
+
+// The kernels are written once against these and instantiated for the vector width of the build
+
+#ifdef TRANSFORM_BATCH_AVX2
+struct Lanes
+{
+	typedef __m256 V;
+	static const unsigned int WIDTH = 8;
+	static V load(const float* p) { return _mm256_loadu_ps(p); }
+	static void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+	static V set(float f) { return _mm256_set1_ps(f); }
+	static V add(V a, V b) { return _mm256_add_ps(a, b); }
+	static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+	static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+	static V div(V a, V b) { return _mm256_div_ps(a, b); }
+	static V sqrt(V a) { return _mm256_sqrt_ps(a); }
+	static V bitAnd(V a, V b) { return _mm256_and_ps(a, b); }
+	static V bitXor(V a, V b) { return _mm256_xor_ps(a, b); }
+	static V greater(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+
+	// r0..r3 hold rows 0-3 of one matrix column for 8 transforms, out points at the first matrix
+	static void storeColumn(float* out, unsigned int column, V r0, V r1, V r2, V r3)
+	{
+		__m128 lo0 = _mm256_castps256_ps128(r0), lo1 = _mm256_castps256_ps128(r1);
+		__m128 lo2 = _mm256_castps256_ps128(r2), lo3 = _mm256_castps256_ps128(r3);
+		__m128 hi0 = _mm256_extractf128_ps(r0, 1), hi1 = _mm256_extractf128_ps(r1, 1);
+		__m128 hi2 = _mm256_extractf128_ps(r2, 1), hi3 = _mm256_extractf128_ps(r3, 1);
+		_MM_TRANSPOSE4_PS(lo0, lo1, lo2, lo3);
+		_MM_TRANSPOSE4_PS(hi0, hi1, hi2, hi3);
+		float* p = out + column * 4;
+		_mm_storeu_ps(p, lo0); _mm_storeu_ps(p + 16, lo1); _mm_storeu_ps(p + 32, lo2); _mm_storeu_ps(p + 48, lo3);
+		_mm_storeu_ps(p + 64, hi0); _mm_storeu_ps(p + 80, hi1); _mm_storeu_ps(p + 96, hi2); _mm_storeu_ps(p + 112, hi3);
+	}
+};
+static const char* LANES_NAME = "avx2";
+#else
+struct Lanes
+{
+	typedef __m128 V;
+	static const unsigned int WIDTH = 4;
+	static V load(const float* p) { return _mm_loadu_ps(p); }
+	static void store(float* p, V v) { _mm_storeu_ps(p, v); }
+	static V set(float f) { return _mm_set1_ps(f); }
+	static V add(V a, V b) { return _mm_add_ps(a, b); }
+	static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+	static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+	static V div(V a, V b) { return _mm_div_ps(a, b); }
+	static V sqrt(V a) { return _mm_sqrt_ps(a); }
+	static V bitAnd(V a, V b) { return _mm_and_ps(a, b); }
+	static V bitXor(V a, V b) { return _mm_xor_ps(a, b); }
+	static V greater(V a, V b) { return _mm_cmpgt_ps(a, b); }
+
+	static void storeColumn(float* out, unsigned int column, V r0, V r1, V r2, V r3)
+	{
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		float* p = out + column * 4;
+		_mm_storeu_ps(p, r0); _mm_storeu_ps(p + 16, r1); _mm_storeu_ps(p + 32, r2); _mm_storeu_ps(p + 48, r3);
+	}
+};
+static const char* LANES_NAME = "sse2";
+#endif
+
+typedef Lanes L;
+
+static unsigned int interpolateVectors(const TransformSoA& prev, const TransformSoA& curr, float factor, TransformSoA& out)
+{
+	const unsigned int count = prev.size();
+	const L::V t = L::set(factor);
+	const L::V keep = L::set(1.0f - factor);
+	const L::V zero = L::set(0.0f);
+	const L::V one = L::set(1.0f);
+	const L::V signBit = L::set(-0.0f);
+	unsigned int i = 0;
+	for (; i + L::WIDTH <= count; i += L::WIDTH)
+	{
+		L::store(&out.px[i], L::add(L::mul(L::load(&prev.px[i]), keep), L::mul(L::load(&curr.px[i]), t)));
+		L::store(&out.py[i], L::add(L::mul(L::load(&prev.py[i]), keep), L::mul(L::load(&curr.py[i]), t)));
+		L::store(&out.pz[i], L::add(L::mul(L::load(&prev.pz[i]), keep), L::mul(L::load(&curr.pz[i]), t)));
+
+		L::V ax = L::load(&prev.qx[i]), ay = L::load(&prev.qy[i]), az = L::load(&prev.qz[i]), aw = L::load(&prev.qw[i]);
+		L::V bx = L::load(&curr.qx[i]), by = L::load(&curr.qy[i]), bz = L::load(&curr.qz[i]), bw = L::load(&curr.qw[i]);
+		L::V dot = L::add(L::add(L::mul(ax, bx), L::mul(ay, by)), L::add(L::mul(az, bz), L::mul(aw, bw)));
+		// flipping the sign of t where the dot is negative picks the shorter arc
+		L::V towards = L::bitXor(t, L::bitAnd(dot, signBit));
+		L::V x = L::add(L::mul(ax, keep), L::mul(bx, towards));
+		L::V y = L::add(L::mul(ay, keep), L::mul(by, towards));
+		L::V z = L::add(L::mul(az, keep), L::mul(bz, towards));
+		L::V w = L::add(L::mul(aw, keep), L::mul(bw, towards));
+		L::V lengthSquare = L::add(L::add(L::mul(x, x), L::mul(y, y)), L::add(L::mul(z, z), L::mul(w, w)));
+		L::V inverseLength = L::bitAnd(L::greater(lengthSquare, zero), L::div(one, L::sqrt(lengthSquare)));
+		L::store(&out.qx[i], L::mul(x, inverseLength));
+		L::store(&out.qy[i], L::mul(y, inverseLength));
+		L::store(&out.qz[i], L::mul(z, inverseLength));
+		L::store(&out.qw[i], L::mul(w, inverseLength));
+	}
+	return i;
+}
+
+static unsigned int matrixVectors(const TransformSoA& transforms, float* out)
+{
+	const unsigned int count = transforms.size();
+	const L::V zero = L::set(0.0f);
+	const L::V one = L::set(1.0f);
+	const L::V two = L::set(2.0f);
+	unsigned int i = 0;
+	for (; i + L::WIDTH <= count; i += L::WIDTH)
+	{
+		L::V x = L::load(&transforms.qx[i]), y = L::load(&transforms.qy[i]);
+		L::V z = L::load(&transforms.qz[i]), w = L::load(&transforms.qw[i]);
+		L::V lengthSquare = L::add(L::add(L::mul(x, x), L::mul(y, y)), L::add(L::mul(z, z), L::mul(w, w)));
+		L::V s = L::bitAnd(L::greater(lengthSquare, zero), L::div(two, lengthSquare));
+		L::V xs = L::mul(x, s), ys = L::mul(y, s), zs = L::mul(z, s);
+		L::V wxs = L::mul(w, xs), wys = L::mul(w, ys), wzs = L::mul(w, zs);
+		L::V xxs = L::mul(x, xs), xys = L::mul(x, ys), xzs = L::mul(x, zs);
+		L::V yys = L::mul(y, ys), yzs = L::mul(y, zs), zzs = L::mul(z, zs);
+
+		float* matrices = out + (size_t)i * 16;
+		L::storeColumn(matrices, 0, L::sub(L::sub(one, yys), zzs), L::add(xys, wzs), L::sub(xzs, wys), zero);
+		L::storeColumn(matrices, 1, L::sub(xys, wzs), L::sub(L::sub(one, xxs), zzs), L::add(yzs, wxs), zero);
+		L::storeColumn(matrices, 2, L::add(xzs, wys), L::sub(yzs, wxs), L::sub(L::sub(one, xxs), yys), zero);
+		L::storeColumn(matrices, 3, L::load(&transforms.px[i]), L::load(&transforms.py[i]), L::load(&transforms.pz[i]), one);
+	}
+	return i;
+}
+
+#else
+
+static unsigned int interpolateVectors(const TransformSoA&, const TransformSoA&, float, TransformSoA&) { return 0; }
+static unsigned int matrixVectors(const TransformSoA&, float*) { return 0; }
+static const char* LANES_NAME = "scalar";
+
+#endif
+
+void interpolateTransformBatch(const TransformSoA& prev, const TransformSoA& curr, float factor, TransformSoA& out)
+{
+	const unsigned int count = prev.size();
+	out.resize(count);
+	for (unsigned int i = interpolateVectors(prev, curr, factor, out); i < count; i++)
+	{
+		interpolateOne(prev, curr, factor, out, i);
+	}
+}
+
+void writeModelMatrixBatch(const TransformSoA& transforms, float* out)
+{
+	const unsigned int count = transforms.size();
+	for (unsigned int i = matrixVectors(transforms, out); i < count; i++)
+	{
+		matrixOne(transforms, i, out + (size_t)i * 16);
+	}
+}
+
+const char* transformBatchPath()
+{
+	return LANES_NAME;
+}
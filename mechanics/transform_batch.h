@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include <reactphysics3d/reactphysics3d.h>
+
+using namespace std;
+using namespace reactphysics3d;
+
+// Transforms of many objects with one array per component, so the kernels below work on 8 (AVX2)
+// or 4 (SSE2) of them per instruction. Which path is used is decided at compile time, builds
+// without either fall back to plain loops. Always float since the results go to the GPU.
+struct TransformSoA
+{
+	vector<float> px, py, pz;
+	vector<float> qx, qy, qz, qw;
+
+	unsigned int size() const { return (unsigned int)px.size(); }
+
+	void resize(unsigned int count)
+	{
+		px.resize(count); py.resize(count); pz.resize(count);
+		qx.resize(count); qy.resize(count); qz.resize(count); qw.resize(count);
+	}
+
+	void set(unsigned int i, const Transform& transform)
+	{
+		const Vector3& position = transform.getPosition();
+		const Quaternion& orientation = transform.getOrientation();
+		px[i] = (float)position.x; py[i] = (float)position.y; pz[i] = (float)position.z;
+		qx[i] = (float)orientation.x; qy[i] = (float)orientation.y; qz[i] = (float)orientation.z; qw[i] = (float)orientation.w;
+	}
+
+	Transform get(unsigned int i) const
+	{
+		return Transform(Vector3(px[i], py[i], pz[i]), Quaternion(qx[i], qy[i], qz[i], qw[i]));
+	}
+};
+
+// Blends every transform of prev towards curr by factor into out, which is resized to match.
+// Positions are lerped and orientations nlerped along the shorter arc; for the rotation a body
+// makes in one physics step that is indistinguishable from the slerp Transform::interpolateTransforms does.
+void interpolateTransformBatch(const TransformSoA& prev, const TransformSoA& curr, float factor, TransformSoA& out);
+
+// Writes one column major 4x4 model matrix per transform, 16 floats each, laid out like
+// Transform::getOpenGLMatrix. out can point into a mapped buffer, it needs no alignment.
+void writeModelMatrixBatch(const TransformSoA& transforms, float* out);
+
+// "avx2", "sse2" or "scalar", whichever the kernels were compiled for
+const char* transformBatchPath();
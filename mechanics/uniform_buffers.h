@@ -0,0 +1,97 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Uniform blocks shared between shader programs. The structs below mirror the std140 layout of
+// the blocks declared in the shaders, so a whole block is uploaded with one glBufferSubData.
+// vec3 members are followed by a float (or padding) because std140 aligns them to 16 bytes.
+
+const int NR_POINT_LIGHTS = 4;
+
+// Binding points, any program declaring a block with one of these names is bound at link time
+enum UniformBlockBinding
+{
+	FRAME_DATA_BINDING = 0,
+	LIGHTS_BINDING = 1
+};
+
+struct UniformBlockName
+{
+	const char* name;
+	UniformBlockBinding binding;
+};
+
+const UniformBlockName UNIFORM_BLOCKS[] = {
+	{ "FrameData", FRAME_DATA_BINDING },
+	{ "Lights", LIGHTS_BINDING }
+};
+
+// layout (std140) uniform FrameData
+struct FrameData
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 viewPos;
+	float pad0;
+};
+
+struct DirLightData
+{
+	glm::vec3 direction;
+	float pad0;
+	glm::vec3 ambient;
+	float pad1;
+	glm::vec3 diffuse;
+	float pad2;
+	glm::vec3 specular;
+	float pad3;
+};
+
+struct PointLightData
+{
+	glm::vec3 position;
+	float constant;
+	glm::vec3 ambient;
+	float linear;
+	glm::vec3 diffuse;
+	float quadratic;
+	glm::vec3 specular;
+	float pad0;
+};
+
+// layout (std140) uniform Lights
+struct LightsData
+{
+	DirLightData dirLight;
+	PointLightData pointLights[NR_POINT_LIGHTS];
+};
+
+static_assert(sizeof(FrameData) == 144, "FrameData must match the std140 layout");
+static_assert(sizeof(DirLightData) == 64, "DirLight must match the std140 layout");
+static_assert(sizeof(PointLightData) == 64, "PointLight must match the std140 layout");
+static_assert(sizeof(LightsData) == 64 + 64 * NR_POINT_LIGHTS, "Lights must match the std140 layout");
+
+// A uniform buffer object attached to one of the binding points above
+struct UniformBuffer
+{
+	unsigned int ID = 0;
+	unsigned int size = 0;
+
+	void init(unsigned int bufferSize, UniformBlockBinding binding)
+	{
+		size = bufferSize;
+		glGenBuffers(1, &ID);
+		glBindBuffer(GL_UNIFORM_BUFFER, ID);
+		glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+	}
+
+	// replaces the whole block in a single upload
+	void update(const void* data)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, ID);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+};
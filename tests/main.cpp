@@ -0,0 +1,32 @@
+#include "test.h"
+#include <cstring>
+
+int checkFailures = 0;
+
+vector<TestCase>& testCases()
+{
+	static vector<TestCase> cases;
+	return cases;
+}
+
+// runs every test, or only those whose name contains the first argument
+int main(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+	int run = 0, failed = 0;
+	for (const TestCase& test : testCases())
+	{
+		if (filter != nullptr && strstr(test.name, filter) == nullptr)
+			continue;
+		int failuresBefore = checkFailures;
+		test.run();
+		run++;
+		if (checkFailures != failuresBefore)
+		{
+			failed++;
+			cout << "FAILED " << test.name << endl;
+		}
+	}
+	cout << run << " tests, " << failed << " failed" << endl;
+	return failed == 0 ? 0 : 1;
+}
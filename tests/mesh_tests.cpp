@@ -0,0 +1,343 @@
+#include "test.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <glm/gtc/packing.hpp>
+#include "mesh_import.h"
+#include "mesh_optimize.h"
+#include "baked_mesh.h"
+
+// flat square of size x size quads in the xz plane, two triangles each
+static MeshData gridMesh(unsigned int size)
+{
+	MeshData mesh;
+	for (unsigned int z = 0; z <= size; z++)
+	{
+		for (unsigned int x = 0; x <= size; x++)
+			mesh.vertices.push_back({ glm::vec3((float)x, 0.0f, (float)z), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(x / (float)size, z / (float)size) });
+	}
+	for (unsigned int z = 0; z < size; z++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			unsigned int i = z * (size + 1) + x;
+			mesh.indices.insert(mesh.indices.end(), { i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2 });
+		}
+	}
+	for (const auto& vertex : mesh.vertices)
+		mesh.bounds.add(vertex.Position);
+	return mesh;
+}
+
+// shuffles the triangles and which corner each starts at, keeping the winding
+static void shuffleTriangles(vector<unsigned int>& indices, std::mt19937& random)
+{
+	vector<array<unsigned int, 3>> triangles;
+	for (size_t t = 0; t < indices.size(); t += 3)
+	{
+		unsigned int shift = random() % 3;
+		triangles.push_back({ indices[t + shift], indices[t + (shift + 1) % 3], indices[t + (shift + 2) % 3] });
+	}
+	std::shuffle(triangles.begin(), triangles.end(), random);
+	for (size_t t = 0; t < triangles.size(); t++)
+		std::copy(triangles[t].begin(), triangles[t].end(), indices.begin() + t * 3);
+}
+
+// The triangles of one index range by corner positions, each starting at its smallest corner and
+// the whole list sorted, so it compares equal however triangles and vertices were reordered
+static vector<array<float, 9>> triangleSet(const MeshData& mesh, unsigned int firstIndex, unsigned int indexCount)
+{
+	vector<array<float, 9>> result;
+	for (unsigned int t = firstIndex; t < firstIndex + indexCount; t += 3)
+	{
+		array<glm::vec3, 3> corners;
+		for (int c = 0; c < 3; c++)
+			corners[c] = mesh.vertices[mesh.indices[t + c]].Position;
+		auto less = [](const glm::vec3& a, const glm::vec3& b) { return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z); };
+		std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end(), less), corners.end());
+		array<float, 9> key;
+		for (int c = 0; c < 3; c++)
+		{
+			key[c * 3] = corners[c].x; key[c * 3 + 1] = corners[c].y; key[c * 3 + 2] = corners[c].z;
+		}
+		result.push_back(key);
+	}
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+TEST(optimizeMeshKeepsEveryTriangle)
+{
+	std::mt19937 random(3);
+	MeshData mesh = gridMesh(40);
+	generateLods(mesh.vertices, mesh.indices, mesh.lods);
+	CHECK(mesh.lods.size() > 1);
+	for (const auto& lod : mesh.lods)
+	{
+		vector<unsigned int> range(mesh.indices.begin() + lod.firstIndex, mesh.indices.begin() + lod.firstIndex + lod.indexCount);
+		shuffleTriangles(range, random);
+		std::copy(range.begin(), range.end(), mesh.indices.begin() + lod.firstIndex);
+	}
+	vector<vector<array<float, 9>>> before;
+	for (const auto& lod : mesh.lods)
+		before.push_back(triangleSet(mesh, lod.firstIndex, lod.indexCount));
+	float missesBefore = averageCacheMissRatio(mesh.indices.data(), mesh.lods[0].indexCount, (unsigned int)mesh.vertices.size());
+
+	optimizeMesh(mesh);
+	for (size_t l = 0; l < mesh.lods.size(); l++)
+		CHECK(triangleSet(mesh, mesh.lods[l].firstIndex, mesh.lods[l].indexCount) == before[l]);
+	for (unsigned int index : mesh.indices)
+		CHECK(index < mesh.vertices.size());
+
+	float missesAfter = averageCacheMissRatio(mesh.indices.data(), mesh.lods[0].indexCount, (unsigned int)mesh.vertices.size());
+	CHECK(missesAfter < missesBefore * 0.5f);
+	CHECK(missesAfter < 0.8f);
+}
+
+TEST(optimizeVertexFetchOrdersVerticesByFirstUse)
+{
+	std::mt19937 random(5);
+	MeshData mesh = gridMesh(8);
+	shuffleTriangles(mesh.indices, random);
+	// one vertex no triangle uses
+	mesh.vertices.push_back({ glm::vec3(100.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.0f) });
+	optimizeVertexFetch(mesh.vertices, mesh.indices);
+	CHECK(mesh.vertices.size() == 81);
+	unsigned int next = 0;
+	for (unsigned int index : mesh.indices)
+	{
+		CHECK(index <= next);
+		if (index == next)
+			next++;
+	}
+}
+
+static glm::vec3 octDecode(glm::vec2 e)
+{
+	// as in shaders/light/vertex.glsl
+	glm::vec3 n(e, 1.0f - std::abs(e.x) - std::abs(e.y));
+	if (n.z < 0.0f)
+		n = glm::vec3((1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f), n.z);
+	return glm::normalize(n);
+}
+
+TEST(quantizeMeshErrorIsBounded)
+{
+	std::mt19937 random(9);
+	std::uniform_real_distribution<float> position(-3.0f, 17.0f), component(-1.0f, 1.0f), uv(-2.0f, 3.0f);
+	MeshData mesh;
+	for (int i = 0; i < 5000; i++)
+	{
+		glm::vec3 normal(component(random), component(random), component(random));
+		if (glm::length(normal) < 0.01f)
+			normal = glm::vec3(0.0f, 0.0f, -1.0f);
+		mesh.vertices.push_back({ glm::vec3(position(random), position(random) * 0.1f, position(random)), glm::normalize(normal),
+			glm::vec2(uv(random), uv(random)) });
+		mesh.bounds.add(mesh.vertices.back().Position);
+	}
+	// the axis aligned normals sit on the folds of the octahedron
+	for (const glm::vec3& axis : { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) })
+		mesh.vertices.push_back({ mesh.bounds.min, axis, glm::vec2(0.0f) });
+
+	quantizeMesh(mesh);
+	CHECK(mesh.quantized.size() == mesh.vertices.size());
+	glm::vec3 size = mesh.bounds.max - mesh.bounds.min;
+	float worstNormal = 1.0f;
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		const Vertex& vertex = mesh.vertices[i];
+		const QuantizedVertex& quantized = mesh.quantized[i];
+		for (int c = 0; c < 3; c++)
+		{
+			float decoded = mesh.bounds.min[c] + glm::unpackUnorm1x16(quantized.position[c]) * size[c];
+			// half a step of the 16 bit grid, and float rounding
+			CHECK_NEAR(decoded, vertex.Position[c], size[c] / 65535.0f * 0.5f + 1e-5f);
+		}
+		glm::vec3 normal = octDecode(glm::vec2(glm::unpackSnorm1x16((uint16_t)quantized.normal[0]), glm::unpackSnorm1x16((uint16_t)quantized.normal[1])));
+		worstNormal = std::min(worstNormal, glm::dot(normal, vertex.Normal));
+		for (int c = 0; c < 2; c++)
+		{
+			// half floats keep 11 significant bits
+			float decoded = glm::unpackHalf1x16(quantized.texCoords[c]);
+			CHECK_NEAR(decoded, vertex.TexCoords[c], std::abs(vertex.TexCoords[c]) / 2048.0f + 1e-7f);
+		}
+	}
+	// 16 bit octahedral normals are off by a few hundredths of a degree at most
+	CHECK(worstNormal > std::cos(glm::radians(0.05f)));
+}
+
+TEST(bakedModelRoundTrip)
+{
+	std::mt19937 random(13);
+	vector<MeshData> meshes;
+	// quantized with levels of detail and textures, 16 bit indices
+	meshes.push_back(gridMesh(30));
+	generateLods(meshes[0].vertices, meshes[0].indices, meshes[0].lods);
+	optimizeMesh(meshes[0]);
+	quantizeMesh(meshes[0]);
+	meshes[0].textures = { { "texture_diffuse", "container2.png" }, { "texture_specular", "container2_specular.png" } };
+	// float vertices past what 16 bit indices reach
+	meshes.push_back(MeshData());
+	std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+	for (unsigned int i = 0; i < 70002; i++)
+	{
+		meshes[1].vertices.push_back({ glm::vec3(value(random), value(random), value(random)), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(value(random)) });
+		meshes[1].indices.push_back(i);
+		meshes[1].bounds.add(meshes[1].vertices.back().Position);
+	}
+	meshes[1].lods.push_back({ 0, (unsigned int)meshes[1].indices.size(), 0.0f });
+
+	string path = (std::filesystem::temp_directory_path() / "mechanics_tests_round_trip.mesh").string();
+	CHECK(writeBakedModel(path, meshes));
+	{
+		MappedFile file;
+		CHECK(file.open(path));
+		BakedModelView view;
+		CHECK(!view.parse(file.data(), file.size() - 1));
+		CHECK(view.parse(file.data(), file.size()));
+		CHECK(view.header->meshCount == 2);
+		for (unsigned int m = 0; m < 2 && m < view.header->meshCount; m++)
+		{
+			const MeshData& mesh = meshes[m];
+			const BakedMeshRecord& record = view.meshes[m];
+			MeshBuffers buffers = view.buffers(record);
+			bool quantized = !mesh.quantized.empty();
+			CHECK(buffers.format == (quantized ? VertexFormat::Quantized : VertexFormat::Float));
+			CHECK(buffers.vertexCount == mesh.vertices.size());
+			const void* vertices = quantized ? (const void*)mesh.quantized.data() : (const void*)mesh.vertices.data();
+			CHECK(memcmp(buffers.vertices, vertices, buffers.vertexCount * vertexSize(buffers.format)) == 0);
+			CHECK(buffers.indexSize == (m == 0 ? 2u : 4u));
+			CHECK(buffers.indexCount == mesh.indices.size());
+			for (unsigned int i = 0; i < buffers.indexCount && i < mesh.indices.size(); i++)
+			{
+				unsigned int index = buffers.indexSize == 2 ? ((const uint16_t*)buffers.indices)[i] : ((const uint32_t*)buffers.indices)[i];
+				if (index != mesh.indices[i])
+				{
+					CHECK(index == mesh.indices[i]);
+					break;
+				}
+			}
+			CHECK(buffers.bounds.min == mesh.bounds.min);
+			CHECK(buffers.bounds.max == mesh.bounds.max);
+			vector<MeshLod> lods = view.meshLods(record);
+			CHECK(lods.size() == mesh.lods.size());
+			for (size_t l = 0; l < lods.size() && l < mesh.lods.size(); l++)
+			{
+				CHECK(lods[l].firstIndex == mesh.lods[l].firstIndex);
+				CHECK(lods[l].indexCount == mesh.lods[l].indexCount);
+				CHECK(lods[l].error == mesh.lods[l].error);
+			}
+			CHECK(record.textureCount == mesh.textures.size());
+			for (unsigned int t = 0; t < record.textureCount && t < mesh.textures.size(); t++)
+			{
+				CHECK(mesh.textures[t].type == view.textures[record.firstTexture + t].type);
+				CHECK(mesh.textures[t].path == view.textures[record.firstTexture + t].path);
+			}
+		}
+	}
+	std::filesystem::remove(path);
+}
+
+#ifdef MECHANICS_ASSET_DIR
+// Reads an OBJ the way Assimp hands it to importModel: a vertex for every face corner, polygons
+// fanned into triangles and the v coordinate flipped
+static bool readObjCorners(const string& path, MeshData& mesh)
+{
+	ifstream file(path);
+	if (!file)
+		return false;
+	vector<glm::vec3> positions, normals;
+	vector<glm::vec2> texCoords;
+	string line;
+	while (getline(file, line))
+	{
+		istringstream words(line);
+		string kind;
+		words >> kind;
+		if (kind == "v" || kind == "vn")
+		{
+			glm::vec3 value;
+			words >> value.x >> value.y >> value.z;
+			(kind == "v" ? positions : normals).push_back(value);
+		}
+		else if (kind == "vt")
+		{
+			glm::vec2 value;
+			words >> value.x >> value.y;
+			texCoords.push_back(glm::vec2(value.x, 1.0f - value.y));
+		}
+		else if (kind == "f")
+		{
+			unsigned int first = (unsigned int)mesh.vertices.size();
+			string corner;
+			while (words >> corner)
+			{
+				int p = 0, t = 0, n = 0;
+				sscanf(corner.c_str(), "%d/%d/%d", &p, &t, &n);
+				if (p <= 0 || p > (int)positions.size() || t <= 0 || t > (int)texCoords.size() || n <= 0 || n > (int)normals.size())
+					return false;
+				mesh.vertices.push_back({ positions[p - 1], normals[n - 1], texCoords[t - 1] });
+			}
+			for (unsigned int i = first + 2; i < mesh.vertices.size(); i++)
+				mesh.indices.insert(mesh.indices.end(), { first, i - 1, i });
+		}
+	}
+	return !mesh.indices.empty();
+}
+
+TEST(importedModelsGetSmallerLevels)
+{
+	for (const char* model : { "ball/ball.obj", "plank/plank.obj" })
+	{
+		MeshData mesh;
+		CHECK(readObjCorners(string(MECHANICS_ASSET_DIR) + "/" + model, mesh));
+		size_t corners = mesh.vertices.size();
+		prepareMesh(mesh);
+		// flat shaded models keep a vertex per corner, only smooth ones get smaller
+		CHECK(mesh.vertices.size() <= corners);
+		for (size_t l = 1; l < mesh.lods.size(); l++)
+			CHECK(mesh.lods[l].indexCount <= mesh.lods[l - 1].indexCount * 0.8f);
+		for (unsigned int index : mesh.indices)
+			CHECK(index < mesh.vertices.size());
+		// the ball is a closed sphere, plenty to take away
+		if (string(model) == "ball/ball.obj")
+		{
+			CHECK(mesh.lods.size() > 2);
+			CHECK(mesh.lods.back().indexCount <= mesh.lods[0].indexCount / 4);
+		}
+	}
+}
+
+// Every vertex is loaded at least once, so vertices per triangle is as low as the ratio gets. Flat
+// shaded faces share no vertices with their neighbours, which keeps a quad sphere near 2.
+TEST(importedModelsCacheMissRatio)
+{
+	for (const char* model : { "ball/ball.obj", "plank/plank.obj" })
+	{
+		MeshData mesh;
+		CHECK(readObjCorners(string(MECHANICS_ASSET_DIR) + "/" + model, mesh));
+		ImportSettings settings;
+		settings.optimize = false;
+		prepareMesh(mesh, settings);
+		unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+		unsigned int fullCount = mesh.lods[0].indexCount;
+		float imported = averageCacheMissRatio(mesh.indices.data(), fullCount, vertexCount);
+		std::mt19937 random(17);
+		vector<unsigned int> shuffled(mesh.indices.begin(), mesh.indices.begin() + fullCount);
+		shuffleTriangles(shuffled, random);
+		float worst = averageCacheMissRatio(shuffled.data(), fullCount, vertexCount);
+
+		optimizeMesh(mesh);
+		float optimized = averageCacheMissRatio(mesh.indices.data(), fullCount, vertexCount);
+		float floor = (float)vertexCount / (fullCount / 3);
+		CHECK(optimized <= imported + 1e-4f);
+		CHECK(optimized < worst);
+		CHECK(optimized <= floor * 1.02f);
+	}
+}
+#endif
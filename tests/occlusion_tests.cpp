@@ -0,0 +1,223 @@
+#include "test.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "occlusion_buffer.h"
+
+// camera at the origin looking down -z, like the game's but with the far plane at 100
+static glm::mat4 testViewProjection()
+{
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	return projection * view;
+}
+
+static Aabb box(const glm::vec3& min, const glm::vec3& max)
+{
+	Aabb result;
+	result.add(min);
+	result.add(max);
+	return result;
+}
+
+static void drawBox(OcclusionBuffer& buffer, const Aabb& bounds)
+{
+	OccluderComponent occluder = occluderFromBox(bounds);
+	buffer.rasterize(occluder.triangles.data(), (unsigned int)occluder.triangles.size(), glm::mat4(1.0f));
+}
+
+TEST(occlusionWallHidesWhatIsBehindIt)
+{
+	OcclusionBuffer buffer;
+	buffer.begin(testViewProjection());
+	// a wall filling the whole view 10 units ahead
+	drawBox(buffer, box(glm::vec3(-40.0f, -40.0f, -10.5f), glm::vec3(40.0f, 40.0f, -10.0f)));
+	CHECK(buffer.stats.occluderTriangles == 12);
+
+	CHECK(!buffer.isVisible(box(glm::vec3(-1.0f, -1.0f, -15.0f), glm::vec3(1.0f, 1.0f, -12.0f))));
+	CHECK(!buffer.isVisible(box(glm::vec3(5.0f, 2.0f, -60.0f), glm::vec3(8.0f, 4.0f, -50.0f))));
+	CHECK(buffer.isVisible(box(glm::vec3(-1.0f, -1.0f, -8.0f), glm::vec3(1.0f, 1.0f, -6.0f))));
+	// poking through the wall
+	CHECK(buffer.isVisible(box(glm::vec3(-1.0f, -1.0f, -12.0f), glm::vec3(1.0f, 1.0f, -9.0f))));
+	CHECK(buffer.stats.tested == 4);
+	CHECK(buffer.stats.occluded == 2);
+}
+
+TEST(occlusionNarrowWallOnlyHidesItsShadow)
+{
+	OcclusionBuffer buffer;
+	buffer.begin(testViewProjection());
+	drawBox(buffer, box(glm::vec3(-2.0f, -2.0f, -10.5f), glm::vec3(2.0f, 2.0f, -10.0f)));
+
+	// right behind the wall and well inside its silhouette
+	CHECK(!buffer.isVisible(box(glm::vec3(-1.0f, -1.0f, -14.0f), glm::vec3(1.0f, 1.0f, -12.0f))));
+	// beside the wall, and behind it but wider than its silhouette
+	CHECK(buffer.isVisible(box(glm::vec3(4.0f, -1.0f, -14.0f), glm::vec3(5.0f, 1.0f, -12.0f))));
+	CHECK(buffer.isVisible(box(glm::vec3(-6.0f, -1.0f, -14.0f), glm::vec3(6.0f, 1.0f, -12.0f))));
+}
+
+TEST(occlusionEmptyBufferHidesNothing)
+{
+	OcclusionBuffer buffer;
+	buffer.begin(testViewProjection());
+	CHECK(buffer.isVisible(box(glm::vec3(-1.0f, -1.0f, -90.0f), glm::vec3(1.0f, 1.0f, -80.0f))));
+	for (unsigned int y = 0; y < buffer.getHeight(); y += 13)
+	{
+		for (unsigned int x = 0; x < buffer.getWidth(); x += 7)
+			CHECK(buffer.depthAt(x, y) == 1.0f);
+	}
+}
+
+// With an identity view projection clip space is the buffer's normalized device coordinates, so
+// the tests can place triangles on exact pixel positions
+static glm::vec3 pixelPoint(const OcclusionBuffer& buffer, float x, float y, float depth)
+{
+	return glm::vec3(x / buffer.getWidth() * 2.0f - 1.0f, y / buffer.getHeight() * 2.0f - 1.0f, depth * 2.0f - 1.0f);
+}
+
+static bool coversCenter(const glm::vec3* corners, unsigned int x, unsigned int y)
+{
+	glm::vec2 p(x + 0.5f, y + 0.5f);
+	float edges[3];
+	for (int e = 0; e < 3; e++)
+	{
+		glm::vec2 a(corners[e]), b(corners[(e + 1) % 3]);
+		edges[e] = (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+	}
+	float area = (corners[1].x - corners[0].x) * (corners[2].y - corners[0].y) - (corners[1].y - corners[0].y) * (corners[2].x - corners[0].x);
+	if (area < 0.0f)
+	{
+		for (float& edge : edges)
+			edge = -edge;
+	}
+	return edges[0] >= 0.0f && edges[1] >= 0.0f && edges[2] >= 0.0f;
+}
+
+TEST(occlusionBufferPathMatchesBuild)
+{
+	string path = occlusionBufferPath();
+#if defined(MECHANICS_NO_SIMD)
+	CHECK(path == "scalar");
+#elif defined(__SSE2__) || defined(_M_X64)
+	CHECK(path == "sse2");
+#endif
+}
+
+TEST(rasterizeTriangleCoversPixelCenters)
+{
+	OcclusionBuffer buffer(37, 21);
+	buffer.begin(glm::mat4(1.0f));
+	// in pixels, no pixel center lies on an edge; both windings have to draw the same
+	const glm::vec3 corners[2][3] = {
+		{ glm::vec3(1.3f, 0.7f, 0.4f), glm::vec3(33.2f, 4.1f, 0.4f), glm::vec3(9.6f, 19.4f, 0.4f) },
+		{ glm::vec3(35.9f, 20.3f, 0.6f), glm::vec3(30.2f, 6.8f, 0.6f), glm::vec3(2.2f, 16.7f, 0.6f) }
+	};
+	for (const auto& triangle : corners)
+	{
+		glm::vec3 points[3];
+		for (int c = 0; c < 3; c++)
+			points[c] = pixelPoint(buffer, triangle[c].x, triangle[c].y, triangle[c].z);
+		buffer.rasterize(points, 3, glm::mat4(1.0f));
+	}
+	unsigned int covered = 0;
+	for (unsigned int y = 0; y < buffer.getHeight(); y++)
+	{
+		for (unsigned int x = 0; x < buffer.getWidth(); x++)
+		{
+			// the nearer triangle wins where they overlap
+			float expected = coversCenter(corners[0], x, y) ? 0.4f : coversCenter(corners[1], x, y) ? 0.6f : 1.0f;
+			CHECK_NEAR(buffer.depthAt(x, y), expected, 1e-5);
+			covered += expected < 1.0f;
+		}
+	}
+	CHECK(covered > 200);
+}
+
+TEST(rasterizeTriangleKeepsFarthestDepthInPixel)
+{
+	OcclusionBuffer buffer(32, 16);
+	buffer.begin(glm::mat4(1.0f));
+	// depth grows by 0.01 per pixel to the right and 0.02 per pixel down
+	auto depthAt = [](float x, float y) { return 0.1f + 0.01f * x + 0.02f * y; };
+	glm::vec3 points[3] = {
+		pixelPoint(buffer, -2.0f, -2.0f, depthAt(-2.0f, -2.0f)),
+		pixelPoint(buffer, 40.0f, -2.0f, depthAt(40.0f, -2.0f)),
+		pixelPoint(buffer, -2.0f, 30.0f, depthAt(-2.0f, 30.0f))
+	};
+	buffer.rasterize(points, 3, glm::mat4(1.0f));
+	for (unsigned int y = 0; y < 8; y++)
+	{
+		for (unsigned int x = 0; x < 16; x++)
+		{
+			// the far corner of the pixel, so a box is never hidden by a depth the occluder doesn't reach
+			CHECK_NEAR(buffer.depthAt(x, y), depthAt(x + 1.0f, y + 1.0f), 1e-4);
+		}
+	}
+}
+
+TEST(isVisibleTestsNearestCornerAgainstCoveredPixels)
+{
+	OcclusionBuffer buffer;
+	buffer.begin(testViewProjection());
+	drawBox(buffer, box(glm::vec3(-3.0f, -3.0f, -10.2f), glm::vec3(3.0f, 3.0f, -10.0f)));
+
+	// behind the wall, by a lot and by a little
+	CHECK(!buffer.isVisible(box(glm::vec3(-0.5f, -0.5f, -30.0f), glm::vec3(0.5f, 0.5f, -29.0f))));
+	CHECK(!buffer.isVisible(box(glm::vec3(-0.5f, -0.5f, -10.6f), glm::vec3(0.5f, 0.5f, -10.3f))));
+	// straddling the silhouette edge, one pixel row uncovered is enough
+	CHECK(buffer.isVisible(box(glm::vec3(2.0f, -0.5f, -12.0f), glm::vec3(3.5f, 0.5f, -11.0f))));
+	// in front of the wall
+	CHECK(buffer.isVisible(box(glm::vec3(-0.5f, -0.5f, -9.0f), glm::vec3(0.5f, 0.5f, -8.0f))));
+	// completely off screen is left to the frustum test
+	CHECK(buffer.isVisible(box(glm::vec3(-0.5f, -0.5f, 10.0f), glm::vec3(0.5f, 0.5f, 12.0f))));
+	CHECK(buffer.isVisible(box(glm::vec3(500.0f, -0.5f, -12.0f), glm::vec3(501.0f, 0.5f, -11.0f))));
+	// reaching past the near plane
+	CHECK(buffer.isVisible(box(glm::vec3(-0.5f, -0.5f, -12.0f), glm::vec3(0.5f, 0.5f, 1.0f))));
+	CHECK(buffer.stats.tested == 7);
+	CHECK(buffer.stats.occluded == 2);
+}
+
+TEST(rasterizeClipsAgainstNearPlane)
+{
+	OcclusionBuffer buffer;
+	buffer.begin(testViewProjection());
+	// entirely behind the camera, nothing may be drawn
+	glm::vec3 behind[3] = { glm::vec3(-5.0f, -5.0f, 2.0f), glm::vec3(5.0f, -5.0f, 2.0f), glm::vec3(0.0f, 5.0f, 3.0f) };
+	buffer.rasterize(behind, 3, glm::mat4(1.0f));
+	unsigned int drawn = 0;
+	for (unsigned int y = 0; y < buffer.getHeight(); y++)
+	{
+		for (unsigned int x = 0; x < buffer.getWidth(); x++)
+			drawn += buffer.depthAt(x, y) != 1.0f;
+	}
+	CHECK(drawn == 0);
+
+	// a floor running from behind the camera into the distance covers the lower half of the view
+	glm::vec3 floor[6] = {
+		glm::vec3(-50.0f, -1.0f, 20.0f), glm::vec3(50.0f, -1.0f, 20.0f), glm::vec3(50.0f, -1.0f, -90.0f),
+		glm::vec3(-50.0f, -1.0f, 20.0f), glm::vec3(50.0f, -1.0f, -90.0f), glm::vec3(-50.0f, -1.0f, -90.0f)
+	};
+	buffer.rasterize(floor, 6, glm::mat4(1.0f));
+	unsigned int width = buffer.getWidth(), height = buffer.getHeight();
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			float depth = buffer.depthAt(x, y);
+			CHECK(depth >= 0.0f && depth <= 1.0f);
+			if (y < height / 2 - 4)
+				CHECK(depth < 1.0f);
+			else if (y >= height / 2)
+				CHECK(depth == 1.0f);
+		}
+	}
+	// the floor is nearest at the bottom of the screen
+	CHECK(buffer.depthAt(width / 2, 0) < buffer.depthAt(width / 2, height / 4));
+
+	// a wall with a corner behind the camera still hides what is behind it
+	OcclusionBuffer wall;
+	wall.begin(testViewProjection());
+	glm::vec3 slanted[3] = { glm::vec3(-30.0f, -30.0f, 5.0f), glm::vec3(30.0f, -30.0f, -15.0f), glm::vec3(-30.0f, 40.0f, -15.0f) };
+	wall.rasterize(slanted, 3, glm::mat4(1.0f));
+	CHECK(!wall.isVisible(box(glm::vec3(-0.5f, -0.5f, -40.0f), glm::vec3(0.5f, 0.5f, -39.0f))));
+	CHECK(wall.isVisible(box(glm::vec3(-0.5f, -0.5f, -3.0f), glm::vec3(0.5f, 0.5f, -2.0f))));
+}
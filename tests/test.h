@@ -0,0 +1,51 @@
+#pragma once
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// Just enough of a test framework for headless CI: TEST(name) registers a function that main.cpp
+// runs, the CHECK macros report a failed condition with its location and let the test carry on.
+
+struct TestCase
+{
+	const char* name;
+	void (*run)();
+};
+
+vector<TestCase>& testCases();
+// failed checks so far, across every test
+extern int checkFailures;
+
+struct TestRegistration
+{
+	TestRegistration(const char* name, void (*run)()) { testCases().push_back({ name, run }); }
+};
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			checkFailures++; \
+			cout << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << endl; \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+	do \
+	{ \
+		double actualValue = (actual), expectedValue = (expected); \
+		if (!(std::abs(actualValue - expectedValue) <= (tolerance))) \
+		{ \
+			checkFailures++; \
+			cout << __FILE__ << ":" << __LINE__ << ": " #actual " is " << actualValue << ", expected " \
+				<< expectedValue << " within " << (tolerance) << endl; \
+		} \
+	} while (0)
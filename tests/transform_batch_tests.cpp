@@ -0,0 +1,111 @@
+#include "test.h"
+#include <random>
+#include <string>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "transform_batch.h"
+
+// sizes that leave every tail length behind the 8 and 4 wide loops
+static const unsigned int BATCH_SIZES[] = { 1, 3, 4, 7, 8, 13, 64 };
+
+static void fillRandom(TransformSoA& transforms, unsigned int count, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+	transforms.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		transforms.px[i] = position(random); transforms.py[i] = position(random); transforms.pz[i] = position(random);
+		glm::quat q = glm::normalize(glm::quat(component(random), component(random), component(random), component(random)));
+		transforms.qx[i] = q.x; transforms.qy[i] = q.y; transforms.qz[i] = q.z; transforms.qw[i] = q.w;
+	}
+}
+
+static glm::quat orientation(const TransformSoA& transforms, unsigned int i)
+{
+	return glm::quat(transforms.qw[i], transforms.qx[i], transforms.qy[i], transforms.qz[i]);
+}
+
+TEST(interpolateTransformBatchMatchesNlerp)
+{
+	std::mt19937 random(7);
+	for (unsigned int count : BATCH_SIZES)
+	{
+		TransformSoA prev, curr, out;
+		fillRandom(prev, count, random);
+		fillRandom(curr, count, random);
+		const float factor = 0.3f;
+		interpolateTransformBatch(prev, curr, factor, out);
+		CHECK(out.size() == count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			CHECK_NEAR(out.px[i], prev.px[i] + (curr.px[i] - prev.px[i]) * factor, 1e-4);
+			CHECK_NEAR(out.py[i], prev.py[i] + (curr.py[i] - prev.py[i]) * factor, 1e-4);
+			CHECK_NEAR(out.pz[i], prev.pz[i] + (curr.pz[i] - prev.pz[i]) * factor, 1e-4);
+			glm::quat a = orientation(prev, i), b = orientation(curr, i);
+			if (glm::dot(a, b) < 0.0f)
+				b = -b;
+			glm::quat expected = glm::normalize(a * (1.0f - factor) + b * factor);
+			glm::quat actual = orientation(out, i);
+			CHECK_NEAR(actual.x, expected.x, 1e-5);
+			CHECK_NEAR(actual.y, expected.y, 1e-5);
+			CHECK_NEAR(actual.z, expected.z, 1e-5);
+			CHECK_NEAR(actual.w, expected.w, 1e-5);
+		}
+	}
+}
+
+TEST(interpolateTransformBatchTakesShorterArc)
+{
+	// q and -q are the same rotation, halfway between them is that rotation again
+	TransformSoA prev, curr, out;
+	prev.resize(5);
+	curr.resize(5);
+	for (unsigned int i = 0; i < 5; i++)
+	{
+		prev.qx[i] = 0.0f; prev.qy[i] = 0.6f; prev.qz[i] = 0.0f; prev.qw[i] = 0.8f;
+		curr.qx[i] = 0.0f; curr.qy[i] = -0.6f; curr.qz[i] = 0.0f; curr.qw[i] = -0.8f;
+	}
+	interpolateTransformBatch(prev, curr, 0.5f, out);
+	for (unsigned int i = 0; i < 5; i++)
+	{
+		CHECK_NEAR(std::abs(out.qy[i]), 0.6f, 1e-5);
+		CHECK_NEAR(std::abs(out.qw[i]), 0.8f, 1e-5);
+	}
+}
+
+TEST(writeModelMatrixBatchMatchesGlm)
+{
+	std::mt19937 random(11);
+	for (unsigned int count : BATCH_SIZES)
+	{
+		TransformSoA transforms;
+		fillRandom(transforms, count, random);
+		// one float in so the output isn't 16 byte aligned, with guards on both ends
+		vector<float> buffer(count * 16 + 2, -7.0f);
+		writeModelMatrixBatch(transforms, buffer.data() + 1);
+		CHECK(buffer.front() == -7.0f);
+		CHECK(buffer.back() == -7.0f);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			glm::mat4 expected = glm::mat4_cast(orientation(transforms, i));
+			expected[3] = glm::vec4(transforms.px[i], transforms.py[i], transforms.pz[i], 1.0f);
+			const float* actual = buffer.data() + 1 + i * 16;
+			for (int e = 0; e < 16; e++)
+				CHECK_NEAR(actual[e], glm::value_ptr(expected)[e], 1e-5);
+		}
+	}
+}
+
+TEST(transformBatchPathMatchesBuild)
+{
+	string path = transformBatchPath();
+#if defined(MECHANICS_NO_SIMD)
+	CHECK(path == "scalar");
+#elif defined(__AVX2__)
+	CHECK(path == "avx2");
+#elif defined(__SSE2__) || defined(_M_X64)
+	CHECK(path == "sse2");
+#endif
+}